@@ -1,42 +1,391 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <algorithm>
+
+#include "llvm/Support/raw_ostream.h"
+
 #include "../PointsTo/PointsTo.h"
 #include "Callgraph.h"
 
 using namespace llvm;
 using namespace callgraph;
 
-Callgraph::Callgraph(Module &M, ptr::PointsToSets const& PS) {
+Callgraph::Callgraph(Module &M, ptr::PointsToSets const& PS, bool lazy) :
+    closureBuilt(false) {
+  EdgeSet seen;
+  Edges edges;
+
+  siteTargetsIndex.push_back(0);
+
+  /* the allocators have call sites, but are no part of the graph */
   typedef Module::iterator FunctionsIter;
   for (FunctionsIter f = M.begin(); f != M.end(); ++f)
-    if (!f->isDeclaration() && !memoryManStuff(&*f))
+    if (!f->isDeclaration())
       for (inst_iterator i = inst_begin(*f); i != inst_end(*f); i++)
 	if (const CallInst *CI = dyn_cast<CallInst const>(&*i))
-	  handleCall(&*f, CI, PS);
+	  handleCall(&*f, CI, PS, seen, edges);
+
+  condense(edges);
+  freeze(edges);
+  freezeSites();
+  if (!lazy)
+    for (unsigned s = 0; s < getNumSCCs(); ++s) {
+      solve(down, s);
+      solve(up, s);
+    }
+}
+
+unsigned Callgraph::getId(const Function *F) {
+  std::pair<DenseMap<const Function *, unsigned>::iterator, bool> I =
+    ids.insert(std::make_pair(F, functions.size()));
+
+  if (I.second)
+    functions.push_back(F);
+
+  return I.first->second;
+}
+
+/*
+ * Counting sort of @edges into the rows of both directions. A row keeps the
+ * order in which its calls were found.
+ */
+void Callgraph::freeze(const Edges &edges) {
+  const unsigned n = functions.size();
+
+  directCallsIndex.assign(n + 1, 0);
+  directCalleesIndex.assign(n + 1, 0);
+  for (Edges::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+    directCallsIndex[e->first + 1]++;
+    directCalleesIndex[e->second + 1]++;
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    directCallsIndex[i + 1] += directCallsIndex[i];
+    directCalleesIndex[i + 1] += directCalleesIndex[i];
+  }
+
+  std::vector<unsigned> calls(directCallsIndex.begin(),
+			      directCallsIndex.end() - 1);
+  std::vector<unsigned> callees(directCalleesIndex.begin(),
+				directCalleesIndex.end() - 1);
+
+  directCallsTable.resize(edges.size());
+  directCalleesTable.resize(edges.size());
+  for (Edges::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+    directCallsTable[calls[e->first]++] = functions[e->second];
+    directCalleesTable[callees[e->second]++] = functions[e->first];
+  }
+}
+
+/*
+ * The call sites calling every function, by counting sort of the site
+ * targets. The sites in the allocators are left out like their calls.
+ */
+void Callgraph::freezeSites() {
+  const unsigned n = functions.size();
+
+  callSitesIndex.assign(n + 1, 0);
+  for (unsigned s = 0; s < sites.size(); ++s)
+    if (!memoryManStuff(sites[s]->getParent()->getParent()))
+      for (unsigned i = siteTargetsIndex[s]; i < siteTargetsIndex[s + 1]; ++i)
+	callSitesIndex[ids[siteTargetsTable[i]] + 1]++;
+  for (unsigned i = 0; i < n; ++i)
+    callSitesIndex[i + 1] += callSitesIndex[i];
+
+  std::vector<unsigned> pos(callSitesIndex.begin(), callSitesIndex.end() - 1);
+
+  callSitesTable.resize(callSitesIndex[n]);
+  for (unsigned s = 0; s < sites.size(); ++s)
+    if (!memoryManStuff(sites[s]->getParent()->getParent()))
+      for (unsigned i = siteTargetsIndex[s]; i < siteTargetsIndex[s + 1]; ++i)
+	callSitesTable[pos[ids[siteTargetsTable[i]]]++] = sites[s];
+}
+
+Callgraph::function_range Callgraph::callTargets(const CallInst *CI) const {
+  DenseMap<const CallInst *, unsigned>::const_iterator I = siteIds.find(CI);
+
+  if (I == siteIds.end())
+    return function_range(siteTargetsTable.end(), siteTargetsTable.end());
+
+  const unsigned s = I->second;
+  return function_range(siteTargetsTable.begin() + siteTargetsIndex[s],
+			siteTargetsTable.begin() + siteTargetsIndex[s + 1]);
+}
+
+Callgraph::callsite_range Callgraph::callSites(key_type const& key) const {
+  DenseMap<const Function *, unsigned>::const_iterator I = ids.find(key);
+
+  if (I == ids.end())
+    return callsite_range(callSitesTable.end(), callSitesTable.end());
+
+  return callsite_range(callSitesTable.begin() + callSitesIndex[I->second],
+			callSitesTable.begin() + callSitesIndex[I->second + 1]);
+}
+
+Callgraph::function_range Callgraph::row(const std::vector<unsigned> &index,
+					 const Functions &table,
+					 key_type key) const {
+  DenseMap<const Function *, unsigned>::const_iterator I = ids.find(key);
+
+  if (I == ids.end())
+    return function_range(table.end(), table.end());
+
+  return function_range(table.begin() + index[I->second],
+			table.begin() + index[I->second + 1]);
+}
+
+/*
+ * Tarjan's algorithm over the direct calls, without recursion. The SCCs are
+ * numbered as they are completed, i.e. callees before their callers, and
+ * the functions are numbered anew by their SCCs, @edges with them.
+ */
+void Callgraph::condense(Edges &edges) {
+  const unsigned n = functions.size();
+  std::vector<std::vector<unsigned> > succ(n);
+  std::vector<char> selfCall(n);
+
+  for (Edges::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+    succ[e->first].push_back(e->second);
+    if (e->first == e->second)
+      selfCall[e->first] = 1;
+  }
+
+  static const unsigned UNVISITED = ~0U;
+  std::vector<unsigned> index(n, UNVISITED), low(n);
+  std::vector<char> onStack(n);
+  std::vector<unsigned> stack, order;
+  std::vector<std::pair<unsigned, unsigned> > path;
+  unsigned next = 0;
+
+  sccIndex.assign(1, 0);
+  for (unsigned root = 0; root < n; ++root) {
+    if (index[root] != UNVISITED)
+      continue;
+
+    index[root] = low[root] = next++;
+    stack.push_back(root);
+    onStack[root] = 1;
+    path.push_back(std::make_pair(root, 0U));
+
+    while (!path.empty()) {
+      const unsigned v = path.back().first;
+
+      if (path.back().second < succ[v].size()) {
+        const unsigned w = succ[v][path.back().second++];
+
+        if (index[w] == UNVISITED) {
+          index[w] = low[w] = next++;
+          stack.push_back(w);
+          onStack[w] = 1;
+          path.push_back(std::make_pair(w, 0U));
+        } else if (onStack[w])
+          low[v] = std::min(low[v], index[w]);
+        continue;
+      }
+
+      path.pop_back();
+      if (!path.empty())
+        low[path.back().first] = std::min(low[path.back().first], low[v]);
+
+      if (low[v] == index[v]) {
+        unsigned w;
+
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onStack[w] = 0;
+          order.push_back(w);
+        } while (w != v);
+        cyclic.push_back(order.size() - sccIndex.back() > 1 || selfCall[v]);
+        sccIndex.push_back(order.size());
+      }
+    }
+  }
+
+  const unsigned sccs = getNumSCCs();
+  std::vector<unsigned> renumber(n);
+  Functions byScc(n);
+
+  scc.resize(n);
+  for (unsigned s = 0; s < sccs; ++s)
+    for (unsigned i = sccIndex[s]; i < sccIndex[s + 1]; ++i) {
+      renumber[order[i]] = i;
+      byScc[i] = functions[order[i]];
+      ids[byScc[i]] = i;
+      scc[i] = s;
+    }
+  functions.swap(byScc);
+
+  down.succ.resize(sccs);
+  up.succ.resize(sccs);
+  for (Edges::iterator e = edges.begin(); e != edges.end(); ++e) {
+    e->first = renumber[e->first];
+    e->second = renumber[e->second];
+
+    const unsigned from = scc[e->first], to = scc[e->second];
+    if (from != to) {
+      down.succ[from].push_back(to);
+      up.succ[to].push_back(from);
+    }
+  }
+
+  Reachability *both[] = { &down, &up };
+  for (unsigned d = 0; d < 2; ++d) {
+    Reachability &R = *both[d];
+
+    for (unsigned s = 0; s < sccs; ++s) {
+      std::vector<unsigned> &S = R.succ[s];
+
+      std::sort(S.begin(), S.end());
+      S.erase(std::unique(S.begin(), S.end()), S.end());
+    }
+    R.reach.resize(sccs);
+    R.done.resize(sccs);
+    R.listed.resize(sccs);
+    R.lists.resize(sccs);
+  }
+}
+
+/*
+ * Builds the bitset of SCC @s, and those of the SCCs it reaches first, in a
+ * postorder over the DAG. The SCCs of the bitsets built already are not
+ * entered.
+ */
+void Callgraph::solve(Reachability &R, unsigned s) const {
+  if (R.done[s])
+    return;
+
+  std::vector<std::pair<unsigned, unsigned> > path;
+  path.push_back(std::make_pair(s, 0U));
+
+  while (!path.empty()) {
+    const unsigned t = path.back().first;
+    const std::vector<unsigned> &S = R.succ[t];
+
+    if (path.back().second < S.size()) {
+      const unsigned u = S[path.back().second++];
+
+      if (!R.done[u])
+        path.push_back(std::make_pair(u, 0U));
+      continue;
+    }
+
+    SparseBitVector<> &reach = R.reach[t];
+    for (unsigned i = 0; i < S.size(); ++i) {
+      reach |= R.reach[S[i]];
+      for (unsigned j = sccIndex[S[i]]; j < sccIndex[S[i] + 1]; ++j)
+        reach.set(j);
+    }
+    if (cyclic[t])
+      for (unsigned j = sccIndex[t]; j < sccIndex[t + 1]; ++j)
+        reach.set(j);
 
-  detail::computeTransitiveClosure(directCallsMap, callsMap);
-  for (const_iterator it = begin(); it != end(); ++it)
-    directCalleesMap.insert(value_type(it->second,it->first));
-  for (const_iterator it = callsMap.begin(); it != callsMap.end(); ++it)
-    calleesMap.insert(value_type(it->second,it->first));
+    R.done[t] = 1;
+    path.pop_back();
+  }
 }
 
+Callgraph::function_range Callgraph::reach(Reachability &R,
+					   const Function *F) const {
+  static const Functions none;
+  DenseMap<const Function *, unsigned>::const_iterator I = ids.find(F);
+
+  if (I == ids.end())
+    return function_range(none.begin(), none.end());
+
+  const unsigned s = scc[I->second];
+  Functions &L = R.lists[s];
+
+  if (!R.listed[s]) {
+    solve(R, s);
+    for (SparseBitVector<>::iterator b = R.reach[s].begin(),
+	 e = R.reach[s].end(); b != e; ++b)
+      L.push_back(functions[*b]);
+    R.listed[s] = 1;
+  }
+
+  return function_range(L.begin(), L.end());
+}
+
+unsigned Callgraph::getSCC(key_type const& key) const {
+  DenseMap<const Function *, unsigned>::const_iterator I = ids.find(key);
+
+  return I == ids.end() ? NO_SCC : scc[I->second];
+}
+
+bool Callgraph::reaches(const Function *from, const Function *to) const {
+  DenseMap<const Function *, unsigned>::const_iterator F = ids.find(from),
+    T = ids.find(to);
+
+  if (F == ids.end() || T == ids.end())
+    return false;
+
+  const unsigned s = scc[F->second];
+  solve(down, s);
+
+  return down.reach[s].test(T->second);
+}
+
+Callgraph::closure_iterator Callgraph::begin_closure() const {
+  if (!closureBuilt) {
+    for (unsigned f = 0; f < functions.size(); ++f) {
+      function_range R = calls(functions[f]);
+
+      for (function_iterator I = R.first; I != R.second; ++I)
+        closure.push_back(std::make_pair(functions[f], *I));
+    }
+    closureBuilt = true;
+  }
+
+  return closure.begin();
+}
+
+bool CallgraphAnalysis::runOnModule(Module &M) {
+  releaseMemory();
+  CG = new Callgraph(M, getAnalysis<ptr::PointsToAnalysis>().getPointsToSets());
+  return false;
+}
+
+static RegisterPass<CallgraphAnalysis> X("callgraph-ptr",
+		"Computes the callgraph using points-to sets", false, true);
+char CallgraphAnalysis::ID;
+
 void Callgraph::handleCall(const Function *parent,
 			   const CallInst *CI,
-			   const ptr::PointsToSets &PS) {
-  if (isInlineAssembly(CI))
+			   const ptr::PointsToSets &PS,
+			   EdgeSet &seen, Edges &edges) {
+  if (isInlineAssembly(CI)) {
+    if (!memoryManStuff(parent))
+      errs() << "ERROR: Inline assembler detected in " << parent->getName() <<
+	", skipping\n";
     return;
+  }
 
   typedef SmallVector<const Value *, 10> CalledFunctions;
   CalledFunctions G;
   getCalledFunctions(CI, PS, std::back_inserter(G));
 
+  const unsigned first = siteTargetsTable.size();
+
   for (CalledFunctions::const_iterator I = G.begin(), E = G.end();
        I != E; ++I) {
     const Function *called = dyn_cast<Function>(*I);
-    if (!memoryManStuff(called) && !called->isDeclaration() &&
-	!contains(parent, called))
-      insertDirectCall(value_type(parent, called));
+    if (memoryManStuff(called) || called->isDeclaration() ||
+	std::find(siteTargetsTable.begin() + first, siteTargetsTable.end(),
+		  called) != siteTargetsTable.end())
+      continue;
+
+    siteTargetsTable.push_back(called);
+    getId(called);
+    if (memoryManStuff(parent))
+      continue;
+
+    const Edge e(getId(parent), getId(called));
+    if (seen.insert(e).second)
+      edges.push_back(e);
   }
+
+  siteIds[CI] = sites.size();
+  sites.push_back(CI);
+  siteTargetsIndex.push_back(siteTargetsTable.size());
 }
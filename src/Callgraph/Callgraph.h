@@ -4,13 +4,17 @@
 #ifndef CALLGRAPH_CALLGRAPH_H
 #define CALLGRAPH_CALLGRAPH_H
 
-#include <map>
 #include <algorithm>
 #include <iterator>
 #include <utility>
+#include <vector>
 
 #include "llvm/IR/Function.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/ADT/STLExtras.h" /* tie */
+#include "llvm/Pass.h"
 
 #include "../Languages/LLVM.h"
 #include "../Languages/LLVMSupport.h"
@@ -18,114 +22,220 @@
 
 namespace llvm { namespace callgraph {
 
+    /*
+     * The calls between the defined functions of a module. The functions
+     * with a call are numbered by the strongly connected components of the
+     * direct calls, so that the members of an SCC are consecutive, and the
+     * direct calls are stored as compressed sparse rows by these numbers, in
+     * both directions: the calls of function i are table[index[i]] to
+     * table[index[i + 1]]. The call sites are kept the same way, with their
+     * targets resolved through the points-to sets once, so that callers need
+     * not ask them again.
+     *
+     * The transitive calls (calls() and callees()) are answered from the
+     * SCCs: every SCC gets a bitset of the functions it reaches, built from
+     * the bitsets of its successors in the DAG of the SCCs. Unless @lazy is
+     * false, a bitset is built only when a function of its SCC is asked
+     * about, so a query costs what the functions reachable from it do.
+     */
     struct Callgraph {
-        typedef std::multimap<const llvm::Function *, const llvm::Function *>
-		Container;
-        typedef Container::key_type key_type;
-        typedef Container::mapped_type mapped_type;
-        typedef Container::value_type value_type;
-        typedef Container::iterator iterator;
-        typedef Container::const_iterator const_iterator;
-        typedef std::pair<const_iterator,const_iterator> range_iterator;
-
-        Callgraph(Module &M, const llvm::ptr::PointsToSets &PS);
-
-        range_iterator directCalls(key_type const& key) const
-        { return directCallsMap.equal_range(key); }
-
-        range_iterator directCallees(key_type const& key) const
-        { return directCalleesMap.equal_range(key); }
-
-        range_iterator calls(key_type const& key) const
-        { return callsMap.equal_range(key); }
-
-        range_iterator callees(key_type const& key) const
-        { return calleesMap.equal_range(key); }
+        typedef const llvm::Function *key_type;
+        typedef const llvm::Function *mapped_type;
+
+        typedef std::vector<const llvm::Function *> Functions;
+        typedef Functions::const_iterator function_iterator;
+        typedef std::pair<function_iterator,function_iterator> function_range;
+        typedef std::vector<std::pair<const llvm::Function *,
+		const llvm::Function *> > ClosureContainer;
+        typedef ClosureContainer::const_iterator closure_iterator;
+        typedef std::vector<const llvm::CallInst *> CallSites;
+        typedef CallSites::const_iterator callsite_iterator;
+        typedef std::pair<callsite_iterator,callsite_iterator> callsite_range;
+        typedef std::vector<unsigned>::const_iterator scc_succ_iterator;
+        typedef std::pair<scc_succ_iterator,scc_succ_iterator> scc_succ_range;
+
+        /* SCC numbers, bottom-up (callees first) or top-down */
+        class scc_iterator :
+	  public std::iterator<std::forward_iterator_tag, unsigned> {
+        public:
+          scc_iterator(unsigned s, int step) : s(s), step(step) {}
+          unsigned operator*() const { return s; }
+          scc_iterator &operator++() { s += step; return *this; }
+          scc_iterator operator++(int) {
+            scc_iterator old(*this);
+            s += step;
+            return old;
+          }
+          bool operator==(const scc_iterator &o) const { return s == o.s; }
+          bool operator!=(const scc_iterator &o) const { return s != o.s; }
+
+        private:
+          unsigned s;
+          int step;
+        };
+
+        /* getSCC() of the functions with no call, neither made nor taken */
+        static const unsigned NO_SCC = ~0U;
+
+        Callgraph(Module &M, const llvm::ptr::PointsToSets &PS,
+		  bool lazy = true);
+
+        /* functions @key calls */
+        function_range directCalls(key_type const& key) const
+        { return row(directCallsIndex, directCallsTable, key); }
+
+        /* functions calling @key */
+        function_range directCallees(key_type const& key) const
+        { return row(directCalleesIndex, directCalleesTable, key); }
+
+        /*
+         * defined functions @CI may call, none for inline assembly and for
+         * calls in declarations
+         */
+        function_range callTargets(const llvm::CallInst *CI) const;
+
+        /*
+         * calls which may call @key, in the order of the module, but none
+         * in the allocators (memoryManStuff())
+         */
+        callsite_range callSites(key_type const& key) const;
+
+        /* functions @key calls, directly or not */
+        function_range calls(key_type const& key) const
+        { return reach(down, key); }
+
+        /* functions calling @key, directly or not */
+        function_range callees(key_type const& key) const
+        { return reach(up, key); }
+
+        /*
+         * The DAG of the SCCs of the direct calls. They are numbered so that
+         * every SCC comes after all those it calls, which is the bottom-up
+         * order, and the top-down order is the reverse. SCCs none of whose
+         * callees is pending can be processed at the same time.
+         */
+        unsigned getNumSCCs() const { return sccIndex.size() - 1; }
+        unsigned getSCC(key_type const& key) const;
+        function_range sccMembers(unsigned s) const
+        { return function_range(functions.begin() + sccIndex[s],
+                                functions.begin() + sccIndex[s + 1]); }
+        /* whether the functions of @s call each other, or one itself */
+        bool isCyclic(unsigned s) const { return cyclic[s]; }
+        /* the other SCCs @s calls directly */
+        scc_succ_range sccCalls(unsigned s) const
+        { return scc_succ_range(down.succ[s].begin(), down.succ[s].end()); }
+        /* the other SCCs calling @s directly */
+        scc_succ_range sccCallers(unsigned s) const
+        { return scc_succ_range(up.succ[s].begin(), up.succ[s].end()); }
+        scc_iterator bottom_up_begin() const { return scc_iterator(0, 1); }
+        scc_iterator bottom_up_end() const
+        { return scc_iterator(getNumSCCs(), 1); }
+        scc_iterator top_down_begin() const
+        { return scc_iterator(getNumSCCs() - 1, -1); }
+        scc_iterator top_down_end() const { return scc_iterator(NO_SCC, -1); }
+
+        /* whether @from calls @to, directly or not */
+        bool reaches(key_type const from, mapped_type const to) const;
 
         bool contains(key_type const key, mapped_type const value) const {
-          range_iterator rng = directCalls(key);
-          for (const_iterator it = rng.first; it != rng.second; ++it)
-            if (it->second == value)
-              return true;
-          return false;
+          function_range rng = directCalls(key);
+          return std::find(rng.first, rng.second, value) != rng.second;
         }
 
-        const_iterator begin() const { return directCallsMap.begin(); }
-        iterator begin() { return directCallsMap.begin(); }
-        const_iterator end() const { return directCallsMap.end(); }
-        iterator end() { return directCallsMap.end(); }
-        const_iterator begin_closure() const { return callsMap.begin(); }
-        const_iterator end_closure() const { return callsMap.end(); }
-        Container const& getContainer() const { return directCallsMap; }
-        Container& getContainer() { return directCallsMap; }
-
-    protected:
-        iterator insertDirectCall(value_type const& val)
-        { return directCallsMap.insert(val); }
+        /* the pairs of calls(), all of them are computed by the first call */
+        closure_iterator begin_closure() const;
+        closure_iterator end_closure() const { return closure.end(); }
 
     private:
-        Container directCallsMap;
-        Container directCalleesMap;
-        Container callsMap;
-        Container calleesMap;
+        /* the direct calls by function ids, while building */
+        typedef std::pair<unsigned, unsigned> Edge;
+        typedef std::vector<Edge> Edges;
+        typedef llvm::DenseSet<Edge> EdgeSet;
+
+        /* one direction of the calls over the SCCs, by SCC */
+        struct Reachability {
+          std::vector<std::vector<unsigned> > succ;
+          std::vector<llvm::SparseBitVector<> > reach; /* function ids */
+          std::vector<char> done;
+          std::vector<char> listed;
+          std::vector<Functions> lists;
+        };
+
+        /* the functions with a call, numbered, and their SCCs */
+        Functions functions;
+        llvm::DenseMap<const llvm::Function *, unsigned> ids;
+        std::vector<unsigned> directCallsIndex;
+        Functions directCallsTable;
+        std::vector<unsigned> directCalleesIndex;
+        Functions directCalleesTable;
+        llvm::DenseMap<const llvm::CallInst *, unsigned> siteIds;
+        CallSites sites;
+        std::vector<unsigned> siteTargetsIndex;
+        Functions siteTargetsTable;
+        std::vector<unsigned> callSitesIndex;
+        CallSites callSitesTable;
+        std::vector<unsigned> scc;
+        std::vector<unsigned> sccIndex;	/* SCC -> its first function id */
+        std::vector<char> cyclic;
+
+        mutable Reachability down, up;
+        mutable ClosureContainer closure;
+        mutable bool closureBuilt;
 
         void handleCall(const llvm::Function *parent, const llvm::CallInst *CI,
-                        const llvm::ptr::PointsToSets &PS);
+                        const llvm::ptr::PointsToSets &PS, EdgeSet &seen,
+                        Edges &edges);
+        unsigned getId(const llvm::Function *F);
+        void freeze(const Edges &edges);
+        void freezeSites();
+        void condense(Edges &edges);
+        function_range row(const std::vector<unsigned> &index,
+                           const Functions &table, key_type key) const;
+        void solve(Reachability &R, unsigned s) const;
+        function_range reach(Reachability &R, const llvm::Function *F) const;
     };
-}}
-
-namespace llvm { namespace callgraph { namespace detail {
 
-  template<typename Relation>
-  void computeTransitiveClosure(Relation const& R, Relation& TCR) {
-    typedef std::set<typename Relation::value_type> Set;
-    typedef std::multimap<typename Relation::value_type::first_type,
-                          typename Relation::value_type::second_type> Dict;
+    /* Callgraph of the module as an analysis, see ptr::PointsToAnalysis */
+    class CallgraphAnalysis : public ModulePass {
+    public:
+        static char ID;
 
-    Set S;
-    std::copy(R.begin(),R.end(),std::inserter(S,S.end()));
+        CallgraphAnalysis() : ModulePass(ID), CG(0) {}
+        virtual ~CallgraphAnalysis() { releaseMemory(); }
 
-    Dict D;
-    std::copy(R.begin(),R.end(),std::inserter(D,D.end()));
+        virtual bool runOnModule(Module &M);
+        virtual void releaseMemory() { delete CG; CG = 0; }
 
-    while (true)
-    {
-      std::size_t const old_size = S.size();
-
-      for (typename Set::const_iterator it = S.begin(); it != S.end(); ++it) {
-        typename Dict::const_iterator b,e;
-        llvm::tie(b,e) = D.equal_range(it->second);
-        for ( ; b != e; ++b)
-          S.insert(typename Set::value_type(it->first,b->second));
-      }
-
-      if (old_size == S.size())
-          break;
-    }
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+            AU.setPreservesAll();
+            AU.addRequired<ptr::PointsToAnalysis>();
+        }
 
-    std::copy(S.begin(),S.end(),std::inserter(TCR,TCR.end()));
-  }
+        Callgraph &getCallgraph() { return *CG; }
 
-}}}
+    private:
+        Callgraph *CG;
+    };
+}}
 
 namespace llvm { namespace callgraph {
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::function_range
     getDirectCalls(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.directCalls(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::function_range
     getDirectCallees(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.directCallees(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::function_range
     getCalls(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.calls(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::function_range
     getCallees(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.callees(key);
     }
@@ -29,6 +29,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<DataLayout>();
+      AU.addRequired<callgraph::CallgraphAnalysis>();
     }
   };
 }
@@ -417,8 +418,8 @@ bool Kleerer::run() {
   if (!F__assert_fail) /* nothing to find here bro */
     return false;
 
-  callgraph::Callgraph::range_iterator RI = CG.callees(F__assert_fail);
-  if (std::distance(RI.first, RI.second) == 0)
+  callgraph::Callgraph::function_range RI = CG.directCallees(F__assert_fail);
+  if (RI.first == RI.second)
     return false;
 
   const ConstantArray *initFuns = getInitFuns(M);
@@ -430,15 +431,8 @@ bool Kleerer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     Function &F = *cast<Function>(CE->getOperand(0));
 
-    callgraph::Callgraph::const_iterator II, EE;
-    llvm::tie(II, EE) = CG.calls(&F);
-    for (; II != EE; ++II) {
-      const Function *callee = (*II).second;
-      if (callee == F__assert_fail) {
-        writeMain(F);
-        break;
-      }
-    }
+    if (CG.reaches(&F, F__assert_fail))
+      writeMain(F);
     if (done)
       break;
   }
@@ -447,13 +441,8 @@ bool Kleerer::run() {
 
 bool KleererPass::runOnModule(Module &M) {
   DataLayout &TD = getAnalysis<DataLayout>();
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
+  callgraph::Callgraph &CG =
+    getAnalysis<callgraph::CallgraphAnalysis>().getCallgraph();
 
   Kleerer K(*this, M, TD, CG);
   return K.run();
@@ -26,6 +26,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
       AU.addRequired<LoopInfo>();
+      AU.addRequired<callgraph::CallgraphAnalysis>();
     }
   };
 }
@@ -254,17 +255,12 @@ getFlags(const FunInfo *funInfo, bool nested = false) {
 }
 
 void StatsComputer::run() {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
+  callgraph::Callgraph &CG =
+    modPass.getAnalysis<callgraph::CallgraphAnalysis>().getCallgraph();
   ModInfo modInfo(M);
 
 #ifdef DEBUG_DUMP_CALLREL
-  for (callgraph::Callgraph::const_iterator I = CG.begin_closure(),
+  for (callgraph::Callgraph::closure_iterator I = CG.begin_closure(),
 		  E = CG.end_closure(); I != E; ++I) {
 	  const Function *from = I->first;
 	  const Function *to = I->second;
@@ -288,13 +284,13 @@ void StatsComputer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     const Function &F = *cast<Function>(CE->getOperand(0));
     FunInfo *funInfo = modInfo.getFunInfo(&F);
-    callgraph::Callgraph::const_iterator II, EE;
+    callgraph::Callgraph::function_iterator II, EE;
     llvm::tie(II, EE) = CG.calls(&F);
 #ifdef DEBUG_NESTED
     errs() << "at " << F.getName() << " flags [" << getFlags(funInfo) << "]\n";
 #endif
     for (; II != EE; ++II) {
-      const Function *called = II->second;
+      const Function *called = *II;
       const FunInfo *calledFunInfo = modInfo.getFunInfo(called);
 #ifdef DEBUG_NESTED
       errs() << "  " << called->getName() << " [" << getFlags(calledFunInfo) <<
@@ -30,63 +30,117 @@ namespace llvm { namespace mods {
 
   const Modifies::ModSet &getModSet(const llvm::Function *const &f,
 	    const Modifies &S) {
-    static const Modifies::ModSet empty;
-    const Modifies::const_iterator it = S.find(f);
+    return S.get(f);
+  }
 
-    return (it == S.end()) ? empty : it->second;
+  /* what @f writes itself, but its locals */
+  void Modifies::addOwn(const Function *f, ModSet &S) const {
+    typedef ptr::PointsToSets::Pointee Pointee;
+    const ProgramStructure::const_iterator F = P->find(f);
+
+    if (F == P->end())
+      return;
+
+    for (ProgramStructure::mapped_type::const_iterator c = F->second.begin();
+	 c != F->second.end(); ++c)
+      if (c->getType() == CMD_VAR) {
+	if (!isLocalToFunction(c->getVar(), f))
+	  S.insert(Pointee(c->getVar(), -1));
+      } else if (c->getType() == CMD_DREF_VAR) {
+	typedef ptr::PointsToSets::PointsToSet PTSet;
+	const PTSet &X = ptr::getPointsToSet(c->getVar(), *PS);
+
+	for (PTSet::const_iterator p = X.begin(); p != X.end(); ++p)
+	  if (!isLocalToFunction(p->first, f) && !isConstantValue(p->first))
+	    S.insert(*p);
+      }
   }
 
+  /*
+   * A function modifies what it writes and what the functions it calls,
+   * directly or not, write. These are its SCC and all the SCCs below, the
+   * same for every function of the SCC, so one summary per SCC is built
+   * from the summaries of the SCCs it calls, those first, in a postorder
+   * over the DAG. The summaries built already are not entered. They are
+   * interned along with the sets of the functions, mostly they are equal.
+   */
+  const Modifies::ModSet *Modifies::summarize(unsigned s) const {
+    typedef callgraph::Callgraph Callgraph;
+    std::vector<std::pair<unsigned, unsigned> > path;
 
-  void computeModifies(const ProgramStructure &P,
-	const callgraph::Callgraph &CG, const ptr::PointsToSets &PS,
-	Modifies &MOD) {
-    typedef ptr::PointsToSets::Pointee Pointee;
+    if (summary[s])
+      return summary[s];
 
-    for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f)
-      for (ProgramStructure::mapped_type::const_iterator c = f->second.begin();
-	   c != f->second.end(); ++c)
-	if (c->getType() == CMD_VAR) {
-	  if (!isLocalToFunction(c->getVar(), f->first))
-	      MOD[f->first].insert(Pointee(c->getVar(), -1));
-	} else if (c->getType() == CMD_DREF_VAR) {
-	  typedef ptr::PointsToSets::PointsToSet PTSet;
-	  const PTSet &S = ptr::getPointsToSet(c->getVar(), PS);
-
-	  for (PTSet::const_iterator p = S.begin(); p != S.end(); ++p)
-	    if (!isLocalToFunction(p->first, f->first) &&
-			    !isConstantValue(p->first))
-	      MOD[f->first].insert(*p);
-	}
+    path.push_back(std::make_pair(s, 0U));
+    while (!path.empty()) {
+      const unsigned t = path.back().first;
+      const Callgraph::scc_succ_range R = CG->sccCalls(t);
 
-    typedef callgraph::Callgraph Callgraph;
-    for (Callgraph::const_iterator i = CG.begin_closure();
-	  i != CG.end_closure(); ++i) {
-      const Modifies::mapped_type &src = MOD[i->second];
-      typedef Modifies::mapped_type dst_t;
-      dst_t &dst = MOD[i->first];
-
-      std::copy(src.begin(), src.end(), std::inserter(dst, dst.end()));
-#if 0 /* original boost+STL uncompilable crap */
-      using std::tr1::bind;
-      using std::tr1::placeholders::_1;
-      using std::tr1::cref;
-      dst.erase(std::remove_if(dst.begin(), dst.end(),
-		bind(&ProgramStructure::isLocalToFunction, cref(P), _1, i->first)),
-		dst.end());
-#endif
-      for (dst_t::iterator I = dst.begin(), E = dst.end(); I != E; ) {
-	if (isLocalToFunction(I->first, i->first))
-	  dst.erase(I++);
-	else
-	  ++I;
+      if (path.back().second < unsigned(R.second - R.first)) {
+	const unsigned u = R.first[path.back().second++];
+
+	if (!summary[u])
+	  path.push_back(std::make_pair(u, 0U));
+	continue;
       }
+
+      Callgraph::function_iterator f, fe;
+      Callgraph::scc_succ_iterator u;
+      ModSet S;
+
+      for (llvm::tie(f, fe) = CG->sccMembers(t); f != fe; ++f)
+	addOwn(*f, S);
+      for (u = R.first; u != R.second; ++u)
+	S.insert(summary[*u]->begin(), summary[*u]->end());
+      summary[t] = intern(S);
+      path.pop_back();
+    }
+
+    return summary[s];
+  }
+
+  /* Only the locals of @f are left out of the summary of its SCC. */
+  const Modifies::ModSet &Modifies::get(const Function *f) const {
+    static const ModSet empty;
+
+    if (!CG)
+      return empty;
+
+    const Container::const_iterator I = C.find(f);
+    if (I != C.end())
+      return *I->second;
+
+    const unsigned s = CG->getSCC(f);
+    ModSet M;
+
+    /* the functions making no call and called by none */
+    if (s == callgraph::Callgraph::NO_SCC)
+      addOwn(f, M);
+    else {
+      const ModSet *S = summarize(s);
+
+      for (ModSet::const_iterator J = S->begin(), E = S->end(); J != E; ++J)
+	if (!isLocalToFunction(J->first, f))
+	  M.insert(M.end(), *J);
     }
 
+    return *(C[f] = intern(M));
+  }
+
+  void computeModifies(const ProgramStructure &P,
+	const callgraph::Callgraph &CG, const ptr::PointsToSets &PS,
+	Modifies &MOD) {
+    MOD.P = &P;
+    MOD.CG = &CG;
+    MOD.PS = &PS;
+    MOD.C.clear();
+    MOD.summary.assign(CG.getNumSCCs(), 0);
+
 #ifdef DEBUG_DUMP
     errs() << "\n==== MODSET DUMP ====\n";
     for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f) {
 	const Function *fun = f->first;
-	const Modifies::ModSet &m = MOD[fun];
+	const Modifies::ModSet &m = getModSet(fun, MOD);
 
 	errs() << fun->getName() << "\n";
 	for (Modifies::ModSet::const_iterator I = m.begin(), E = m.end(); I != E; ++I) {
@@ -100,4 +154,19 @@ namespace llvm { namespace mods {
 #endif
   }
 
+  bool ModifiesAnalysis::runOnModule(Module &M) {
+    releaseMemory();
+    MOD = new Modifies;
+    P = new ProgramStructure(M);
+
+    computeModifies(*P, getAnalysis<callgraph::CallgraphAnalysis>().getCallgraph(),
+	getAnalysis<ptr::PointsToAnalysis>().getPointsToSets(), *MOD);
+
+    return false;
+  }
+
+  static RegisterPass<ModifiesAnalysis> X("modifies",
+	"Computes what functions modify", false, true);
+  char ModifiesAnalysis::ID;
+
 }}
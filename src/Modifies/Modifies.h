@@ -10,6 +10,7 @@
 
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Pass.h"
 
 #include "../Languages/LLVM.h"
 #include "../PointsTo/PointsTo.h"
@@ -17,30 +18,54 @@
 
 namespace llvm { namespace mods {
 
+    struct ProgramStructure;
+
+    /*
+     * What every function modifies. The sets are interned, functions
+     * modifying the same share one.
+     *
+     * A set is computed only when it is asked for (get()), from the
+     * summary of the SCC of the function (see Callgraph), which is built
+     * from the summaries of the SCCs it calls first. The stores of the
+     * functions not reached that way are never looked at, so with the
+     * points-to sets solved on demand, neither are their pointers. Hence
+     * there is nothing to iterate over, only the functions asked for so
+     * far have a set.
+     */
     struct Modifies {
         typedef std::set<llvm::ptr::PointsToSets::Pointee> ModSet;
-        typedef std::map<const llvm::Function *, ModSet> Container;
-        typedef Container::key_type key_type;
-        typedef Container::mapped_type mapped_type;
-        typedef Container::value_type value_type;
-        typedef Container::iterator iterator;
-        typedef Container::const_iterator const_iterator;
-        typedef std::pair<iterator, bool> insert_retval;
+        typedef std::map<const llvm::Function *, const ModSet *> Container;
 
+        Modifies() : P(0), CG(0), PS(0) {}
         virtual ~Modifies() {}
 
-        insert_retval insert(value_type const& val) { return C.insert(val); }
-        mapped_type& operator[](key_type const& key) { return C[key]; }
-        const_iterator find(key_type const& key) const { return C.find(key); }
-        iterator find(key_type const& key) { return C.find(key); }
-        const_iterator begin() const { return C.begin(); }
-        iterator begin() { return C.begin(); }
-        const_iterator end() const { return C.end(); }
-        iterator end() { return C.end(); }
-        Container const& getContainer() const { return C; }
-        Container& getContainer() { return C; }
+        /* the set of @f, empty before computeModifies() */
+        const ModSet &get(const llvm::Function *f) const;
+
+        /* the set equal to @S, the same for all equal sets */
+        const ModSet *intern(ModSet const& S) const
+        { return &*pool.insert(S).first; }
     private:
-        Container C;
+        friend void computeModifies(const ProgramStructure &P,
+				    const callgraph::Callgraph &CG,
+				    const llvm::ptr::PointsToSets &PS,
+				    Modifies &M);
+
+        const ProgramStructure *P;
+        const callgraph::Callgraph *CG;
+        const llvm::ptr::PointsToSets *PS;
+        /* the functions asked for */
+        mutable Container C;
+        /* by SCC, 0 until it is asked for */
+        mutable std::vector<const ModSet *> summary;
+        /* owns the sets C and summary point to, hence no copying */
+        mutable std::set<ModSet> pool;
+
+        void addOwn(const llvm::Function *f, ModSet &S) const;
+        const ModSet *summarize(unsigned s) const;
+
+        Modifies(const Modifies &);
+        void operator=(const Modifies &);
     };
 
     const Modifies::ModSet &getModSet(const llvm::Function *const &f,
@@ -115,10 +140,44 @@ namespace llvm { namespace mods {
 }}
 namespace llvm { namespace mods {
 
+    /*
+     * Makes @M answer from @P, @CG and @PS, which have to live as long as
+     * it does. Nothing is computed yet, see Modifies.
+     */
     void computeModifies(const ProgramStructure &P,
 			 const callgraph::Callgraph &CG,
                          const llvm::ptr::PointsToSets &PS, Modifies &M);
 
+    /* Modifies of the module as an analysis, see ptr::PointsToAnalysis */
+    class ModifiesAnalysis : public ModulePass {
+    public:
+        static char ID;
+
+        ModifiesAnalysis() : ModulePass(ID), MOD(0), P(0) {}
+        virtual ~ModifiesAnalysis() { releaseMemory(); }
+
+        virtual bool runOnModule(Module &M);
+        virtual void releaseMemory() {
+            delete MOD;
+            MOD = 0;
+            delete P;
+            P = 0;
+        }
+
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+            AU.setPreservesAll();
+            AU.addRequired<ptr::PointsToAnalysis>();
+            AU.addRequired<callgraph::CallgraphAnalysis>();
+        }
+
+        const Modifies &getModifies() const { return *MOD; }
+
+    private:
+        Modifies *MOD;
+        /* the stores MOD computes its sets from */
+        ProgramStructure *P;
+    };
+
 }}
 
 #endif
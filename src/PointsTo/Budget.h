@@ -0,0 +1,79 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_BUDGET_H
+#define POINTSTO_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+
+#include "llvm/Support/Process.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+  /*
+   * Time and heap a solver may use (SolverOptions::timeLimit and memLimit).
+   * The solvers poll it as they go and stop early once it is exceeded, the
+   * sets they computed are incomplete then.
+   *
+   * exceeded() is meant for hot loops, it looks at the clock and the heap
+   * only every CHECK_EVERY calls. check() looks right away. Both may be
+   * called from several threads at once (SolverOptions::partition).
+   */
+  class Budget {
+  public:
+    enum Limit {
+      NONE,
+      TIME,
+      MEMORY,
+    };
+
+    /* 0 means no limit */
+    Budget(unsigned seconds, unsigned megabytes) : seconds(seconds),
+	megabytes(megabytes), polls(0), hit(NONE),
+	start(std::chrono::steady_clock::now()) {}
+
+    bool exceeded() {
+      if (hit != NONE)
+	return true;
+      if (polls.fetch_add(1, std::memory_order_relaxed) % CHECK_EVERY)
+	return false;
+      return check();
+    }
+
+    bool check() {
+      if (hit != NONE)
+	return true;
+
+      if (seconds && std::chrono::steady_clock::now() - start >=
+	  std::chrono::seconds(seconds))
+	hit = TIME;
+      else if (megabytes &&
+	  sys::Process::GetMallocUsage() / (1024 * 1024) >= megabytes)
+	hit = MEMORY;
+
+      return hit != NONE;
+    }
+
+    /* Starts counting the time anew, for a budget created in advance. */
+    void restart() {
+      start = std::chrono::steady_clock::now();
+      polls = 0;
+      hit = NONE;
+    }
+
+    Limit getHit() const { return static_cast<Limit>(hit.load()); }
+
+  private:
+    static const unsigned CHECK_EVERY = 4096;
+
+    unsigned seconds;
+    unsigned megabytes;
+    std::atomic<unsigned> polls;
+    std::atomic<int> hit;
+    std::chrono::steady_clock::time_point start;
+  };
+
+}}}
+
+#endif
@@ -0,0 +1,335 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Cache.h"
+#include "FieldPolicy.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+static const char *const MAGIC = "LLVMSlicer points-to cache 1";
+
+static const Function *getOwner(const Value *V) {
+  if (const Instruction *I = dyn_cast<Instruction>(V))
+    return I->getParent()->getParent();
+  if (const Argument *A = dyn_cast<Argument>(V))
+    return A->getParent();
+  return 0;
+}
+
+/* what FieldPolicy checks the offsets against */
+static uint64_t getObjectSize(const DataLayout &DL, const Value *V) {
+  uint64_t size = 0;
+
+  detail::getObjectSize(DL, V, size);
+  return size;
+}
+
+void SetsCache::addValue(const Value *V,
+    const DenseMap<const Value *, unsigned> &pos) {
+  if (names.count(V))
+    return;
+
+  std::string name;
+
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+    if (GV->hasName())
+      name = "g " + GV->getName().str();
+    else
+      name = "g#" + utostr(pos.lookup(GV));
+  } else if (const Argument *A = dyn_cast<Argument>(V)) {
+    name = "a" + utostr(A->getArgNo()) + " " +
+      A->getParent()->getName().str();
+  } else if (const Instruction *I = dyn_cast<Instruction>(V)) {
+    name = "i" + utostr(pos.lookup(I)) + " " +
+      I->getParent()->getParent()->getName().str();
+  } else if (isa<Constant>(V)) {
+    raw_string_ostream OS(name);
+    OS << "c ";
+    V->print(OS);
+    OS.flush();
+  } else {
+    broken = true;
+    return;
+  }
+
+  if (name.find('\n') != std::string::npos ||
+      !values.insert(std::make_pair(name, V)).second) {
+    broken = true;
+    return;
+  }
+  names[V] = name;
+}
+
+SetsCache::SetsCache(const std::string &path, const ProgramStructure &P,
+    const SolverOptions &O) : path(path), stats(O.stats), broken(false) {
+  const Module &M = P.getModule();
+  DataLayout DL(&M);
+  FieldPolicy FP(M, O.fields);
+  DenseMap<const Value *, unsigned> pos;
+  unsigned globals = 0;
+
+  for (Module::const_global_iterator I = M.global_begin(),
+      E = M.global_end(); I != E; ++I)
+    pos[&*I] = globals++;
+  for (Module::const_iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+    unsigned n = 0;
+
+    pos[&*F] = globals++;
+    for (const_inst_iterator I = inst_begin(*F), E = inst_end(*F); I != E;
+	++I)
+      pos[&*I] = n++;
+  }
+
+  /* 0 stands for the global initializers */
+  DenseMap<const Function *, unsigned> owners;
+  std::vector<MD5> H(1);
+  std::vector<const Function *> functions(1);
+
+  for (Module::const_iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+    owners[&*F] = H.size();
+    H.push_back(MD5());
+    functions.push_back(&*F);
+  }
+  std::vector<bool> used(H.size());
+
+  for (ProgramStructure::const_iterator I = P.begin(), E = P.end(); I != E;
+      ++I) {
+    const Value *vals[3] = { I->getLvalue(), I->getRvalue(), 0 };
+    std::string rule = utostr(I->getType());
+
+    if (I->getType() == RCT_VAR_ASGN_GEP) {
+      const GetElementPtrInst *gep = cast<GetElementPtrInst>(vals[1]);
+      bool isArray = false;
+      int64_t off = FP.getOffset(gep, isArray);
+
+      vals[2] = elimConstExpr(gep->getPointerOperand());
+      rule += " " + itostr(off) + (isArray ? "a" : "");
+    }
+
+    for (unsigned i = 0; i < 3 && vals[i]; ++i) {
+      addValue(vals[i], pos);
+      rule += "\n" + names.lookup(vals[i]) + " " +
+	utostr(getObjectSize(DL, vals[i]));
+    }
+    rule += "\n";
+
+    const Function *owner = getOwner(vals[0]);
+    const unsigned h = owner ? owners.lookup(owner) : 0;
+    H[h].update(rule);
+    used[h] = true;
+  }
+
+  for (unsigned i = 0; i < H.size(); ++i) {
+    if (!used[i])
+      continue;
+
+    MD5::MD5Result R;
+    SmallString<32> hex;
+
+    H[i].final(R);
+    MD5::stringifyResult(R, hex);
+    hashes.push_back(FunctionHash(i ? functions[i]->getName().str() : "",
+	  hex.str().str()));
+  }
+
+  options = "solver " + utostr(O.kind) + " reduce " + utostr(O.reduce) +
+    " otf " + utostr(O.onTheFly) + " fields " +
+    utostr(O.fields.maxOffsets) + " " + utostr(O.fields.arrayLimit) + " " +
+    utostr(O.fields.collapseArrays) + " " +
+    utostr(O.fields.cutRecursion) + " layout " +
+    DL.getStringRepresentation();
+}
+
+/* reads "<what> <count>" */
+static bool readCount(std::istream &in, const char *what, unsigned &n) {
+  std::string line, word;
+
+  if (!std::getline(in, line))
+    return false;
+
+  std::istringstream ss(line);
+  return (ss >> word >> n) && word == what;
+}
+
+bool SetsCache::load(PointsToSets &S) {
+  std::ifstream in(path.c_str());
+  std::string line;
+  unsigned n;
+
+  if (broken || !in || !std::getline(in, line) || line != MAGIC ||
+      !std::getline(in, line) || line != options)
+    return false;
+
+  if (!readCount(in, "functions", n))
+    return false;
+
+  unsigned changed = 0;
+  std::vector<FunctionHash> old;
+  for (unsigned i = 0; i < n && std::getline(in, line); ++i) {
+    std::string::size_type space = line.find(' ');
+    if (space == std::string::npos)
+      return false;
+    old.push_back(FunctionHash(line.substr(space + 1),
+	  line.substr(0, space)));
+  }
+  if (old != hashes) {
+    if (stats) {
+      StringMap<std::string> was;
+      for (unsigned i = 0; i < old.size(); ++i)
+	was[old[i].first] = old[i].second;
+      for (unsigned i = 0; i < hashes.size(); ++i)
+	if (was.lookup(hashes[i].first) != hashes[i].second)
+	  changed++;
+      errs() << "PointsTo: cache " << path << " is stale, " << changed <<
+	" of " << hashes.size() << " functions changed\n";
+    }
+    return false;
+  }
+
+  std::vector<const Value *> vals;
+  if (!readCount(in, "values", n))
+    return false;
+  for (unsigned i = 0; i < n && std::getline(in, line); ++i) {
+    const Value *V = values.lookup(line);
+    if (!V)
+      return false;
+    vals.push_back(V);
+  }
+  if (vals.size() != n)
+    return false;
+
+  std::vector<PointsToSets::PointsToSet> sets;
+  if (!readCount(in, "sets", n))
+    return false;
+  for (unsigned i = 0; i < n; ++i) {
+    unsigned count, v;
+    int off;
+
+    if (!(in >> count))
+      return false;
+    sets.push_back(PointsToSets::PointsToSet());
+    while (count--) {
+      if (!(in >> v >> off) || v >= vals.size())
+	return false;
+      sets.back().insert(PointsToSets::Pointee(vals[v], off));
+    }
+  }
+  in >> std::ws;
+
+  std::vector<std::pair<LocationTable::Location, unsigned> > pointers;
+  if (!readCount(in, "pointers", n))
+    return false;
+  for (unsigned i = 0; i < n; ++i) {
+    unsigned v, set;
+    int off;
+
+    if (!(in >> v >> off >> set) || v >= vals.size() || set >= sets.size())
+      return false;
+    pointers.push_back(std::make_pair(LocationTable::Location(vals[v], off),
+	  set));
+  }
+
+  std::vector<const PointsToSets::PointsToSet *> shared;
+  for (unsigned i = 0; i < sets.size(); ++i)
+    shared.push_back(S.intern(sets[i]));
+  for (unsigned i = 0; i < pointers.size(); ++i)
+    S.assign(S.getLocations().getId(pointers[i].first),
+	shared[pointers[i].second]);
+
+  if (stats)
+    errs() << "PointsTo: " << S.size() << " sets loaded from " << path <<
+      "\n";
+
+  return true;
+}
+
+void SetsCache::store(const PointsToSets &S) const {
+  typedef PointsToSets::PointsToSet PTSet;
+  DenseMap<const Value *, unsigned> valIdx;
+  DenseMap<const PTSet *, unsigned> setIdx;
+  std::vector<const Value *> vals;
+  std::vector<const PTSet *> sets;
+
+  if (broken)
+    return;
+
+  for (PointsToSets::const_iterator I = S.begin(), E = S.end(); I != E;
+      ++I) {
+    const PTSet &X = I->second;
+    const Value *V = I->first.first;
+
+    if (!names.count(V))
+      return;
+    if (valIdx.insert(std::make_pair(V, vals.size())).second)
+      vals.push_back(V);
+
+    if (!setIdx.insert(std::make_pair(&X, sets.size())).second)
+      continue;
+    sets.push_back(&X);
+
+    for (PTSet::const_iterator II = X.begin(), EE = X.end(); II != EE; ++II) {
+      if (!names.count(II->first))
+	return;
+      if (valIdx.insert(std::make_pair(II->first, vals.size())).second)
+	vals.push_back(II->first);
+    }
+  }
+
+  /* do not let a concurrent reader see a half-written file */
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp.c_str());
+
+    out << MAGIC << "\n" << options << "\n";
+    out << "functions " << hashes.size() << "\n";
+    for (unsigned i = 0; i < hashes.size(); ++i)
+      out << hashes[i].second << " " << hashes[i].first << "\n";
+
+    out << "values " << vals.size() << "\n";
+    for (unsigned i = 0; i < vals.size(); ++i)
+      out << names.lookup(vals[i]) << "\n";
+
+    out << "sets " << sets.size() << "\n";
+    for (unsigned i = 0; i < sets.size(); ++i) {
+      out << sets[i]->size();
+      for (PTSet::const_iterator I = sets[i]->begin(), E = sets[i]->end();
+	  I != E; ++I)
+	out << " " << valIdx.lookup(I->first) << " " << I->second;
+      out << "\n";
+    }
+
+    out << "pointers " << S.size() << "\n";
+    for (PointsToSets::const_iterator I = S.begin(), E = S.end(); I != E;
+	++I)
+      out << valIdx.lookup(I->first.first) << " " << I->first.second << " " <<
+	setIdx.lookup(&I->second.get()) << "\n";
+
+    if (!out) {
+      std::remove(tmp.c_str());
+      return;
+    }
+  }
+
+  if (std::rename(tmp.c_str(), path.c_str()))
+    std::remove(tmp.c_str());
+}
+
+}}}
@@ -0,0 +1,58 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_CACHE_H
+#define POINTSTO_CACHE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+
+#include "PointsTo.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+  /*
+   * Solved points-to sets stored in a file (SLICE_PTS_CACHE), so that the
+   * passes of one pipeline and later runs on the same module do not solve
+   * them again.
+   *
+   * The file is keyed by a hash of the constraints of each function (and
+   * of the global initializers), the solver options and the data layout.
+   * Only changes which alter the constraints invalidate it. Values are
+   * stored by names which survive reading the module again: globals by
+   * their names, arguments and instructions by their position in their
+   * function.
+   */
+  class SetsCache {
+  public:
+    SetsCache(const std::string &path, const ProgramStructure &P,
+	const SolverOptions &O);
+
+    /* false if there is no usable file, @S is untouched then */
+    bool load(PointsToSets &S);
+    void store(const PointsToSets &S) const;
+
+  private:
+    typedef std::pair<std::string, std::string> FunctionHash;
+
+    std::string path;
+    bool stats;
+    /* unnamable values, nothing is cached then */
+    bool broken;
+
+    std::string options;
+    /* <name, hash of its constraints> in the module order */
+    std::vector<FunctionHash> hashes;
+    DenseMap<const Value *, std::string> names;
+    StringMap<const Value *> values;
+
+    void addValue(const Value *V, const DenseMap<const Value *, unsigned> &pos);
+  };
+
+}}}
+
+#endif
@@ -0,0 +1,381 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "ConstraintFile.h"
+#include "FieldPolicy.h"
+#include "RuleExpressions.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+static const char MAGIC[] = "LLVMSlicer rules 4\n";
+
+const uint64_t ConstraintFile::UNBOUNDED;
+const uint32_t ConstraintFile::NONE;
+
+namespace {
+
+class Compiler {
+public:
+  Compiler(const ProgramStructure &P, const FieldOptions &O,
+      ConstraintFile &F, RuleSink *out) : F(F), out(out),
+    FP(P.getModule(), O) {}
+
+  void run(const ProgramStructure &P);
+
+private:
+  ConstraintFile &F;
+  RuleSink *out;
+  FieldPolicy FP;
+  DenseMap<const Value *, uint32_t> objects;
+
+  uint32_t getObject(const Value *V);
+  uint32_t getId(const Value *V, int off = -1);
+  void add(ConstraintFile::RuleKind kind, uint32_t lval, uint32_t rval,
+      int64_t off = 0, bool isArray = false) {
+    if (out)
+      out->addRule(kind, lval, rval, off, isArray);
+    else
+      F.addRule(kind, lval, rval, off, isArray);
+  }
+};
+
+std::string getName(const Value *V) {
+  std::string name;
+
+  if (const Instruction *I = dyn_cast<Instruction>(V))
+    name = I->getParent()->getParent()->getName().str() + ":";
+  else if (const Argument *A = dyn_cast<Argument>(V))
+    name = A->getParent()->getName().str() + ":";
+  else if (isa<ConstantPointerNull>(V))
+    return "null";
+
+  return name + (V->hasName() ? V->getName().str() : "<unnamed>");
+}
+
+uint32_t Compiler::getObject(const Value *V) {
+  std::pair<DenseMap<const Value *, uint32_t>::iterator, bool> I =
+    objects.insert(std::make_pair(V, F.objects.size()));
+
+  if (I.second) {
+    const FieldPolicy::Object &X = FP.getObject(V);
+    ConstraintFile::Object O;
+
+    O.name = getName(V);
+    O.size = X.size;
+    O.flags = X.flags;
+    F.objects.push_back(O);
+    F.values.push_back(V);
+  }
+
+  return I.first->second;
+}
+
+uint32_t Compiler::getId(const Value *V, int off) {
+  return F.getLocation(getObject(V), off);
+}
+
+void Compiler::run(const ProgramStructure &P) {
+  for (ProgramStructure::const_iterator I = P.begin(), E = P.end(); I != E;
+      ++I) {
+    const Value *lval = I->getLvalue();
+    const Value *rval = I->getRvalue();
+
+    switch (I->getType()) {
+    case RCT_VAR_ASGN_ALLOC:
+    case RCT_VAR_ASGN_NULL:
+    case RCT_VAR_ASGN_REF_VAR:
+      add(ConstraintFile::R_ADDR, getId(lval), getId(rval, 0));
+      break;
+    case RCT_VAR_ASGN_VAR:
+      add(ConstraintFile::R_COPY, getId(lval), getId(rval));
+      break;
+    case RCT_VAR_ASGN_GEP: {
+      const GetElementPtrInst *gep = cast<GetElementPtrInst>(rval);
+      const Value *op = elimConstExpr(gep->getPointerOperand());
+      bool isArray = false;
+      int64_t off = FP.getOffset(gep, isArray);
+
+      if (hasExtraReference(op))
+	add(ConstraintFile::R_ADDR, getId(lval), getId(op, off));
+      else
+	add(ConstraintFile::R_GEP, getId(lval), getId(op), off, isArray);
+      break;
+    }
+    case RCT_VAR_ASGN_DREF_VAR:
+      add(ConstraintFile::R_LOAD, getId(lval), getId(rval));
+      break;
+    case RCT_DREF_VAR_ASGN_NULL:
+    case RCT_DREF_VAR_ASGN_REF_VAR:
+      add(ConstraintFile::R_STORE_ADDR, getId(lval), getId(rval, 0));
+      break;
+    case RCT_DREF_VAR_ASGN_VAR:
+      add(ConstraintFile::R_STORE, getId(lval), getId(rval));
+      break;
+    case RCT_DREF_VAR_ASGN_DREF_VAR:
+      add(ConstraintFile::R_STORE_LOAD, getId(lval), getId(rval));
+      break;
+    case RCT_DEALLOC:
+      break;
+    default:
+      assert(0 && "Unknown rule code");
+    }
+  }
+}
+
+/* the file is little-endian, the fields are swapped on other hosts */
+bool isLittleEndianHost() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+template<typename T>
+void swapBytes(T &val) {
+  unsigned char *bytes = reinterpret_cast<unsigned char *>(&val);
+  std::reverse(bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+void put(std::ostream &out, T val) {
+  if (!isLittleEndianHost())
+    swapBytes(val);
+  out.write(reinterpret_cast<const char *>(&val), sizeof(val));
+}
+
+template<typename T>
+bool get(std::istream &in, T &val) {
+  if (!in.read(reinterpret_cast<char *>(&val), sizeof(val)))
+    return false;
+  if (!isLittleEndianHost())
+    swapBytes(val);
+  return true;
+}
+
+template<typename T>
+void putArray(std::ostream &out, const std::vector<T> &V) {
+  if (V.empty())
+    return;
+  if (!isLittleEndianHost()) {
+    for (std::size_t i = 0; i < V.size(); ++i)
+      put(out, V[i]);
+    return;
+  }
+  out.write(reinterpret_cast<const char *>(&V[0]), V.size() * sizeof(T));
+}
+
+template<typename T>
+bool getArray(std::istream &in, std::vector<T> &V, uint32_t n) {
+  V.resize(n);
+  if (n && !in.read(reinterpret_cast<char *>(&V[0]), n * sizeof(T)))
+    return false;
+  if (!isLittleEndianHost())
+    for (uint32_t i = 0; i < n; ++i)
+      swapBytes(V[i]);
+  return true;
+}
+
+}
+
+/* indexes the locations read or compiled since */
+void ConstraintFile::updateIndex() {
+  for (uint32_t i = index.size(); i < locations.size(); ++i) {
+    index[std::make_pair(locations[i].object, locations[i].offset)] = i;
+    if (locations[i].offset > 0)
+      fieldsOf[locations[i].object].push_back(i);
+  }
+}
+
+uint32_t ConstraintFile::lookup(uint32_t object, int32_t offset) {
+  updateIndex();
+
+  DenseMap<std::pair<uint32_t, int32_t>, uint32_t>::const_iterator I =
+    index.find(std::make_pair(object, offset));
+  if (I != index.end())
+    return I->second;
+
+  if (offset > 0 && collapsed.count(object))
+    return lookup(object, 0);
+
+  return NONE;
+}
+
+uint32_t ConstraintFile::getLocation(uint32_t object, int32_t offset) {
+  const uint32_t id = lookup(object, offset);
+
+  if (id != NONE)
+    return id;
+  if (offset > 0 && collapsed.count(object))
+    return getLocation(object, 0);
+
+  Location L;
+
+  L.object = object;
+  L.offset = offset;
+  locations.push_back(L);
+  updateIndex();
+
+  return locations.size() - 1;
+}
+
+void ConstraintFile::collapse(uint32_t object, std::vector<uint32_t> &fields) {
+  updateIndex();
+  if (!collapsed.insert(object).second)
+    return;
+
+  DenseMap<uint32_t, std::vector<uint32_t> >::iterator I =
+    fieldsOf.find(object);
+  if (I == fieldsOf.end())
+    return;
+
+  fields.insert(fields.end(), I->second.begin(), I->second.end());
+  fieldsOf.erase(I);
+}
+
+void ConstraintFile::addRule(RuleKind kind, uint32_t lval, uint32_t rval,
+    int64_t off, bool isArray) {
+  Rules &R = rules[kind];
+
+  R.lval.push_back(lval);
+  R.rval.push_back(rval);
+  if (kind == R_GEP) {
+    R.off.push_back(off);
+    R.isArray.push_back(isArray);
+  }
+}
+
+std::size_t ConstraintFile::getNumRules() const {
+  std::size_t n = 0;
+
+  for (unsigned k = 0; k < R_KINDS; ++k)
+    n += rules[k].size();
+
+  return n;
+}
+
+bool ConstraintFile::write(const std::string &path) const {
+  std::ofstream out(path.c_str(), std::ios::binary);
+
+  out.write(MAGIC, sizeof(MAGIC) - 1);
+  put(out, uint32_t(fields.maxOffsets));
+  put(out, uint32_t(fields.arrayLimit));
+  put(out, uint8_t(fields.collapseArrays));
+  put(out, uint8_t(fields.cutRecursion));
+  put(out, uint32_t(objects.size()));
+  put(out, uint32_t(locations.size()));
+  for (unsigned k = 0; k < R_KINDS; ++k)
+    put(out, uint32_t(rules[k].size()));
+
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    put(out, uint32_t(objects[i].name.size()));
+    out.write(objects[i].name.data(), objects[i].name.size());
+    put(out, objects[i].size);
+    put(out, objects[i].flags);
+  }
+  for (std::size_t i = 0; i < locations.size(); ++i) {
+    put(out, locations[i].object);
+    put(out, locations[i].offset);
+  }
+  for (unsigned k = 0; k < R_KINDS; ++k) {
+    putArray(out, rules[k].lval);
+    putArray(out, rules[k].rval);
+    putArray(out, rules[k].off);
+    putArray(out, rules[k].isArray);
+  }
+
+  return out.good();
+}
+
+bool ConstraintFile::read(const std::string &path) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[sizeof(MAGIC) - 1];
+  uint32_t maxOffsets, arrayLimit, nObjects, nLocations, nRules[R_KINDS];
+  uint8_t collapseArrays, cutRecursion;
+
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, MAGIC, sizeof(magic)) ||
+      !get(in, maxOffsets) || !get(in, arrayLimit) ||
+      !get(in, collapseArrays) || !get(in, cutRecursion) ||
+      !get(in, nObjects) || !get(in, nLocations))
+    return false;
+  for (unsigned k = 0; k < R_KINDS; ++k)
+    if (!get(in, nRules[k]))
+      return false;
+
+  /*
+   * The counts are checked against what is left of the file before
+   * anything is allocated for them. An object takes at least its name
+   * length, size and flags, a location its object and offset.
+   */
+  const std::streamoff start = in.tellg();
+  in.seekg(0, std::ios::end);
+  const uint64_t left = in.tellg() - start;
+  in.seekg(start);
+
+  uint64_t need = uint64_t(nObjects) * (4 + 8 + 4) + uint64_t(nLocations) * 8;
+  for (unsigned k = 0; k < R_KINDS; ++k)
+    need += uint64_t(nRules[k]) * (k == R_GEP ? 4 + 4 + 8 + 1 : 4 + 4);
+  if (!in || need > left)
+    return false;
+
+  values.clear();
+  index.clear();
+  fieldsOf.clear();
+  collapsed.clear();
+  fields.maxOffsets = maxOffsets;
+  fields.arrayLimit = arrayLimit;
+  fields.collapseArrays = collapseArrays;
+  fields.cutRecursion = cutRecursion;
+
+  objects.resize(nObjects);
+  for (uint32_t i = 0; i < nObjects; ++i) {
+    uint32_t len;
+
+    if (!get(in, len) || len > left)
+      return false;
+    objects[i].name.resize(len);
+    if ((len && !in.read(&objects[i].name[0], len)) ||
+	!get(in, objects[i].size) || !get(in, objects[i].flags))
+      return false;
+  }
+
+  locations.resize(nLocations);
+  for (uint32_t i = 0; i < nLocations; ++i)
+    if (!get(in, locations[i].object) || !get(in, locations[i].offset) ||
+	locations[i].object >= nObjects)
+      return false;
+
+  for (unsigned k = 0; k < R_KINDS; ++k) {
+    Rules &R = rules[k];
+    const uint32_t n = k == R_GEP ? nRules[k] : 0;
+
+    if (!getArray(in, R.lval, nRules[k]) ||
+	!getArray(in, R.rval, nRules[k]) ||
+	!getArray(in, R.off, n) || !getArray(in, R.isArray, n))
+      return false;
+    for (uint32_t i = 0; i < nRules[k]; ++i)
+      if (R.lval[i] >= nLocations || R.rval[i] >= nLocations)
+	return false;
+  }
+
+  return true;
+}
+
+void compileConstraints(const ProgramStructure &P, const FieldOptions &O,
+    ConstraintFile &F, RuleSink *out) {
+  F = ConstraintFile();
+  F.fields = O;
+  Compiler(P, O, F, out).run(P);
+}
+
+}}}
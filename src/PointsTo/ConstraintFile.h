@@ -0,0 +1,166 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_CONSTRAINTFILE_H
+#define POINTSTO_CONSTRAINTFILE_H
+
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/DataTypes.h"
+
+#include "PointsTo.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+  /*
+   * The rules of a ProgramStructure in a form which needs no IR. This is
+   * what the sweep solvers (Sweep.cpp, OutOfCore.cpp) run on, the other
+   * solvers can build their graphs from it too, and it can be written and
+   * solved elsewhere (SLICE_PTS_DUMP and test/solve-points-to.cpp). The values are numbered objects, the
+   * <object, offset> pairs numbered locations (see LocationTable) and the
+   * rules refer to locations. What the solvers would ask the IR about, the
+   * GEP offsets and the object sizes (see FieldPolicy), is computed when
+   * the rules are compiled.
+   *
+   * The rules are grouped by kind, each group is a few plain arrays: the
+   * two sides, and the offset and the array flag for GEPs only. A solver
+   * sweeps them kind by kind, with no dispatch per rule.
+   *
+   * The binary file is the header, the objects, the locations and the
+   * rules group by group, as fixed-size little-endian fields, so that it
+   * reads the same on any host.
+   */
+  struct ConstraintFile {
+    enum RuleKind {
+      R_ADDR,		/* lval = &rval, rval is the pointee */
+      R_COPY,		/* lval = rval */
+      R_GEP,		/* lval = gep rval */
+      R_LOAD,		/* lval = *rval */
+      R_STORE_ADDR,	/* *lval = &rval */
+      R_STORE,		/* *lval = rval */
+      R_STORE_LOAD,	/* *lval = *rval */
+      R_KINDS
+    };
+
+    enum ObjectFlags {
+      OF_FUNCTION = 1,
+      OF_NULL = 2,
+    };
+
+    /* the size of objects whose offsets are not checked */
+    static const uint64_t UNBOUNDED = ~0ULL;
+    /* no such location */
+    static const uint32_t NONE = ~0U;
+
+    struct Object {
+      std::string name;	/* for people, not unique */
+      uint64_t size;
+      uint32_t flags;
+    };
+
+    struct Location {
+      uint32_t object;
+      int32_t offset;
+    };
+
+    /* the rules of one kind, the i-th is lval[i] and rval[i] */
+    struct Rules {
+      std::vector<uint32_t> lval;
+      std::vector<uint32_t> rval;
+      /* R_GEP only, the constant offset and whether an array is indexed */
+      std::vector<int64_t> off;
+      std::vector<uint8_t> isArray;
+
+      std::size_t size() const { return lval.size(); }
+    };
+
+    /* what the rules were compiled with, the defaults for solving */
+    FieldOptions fields;
+    std::vector<Object> objects;
+    std::vector<Location> locations;
+    /* by RuleKind */
+    Rules rules[R_KINDS];
+    /*
+     * The value of each object if the rules were compiled in this process,
+     * so that the sets can be told in PointsToSets. Not written.
+     */
+    std::vector<const Value *> values;
+
+    /*
+     * The id of <@object, @offset>, it is added if there is none. A new
+     * field of a collapsed object is <@object, 0>.
+     */
+    uint32_t getLocation(uint32_t object, int32_t offset);
+    /* the same, but NONE if there is none */
+    uint32_t lookup(uint32_t object, int32_t offset);
+    /*
+     * Collapses @object as LocationTable::collapse() does. The fields it
+     * has locations for already are appended to @fields.
+     */
+    void collapse(uint32_t object, std::vector<uint32_t> &fields);
+
+    void addRule(RuleKind kind, uint32_t lval, uint32_t rval,
+	int64_t off = 0, bool isArray = false);
+    std::size_t getNumRules() const;
+
+    bool write(const std::string &path) const;
+    /*
+     * False if @path is not a file written by write(), also if the counts
+     * in its header do not fit in the size of the file.
+     */
+    bool read(const std::string &path);
+
+  private:
+    /* locations by <object, offset>, built as getLocation() is asked */
+    DenseMap<std::pair<uint32_t, int32_t>, uint32_t> index;
+    /* the locations past offset 0 of an object, for collapse() */
+    DenseMap<uint32_t, std::vector<uint32_t> > fieldsOf;
+    DenseSet<uint32_t> collapsed;
+
+    void updateIndex();
+  };
+
+  /* takes the rules as they are compiled, instead of ConstraintFile::rules */
+  class RuleSink {
+  public:
+    virtual ~RuleSink() {}
+    virtual void addRule(ConstraintFile::RuleKind kind, uint32_t lval,
+		  uint32_t rval, int64_t off, bool isArray) = 0;
+  };
+
+  /*
+   * Compiles @P into @F. With @out, the rules go there and those of @F are
+   * left empty, so that they need not be held in memory.
+   */
+  void compileConstraints(const ProgramStructure &P, const FieldOptions &O,
+		  ConstraintFile &F, RuleSink *out = 0);
+
+  class Budget;
+
+  /*
+   * Solves the rules of @F by sweeping them, with the GEP offsets limited
+   * by @O. This is solveSweep() once the rules are compiled. The sets are
+   * stored to @sets by location, sorted. GEPs may add locations to @F.
+   * Returns the number of sweeps.
+   */
+  unsigned solveConstraintFile(ConstraintFile &F, const FieldOptions &O,
+		  std::vector<std::vector<uint32_t> > &sets, Budget *B = 0);
+
+  /*
+   * The same with the other solvers (see Solvers.h), their graphs are built
+   * from the locations of @F. There are no calls to resolve.
+   */
+  void solveWorklist(ConstraintFile &F, const FieldOptions &O,
+		  std::vector<std::vector<uint32_t> > &sets, Budget *B = 0);
+  /* @threads == 0 means one per core */
+  void solveWave(ConstraintFile &F, unsigned threads, const FieldOptions &O,
+		  std::vector<std::vector<uint32_t> > &sets, Budget *B = 0);
+  void solveSteensgaard(ConstraintFile &F, const FieldOptions &O,
+		  std::vector<std::vector<uint32_t> > &sets);
+
+}}}
+
+#endif
@@ -0,0 +1,496 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <algorithm>
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "ConstraintGraph.h"
+#include "RuleExpressions.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+ConstraintGraph::ConstraintGraph(const ProgramStructure &P, LocationTable &L,
+    const FieldOptions &O) : F(P.getModule(), O), L(&L), CF(0), collapsed(0) {
+  for (ProgramStructure::const_iterator I = P.begin(), E = P.end(); I != E;
+      ++I)
+    addRule(*I);
+
+  /* collapsed while solving for the same table before */
+  collapsedFields = L.getCollapsed();
+}
+
+ConstraintGraph::ConstraintGraph(ConstraintFile &CF, const FieldOptions &O) :
+    F(O), L(0), CF(&CF), collapsed(0) {
+  if (!CF.locations.empty())
+    grow(CF.locations.size() - 1);
+
+  for (unsigned k = 0; k < ConstraintFile::R_KINDS; ++k)
+    addRules(CF.rules[k], ConstraintFile::RuleKind(k));
+}
+
+NodeId ConstraintGraph::grow(NodeId n) {
+  while (nodes.size() <= n)
+    nodes.push_back(Node(nodes.size()));
+
+  return n;
+}
+
+NodeId ConstraintGraph::getNode(const Value *V, int off) {
+  assert(L && "No values in a graph of compiled rules");
+  return grow(L->getId(V, off));
+}
+
+NodeId ConstraintGraph::getKey(const Value *V, int off) {
+  NodeId n = getNode(V, off);
+
+  nodes[n].key = true;
+
+  return n;
+}
+
+NodeId ConstraintGraph::find(NodeId n) {
+  NodeId r = n;
+
+  while (nodes[r].rep != r)
+    r = nodes[r].rep;
+
+  while (nodes[n].rep != r) {
+    NodeId next = nodes[n].rep;
+    nodes[n].rep = r;
+    n = next;
+  }
+
+  return r;
+}
+
+NodeId ConstraintGraph::find(NodeId n) const {
+  while (nodes[n].rep != n)
+    n = nodes[n].rep;
+
+  return n;
+}
+
+/*
+ * Only the structure is built here. The solver pushes every node with
+ * a non-empty set at the start, so the sets flow along these edges then.
+ */
+void ConstraintGraph::addRule(const RuleCode &RC) {
+  const Value *lval = RC.getLvalue();
+  const Value *rval = RC.getRvalue();
+
+  switch (RC.getType()) {
+  case RCT_VAR_ASGN_ALLOC:
+  case RCT_VAR_ASGN_NULL:
+  case RCT_VAR_ASGN_REF_VAR: {
+    NodeId l = getKey(lval), r = getNode(rval, 0);
+    nodes[l].pts.insert(r);
+    break;
+  }
+  case RCT_VAR_ASGN_VAR: {
+    NodeId l = getKey(lval), r = getKey(rval);
+    addCopyEdge(r, l);
+    break;
+  }
+  case RCT_VAR_ASGN_GEP: {
+    const GetElementPtrInst *gep = cast<GetElementPtrInst>(rval);
+    const Value *op = elimConstExpr(gep->getPointerOperand());
+    bool isArray = false;
+    int64_t off = F.getOffset(gep, isArray);
+    NodeId l = getKey(lval);
+
+    if (L->getInfo(op).extraRef) {
+      NodeId r = getNode(op, off);
+      nodes[l].pts.insert(r);
+    } else
+      nodes[getKey(op)].gepTo.push_back(GepEdge(l, off, isArray));
+    break;
+  }
+  case RCT_VAR_ASGN_DREF_VAR: {
+    NodeId l = getKey(lval), r = getKey(rval);
+    addLoadEdge(r, l);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_NULL:
+  case RCT_DREF_VAR_ASGN_REF_VAR: {
+    NodeId l = getKey(lval), r = getNode(rval, 0);
+    nodes[l].storeAddr.push_back(r);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_VAR: {
+    NodeId l = getKey(lval), r = getKey(rval);
+    nodes[l].storeFrom.push_back(r);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_DREF_VAR: {
+    NodeId l = getKey(lval), r = getKey(rval);
+    nodes[l].storeLoad.push_back(r);
+    break;
+  }
+  case RCT_DEALLOC:
+    break;
+  default:
+    assert(0 && "Unknown rule code");
+  }
+}
+
+/* The same translation, the rules were compiled with it already. */
+void ConstraintGraph::addRules(const ConstraintFile::Rules &R,
+    ConstraintFile::RuleKind kind) {
+  for (std::size_t i = 0; i < R.size(); ++i) {
+    const NodeId l = R.lval[i], r = R.rval[i];
+
+    nodes[l].key = true;
+    if (kind != ConstraintFile::R_ADDR && kind != ConstraintFile::R_STORE_ADDR)
+      nodes[r].key = true;
+
+    switch (kind) {
+    case ConstraintFile::R_ADDR:
+      nodes[l].pts.insert(r);
+      break;
+    case ConstraintFile::R_COPY:
+      addCopyEdge(r, l);
+      break;
+    case ConstraintFile::R_GEP:
+      nodes[r].gepTo.push_back(GepEdge(l, R.off[i], R.isArray[i]));
+      break;
+    case ConstraintFile::R_LOAD:
+      addLoadEdge(r, l);
+      break;
+    case ConstraintFile::R_STORE_ADDR:
+      nodes[l].storeAddr.push_back(r);
+      break;
+    case ConstraintFile::R_STORE:
+      nodes[l].storeFrom.push_back(r);
+      break;
+    case ConstraintFile::R_STORE_LOAD:
+      nodes[l].storeLoad.push_back(r);
+      break;
+    default:
+      assert(0 && "Unknown rule kind");
+    }
+  }
+}
+
+bool ConstraintGraph::addCopyEdge(NodeId src, NodeId dst) {
+  src = find(src);
+  dst = find(dst);
+
+  if (src == dst || !copyEdges.insert(std::make_pair(src, dst)).second)
+    return false;
+
+  nodes[src].copyTo.push_back(dst);
+  return true;
+}
+
+bool ConstraintGraph::addLoadEdge(NodeId src, NodeId dst) {
+  src = find(src);
+
+  if (!loadEdges.insert(std::make_pair(src, dst)).second)
+    return false;
+
+  nodes[src].loadTo.push_back(dst);
+  return true;
+}
+
+/*
+ * See FieldPolicy, the offsets are counted per representative. An object
+ * collapsed here is left to the solver, see takeCollapsedFields().
+ */
+bool ConstraintGraph::insertGep(const GepEdge &E, NodeId pointee) {
+  const NodeId dst = find(E.dst);
+  NodeSet &Dst = nodes[dst].pts;
+
+  /* disable recursive structures */
+  if (F.getOptions().cutRecursion && Dst.count(pointee))
+    return false;
+
+  int64_t sum;
+
+  if (CF) {
+    /* a copy, getLocation() may add locations */
+    const ConstraintFile::Location X = CF->locations[pointee];
+    const ConstraintFile::Object &O = CF->objects[X.object];
+
+    if (!F.move(dst, X.object, O.size, O.flags, X.offset, E.off, E.isArray,
+	  sum))
+      return false;
+
+    collapseObjects();
+    return Dst.insert(grow(CF->getLocation(X.object, sum)));
+  }
+
+  const Value *Rval = getLocation(pointee).first;
+
+  if (!F.move(dst, Rval, getLocation(pointee).second, E.off, E.isArray, sum))
+    return false;
+
+  collapseObjects();
+
+  return Dst.insert(getNode(Rval, sum));
+}
+
+void ConstraintGraph::collapseObjects() {
+  if (!F.takeCollapsed(objects))
+    return;
+
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    if (L) {
+      L->collapse(F.getValue(objects[i]), collapsedFields);
+      continue;
+    }
+
+    std::vector<uint32_t> fields;
+    CF->collapse(objects[i], fields);
+
+    const NodeId first = grow(CF->getLocation(objects[i], 0));
+    for (std::size_t j = 0; j < fields.size(); ++j)
+      collapsedFields.push_back(std::make_pair(fields[j], first));
+  }
+}
+
+bool ConstraintGraph::takeCollapsedFields(
+    std::vector<std::pair<NodeId, NodeId> > &fields) {
+  /* the <object, 0> nodes may be new */
+  const std::size_t n = L ? L->size() : CF->locations.size();
+  if (n)
+    grow(n - 1);
+
+  fields.clear();
+  fields.swap(collapsedFields);
+
+  return !fields.empty();
+}
+
+template<typename T>
+static void append(std::vector<T> &dst, std::vector<T> &src) {
+  dst.insert(dst.end(), src.begin(), src.end());
+  std::vector<T>().swap(src);
+}
+
+/*
+ * Nodes on a copy cycle end up with the same points-to set. Keep only one of
+ * them, the representative, and let the others forward to it.
+ */
+NodeId ConstraintGraph::merge(NodeId a, NodeId b) {
+  a = find(a);
+  b = find(b);
+
+  if (a == b)
+    return a;
+
+  if (nodes[a].pts.size() < nodes[b].pts.size())
+    std::swap(a, b);
+
+  Node &R = nodes[a];
+  Node &O = nodes[b];
+
+  O.rep = a;
+  R.pts.unionWith(O.pts);
+
+  /* what was pushed along the edges of both of them */
+  R.done.intersectWith(O.done);
+
+  append(R.copyTo, O.copyTo);
+  append(R.gepTo, O.gepTo);
+  append(R.loadTo, O.loadTo);
+  append(R.storeFrom, O.storeFrom);
+  append(R.storeAddr, O.storeAddr);
+  append(R.storeLoad, O.storeLoad);
+  append(R.calls, O.calls);
+
+  /* the offsets moved to b count for a now, see FieldPolicy */
+  for (NodeSet::const_iterator I = O.pts.begin(), E = O.pts.end(); I != E;
+      ++I)
+    if (L)
+      F.merge(b, a, getLocation(*I).first);
+    else
+      F.merge(b, a, CF->locations[*I].object);
+  collapseObjects();
+
+  O.pts.clear();
+  O.done.clear();
+
+  collapsed++;
+
+  return a;
+}
+
+/*
+ * Iterative Tarjan, SSA copy chains can be really long.
+ */
+void ConstraintGraph::collapseCycles(NodeId from,
+    SmallVectorImpl<NodeId> &reps) {
+  typedef std::pair<NodeId, std::size_t> Frame;
+  DenseMap<NodeId, unsigned> index, lowlink;
+  DenseSet<NodeId> onStack;
+  std::vector<NodeId> stack;
+  std::vector<Frame> frames;
+  unsigned counter = 0;
+
+  from = find(from);
+  index[from] = lowlink[from] = counter++;
+  stack.push_back(from);
+  onStack.insert(from);
+  frames.push_back(Frame(from, 0));
+
+  while (!frames.empty()) {
+    const NodeId n = frames.back().first;
+    const std::size_t next = frames.back().second;
+
+    if (next < nodes[n].copyTo.size()) {
+      NodeId m = find(nodes[n].copyTo[next]);
+
+      frames.back().second++;
+      if (m == n)
+	continue;
+
+      if (!index.count(m)) {
+	index[m] = lowlink[m] = counter++;
+	stack.push_back(m);
+	onStack.insert(m);
+	frames.push_back(Frame(m, 0));
+      } else if (onStack.count(m))
+	lowlink[n] = std::min(lowlink[n], index[m]);
+      continue;
+    }
+
+    frames.pop_back();
+    if (!frames.empty()) {
+      NodeId parent = frames.back().first;
+      lowlink[parent] = std::min(lowlink[parent], lowlink[n]);
+    }
+
+    if (lowlink[n] != index[n])
+      continue;
+
+    NodeId rep = n;
+    bool merged = false;
+    while (true) {
+      NodeId m = stack.back();
+
+      stack.pop_back();
+      onStack.erase(m);
+      if (m == n)
+	break;
+      rep = merge(rep, m);
+      merged = true;
+    }
+
+    if (merged)
+      reps.push_back(rep);
+  }
+}
+
+/*
+ * The same as collapseCycles(), but for the whole graph at once. Tarjan's
+ * algorithm finishes the components sinks first, so the reversed sequence of
+ * the representatives is a topological order of the collapsed graph.
+ */
+void ConstraintGraph::collapseAll(std::vector<NodeId> &order) {
+  typedef std::pair<NodeId, std::size_t> Frame;
+  static const unsigned UNVISITED = ~0U;
+  std::vector<unsigned> index(nodes.size(), UNVISITED), lowlink(nodes.size());
+  std::vector<bool> onStack(nodes.size());
+  std::vector<NodeId> stack;
+  std::vector<Frame> frames;
+  unsigned counter = 0;
+
+  order.clear();
+
+  for (NodeId root = 0; root < nodes.size(); ++root) {
+    if (find(root) != root || index[root] != UNVISITED)
+      continue;
+
+    index[root] = lowlink[root] = counter++;
+    stack.push_back(root);
+    onStack[root] = true;
+    frames.push_back(Frame(root, 0));
+
+    while (!frames.empty()) {
+      const NodeId n = frames.back().first;
+      const std::size_t next = frames.back().second;
+
+      if (next < nodes[n].copyTo.size()) {
+	NodeId m = find(nodes[n].copyTo[next]);
+
+	frames.back().second++;
+	if (m == n)
+	  continue;
+
+	if (index[m] == UNVISITED) {
+	  index[m] = lowlink[m] = counter++;
+	  stack.push_back(m);
+	  onStack[m] = true;
+	  frames.push_back(Frame(m, 0));
+	} else if (onStack[m])
+	  lowlink[n] = std::min(lowlink[n], index[m]);
+	continue;
+      }
+
+      frames.pop_back();
+      if (!frames.empty()) {
+	NodeId parent = frames.back().first;
+	lowlink[parent] = std::min(lowlink[parent], lowlink[n]);
+      }
+
+      if (lowlink[n] != index[n])
+	continue;
+
+      NodeId rep = n;
+      while (true) {
+	NodeId m = stack.back();
+
+	stack.pop_back();
+	onStack[m] = false;
+	if (m == n)
+	  break;
+	rep = merge(rep, m);
+      }
+      order.push_back(rep);
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+}
+
+void ConstraintGraph::fill(PointsToSets &S) const {
+  /* collapsed nodes share the set of their representative */
+  std::vector<const PointsToSets::PointsToSet *> shared(nodes.size());
+
+  for (NodeId n = 0; n < nodes.size(); ++n) {
+    const Node &N = nodes[n];
+
+    if (!N.key)
+      continue;
+
+    const NodeId rep = find(n);
+    if (!shared[rep]) {
+      const NodeSet &pts = nodes[rep].pts;
+      PointsToSets::PointsToSet X;
+      for (NodeSet::const_iterator I = pts.begin(), E = pts.end(); I != E;
+	  ++I)
+	X.insert(getLocation(*I));
+      shared[rep] = S.intern(X);
+    }
+    S.assign(n, shared[rep]);
+  }
+}
+
+void ConstraintGraph::fill(std::vector<std::vector<uint32_t> > &sets) const {
+  sets.assign(CF->locations.size(), std::vector<uint32_t>());
+
+  for (NodeId n = 0; n < nodes.size(); ++n) {
+    if (!nodes[n].key)
+      continue;
+
+    const NodeSet &pts = nodes[find(n)].pts;
+    sets[n].assign(pts.begin(), pts.end());
+  }
+}
+
+}}}
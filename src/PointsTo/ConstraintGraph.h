@@ -0,0 +1,146 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_CONSTRAINTGRAPH_H
+#define POINTSTO_CONSTRAINTGRAPH_H
+
+#include <deque>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "FieldPolicy.h"
+#include "PointsTo.h"
+#include "SparseBitmap.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+  typedef LocationTable::LocationId NodeId;
+  typedef SparseBitmap NodeSet;
+
+  struct GepEdge {
+    GepEdge(NodeId dst, int64_t off, bool isArray) : dst(dst), off(off),
+      isArray(isArray) {}
+
+    NodeId dst;
+    int64_t off;
+    bool isArray;
+  };
+
+  /*
+   * A node is a <location, offset> pair, its id is the one from the
+   * LocationTable, or that of ConstraintFile::locations for a graph built
+   * from compiled rules. Points-to sets contain node ids of the pointees as
+   * they were created, but a node itself may be merged into another one (its
+   * representative, see ConstraintGraph::find) when they are found to be on
+   * a copy cycle. Only representatives carry sets and edges.
+   */
+  struct Node {
+    explicit Node(NodeId self) : rep(self), key(false), queued(false) {}
+
+    NodeId rep;
+
+    NodeSet pts;		/* current points-to set */
+    NodeSet done;		/* already pushed along the edges */
+
+    std::vector<NodeId> copyTo;	/* dst = this */
+    std::vector<GepEdge> gepTo;	/* dst = gep this */
+    std::vector<NodeId> loadTo;	/* dst = *this */
+    std::vector<NodeId> storeFrom;	/* *this = src */
+    std::vector<NodeId> storeAddr;	/* *this = &src, src is a pointee */
+    std::vector<NodeId> storeLoad;	/* *this = *src */
+    /* indices to ProgramStructure::getIndirectCalls() going through this */
+    std::vector<unsigned> calls;
+
+    bool key;			/* the sweep solver would create an entry */
+    bool queued;
+  };
+
+  class ConstraintGraph {
+  public:
+    /* the nodes are interned in @L */
+    ConstraintGraph(const ProgramStructure &P, LocationTable &L,
+	const FieldOptions &O);
+    /*
+     * The same for compiled rules, which need no module. The nodes are
+     * the locations of @CF and gep edges add new ones there. Such a graph
+     * has no values: getLocation(), getNode() and getKey() are for the
+     * former one only.
+     */
+    ConstraintGraph(ConstraintFile &CF, const FieldOptions &O);
+
+    const LocationTable::Location &getLocation(NodeId n) const {
+      assert(L && "No values in a graph of compiled rules");
+      return L->getLocation(n);
+    }
+    std::size_t size() const { return nodes.size(); }
+    Node &operator[](NodeId n) { return nodes[n]; }
+    const Node &operator[](NodeId n) const { return nodes[n]; }
+
+    NodeId getNode(const Value *V, int off);
+    /* the same, but the node gets an entry in PointsToSets */
+    NodeId getKey(const Value *V, int off = -1);
+    NodeId find(NodeId n);
+    NodeId find(NodeId n) const;
+
+    /* returns false if the edge is already there */
+    bool addCopyEdge(NodeId src, NodeId dst);
+    bool addLoadEdge(NodeId src, NodeId dst);
+    /*
+     * Adds what @pointee becomes after the gep of @E to the set of its
+     * destination. Returns true if the set has grown.
+     */
+    bool insertGep(const GepEdge &E, NodeId pointee);
+    /*
+     * Moves the <field, <object, 0>> pairs of the objects collapsed since
+     * the last call (see FieldPolicy) to @fields. The solver ties each pair
+     * by copy edges both ways, so that they end up with the same set.
+     * Returns false if there are none.
+     */
+    bool takeCollapsedFields(std::vector<std::pair<NodeId, NodeId> > &fields);
+
+    /*
+     * Collapses strongly connected components (over copy edges) reachable
+     * from @from. The representatives of the merged nodes are appended to
+     * @reps.
+     */
+    void collapseCycles(NodeId from, SmallVectorImpl<NodeId> &reps);
+    /*
+     * Collapses all the strongly connected components over copy edges and
+     * stores the representatives to @order, topologically sorted.
+     */
+    void collapseAll(std::vector<NodeId> &order);
+    unsigned getCollapsed() const { return collapsed; }
+
+    /* @S has to own the LocationTable of the graph */
+    void fill(PointsToSets &S) const;
+    /* the same by location of @CF, sorted, as solveConstraintFile() */
+    void fill(std::vector<std::vector<uint32_t> > &sets) const;
+
+  private:
+    FieldPolicy F;
+    /* exactly one of them is set */
+    LocationTable *L;
+    ConstraintFile *CF;
+    /* deque, so that references survive adding new nodes */
+    std::deque<Node> nodes;
+    DenseSet<std::pair<NodeId, NodeId> > copyEdges;
+    DenseSet<std::pair<NodeId, NodeId> > loadEdges;
+    unsigned collapsed;
+    /* for takeCollapsedFields() */
+    std::vector<std::pair<NodeId, NodeId> > collapsedFields;
+    std::vector<unsigned> objects;
+
+    void addRule(const RuleCode &RC);
+    void addRules(const ConstraintFile::Rules &R,
+	ConstraintFile::RuleKind kind);
+    /* makes sure node @n exists */
+    NodeId grow(NodeId n);
+    NodeId merge(NodeId a, NodeId b);
+    void collapseObjects();
+  };
+
+}}}
+
+#endif
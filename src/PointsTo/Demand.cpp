@@ -0,0 +1,467 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Demand-driven points-to queries (in the spirit of Heintze and Tardieu).
+ *
+ * The constraint graph (see ConstraintGraph.h) is built for the whole
+ * module, which is cheap, but sets are propagated only among the demanded
+ * nodes. Demanding a node demands everything it may get pointees from:
+ *
+ *   copies and geps	the sources of the edges
+ *   loads (n = *r)	r, and then every pointee of r
+ *   objects		the pointers of the stores which may write into the
+ *			object, so that the stores which do are known
+ *
+ * Which stores may write into an object is told by unification (see
+ * Steensgaard.cpp), cheap and sound: a store pointer whose pointees are in
+ * no class with the object cannot point to it. It is run at the first
+ * object demanded.
+ *
+ * The demanded nodes are closed under these dependencies, hence once the
+ * worklist is empty, their sets are final. The following queries only
+ * extend the demanded part. Nothing is built before the first query.
+ */
+
+#include <deque>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ConstraintGraph.h"
+#include "HashConsPool.h"
+#include "PointsTo.h"
+#include "Solvers.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+class DemandEngine {
+public:
+  typedef PointsToSets::PointsToSet PTSet;
+
+  DemandEngine(Module &M, LocationTable &L, const SolverOptions &O) :
+    M(M), P(0), L(L), G(0), options(O), storesIndexed(false), whole(0) {}
+  ~DemandEngine() { delete whole; delete G; delete P; }
+
+  const PTSet *query(const PointsToSets::Pointer &P);
+  bool isSolved(const PointsToSets::Pointer &P) const;
+
+private:
+  Module &M;
+  /* the rules and the graph of the whole module, see init() */
+  ProgramStructure *P;
+  LocationTable &L;
+  ConstraintGraph *G;
+  SolverOptions options;
+
+  /* reverse edges of the graph as built, new edges are added on demand */
+  std::vector<std::vector<NodeId> > copyFrom;
+  std::vector<std::vector<std::pair<NodeId, std::size_t> > > gepFrom;
+  std::vector<std::vector<NodeId> > loadFrom;
+  /* nodes with stores through them */
+  std::vector<NodeId> storePtrs;
+  /* the store pointers by the class of their pointees, see indexStores() */
+  bool storesIndexed;
+  std::vector<std::vector<NodeId> > storesByClass;
+  std::vector<bool> classDemanded;
+  /* object -> the classes its fields are in */
+  DenseMap<const Value *, SmallVector<unsigned, 2> > classesOf;
+
+  std::vector<bool> demanded;
+  /* pointee -> stores whose pointer points to it */
+  std::vector<std::vector<NodeId> > storesTo;
+  std::vector<const PTSet *> answers;
+  HashConsPool<PTSet> pool;
+
+  std::vector<NodeId> unexpanded;
+  std::deque<NodeId> worklist;
+
+  /* the whole module solved once a query ran out of budget */
+  PointsToSets *whole;
+
+  void init();
+  void grow();
+  bool isStore(NodeId n) const;
+  void push(NodeId n);
+  void demand(NodeId n);
+  void indexStores();
+  void demandStores(NodeId n);
+  void addCopyEdge(NodeId src, NodeId dst);
+  void addLoadEdge(NodeId src, NodeId dst);
+  void tieFields();
+  void applyStore(NodeId l, NodeId o);
+  void expand(NodeId n);
+  void visit(NodeId n);
+  bool solve();
+};
+
+void DemandEngine::init() {
+  if (G)
+    return;
+
+  P = new ProgramStructure(M, false, options.threads);
+  G = new ConstraintGraph(*P, L, options.fields);
+  grow();
+
+  for (NodeId n = 0; n < G->size(); ++n) {
+    const Node &N = (*G)[n];
+
+    for (std::size_t i = 0; i < N.copyTo.size(); ++i)
+      copyFrom[N.copyTo[i]].push_back(n);
+    for (std::size_t i = 0; i < N.gepTo.size(); ++i)
+      gepFrom[N.gepTo[i].dst].push_back(std::make_pair(n, i));
+    for (std::size_t i = 0; i < N.loadTo.size(); ++i)
+      loadFrom[N.loadTo[i]].push_back(n);
+    if (isStore(n))
+      storePtrs.push_back(n);
+  }
+}
+
+/* the gep edges create nodes as they go */
+void DemandEngine::grow() {
+  const std::size_t size = G->size();
+
+  if (demanded.size() == size)
+    return;
+
+  copyFrom.resize(size);
+  gepFrom.resize(size);
+  loadFrom.resize(size);
+  demanded.resize(size);
+  storesTo.resize(size);
+  answers.resize(size);
+}
+
+bool DemandEngine::isStore(NodeId n) const {
+  const Node &N = (*G)[n];
+
+  return !N.storeFrom.empty() || !N.storeAddr.empty() || !N.storeLoad.empty();
+}
+
+void DemandEngine::push(NodeId n) {
+  Node &N = (*G)[n];
+
+  if (!N.queued) {
+    N.queued = true;
+    worklist.push_back(n);
+  }
+}
+
+void DemandEngine::demand(NodeId n) {
+  grow();
+
+  if (demanded[n])
+    return;
+
+  demanded[n] = true;
+  unexpanded.push_back(n);
+}
+
+/*
+ * The store pointers pointing to the same class by unification are put
+ * together. The classes are told by the shared sets, one per class. They
+ * are matched with the objects by value, so that the offsets do not
+ * matter, the two solvers may collapse different objects.
+ */
+void DemandEngine::indexStores() {
+  PointsToSets U;
+  DenseMap<const PTSet *, unsigned> classes;
+
+  storesIndexed = true;
+  solveSteensgaard(*P, U, options.fields);
+
+  for (std::size_t i = 0; i < storePtrs.size(); ++i) {
+    const PTSet *X = U.query(G->getLocation(storePtrs[i]));
+    if (!X)
+      continue;
+
+    std::pair<DenseMap<const PTSet *, unsigned>::iterator, bool> I =
+      classes.insert(std::make_pair(X, storesByClass.size()));
+    const unsigned c = I.first->second;
+
+    if (I.second) {
+      storesByClass.push_back(std::vector<NodeId>());
+      for (PTSet::const_iterator E = X->begin(), EE = X->end(); E != EE;
+	  ++E) {
+	SmallVector<unsigned, 2> &C = classesOf[E->first];
+	if (C.empty() || C.back() != c)
+	  C.push_back(c);
+      }
+    }
+    storesByClass[c].push_back(storePtrs[i]);
+  }
+
+  classDemanded.resize(storesByClass.size());
+}
+
+/* the pointers of the stores which may write into the object @n */
+void DemandEngine::demandStores(NodeId n) {
+  if (!storesIndexed)
+    indexStores();
+
+  DenseMap<const Value *, SmallVector<unsigned, 2> >::const_iterator I =
+    classesOf.find(G->getLocation(n).first);
+  if (I == classesOf.end())
+    return;
+
+  for (std::size_t i = 0; i < I->second.size(); ++i) {
+    const unsigned c = I->second[i];
+
+    if (classDemanded[c])
+      continue;
+    classDemanded[c] = true;
+    for (std::size_t j = 0; j < storesByClass[c].size(); ++j)
+      demand(storesByClass[c][j]);
+  }
+}
+
+/*
+ * @dst is demanded. The edge carries the whole set of @src at once, even if
+ * it was there before @dst was demanded.
+ */
+void DemandEngine::addCopyEdge(NodeId src, NodeId dst) {
+  demand(src);
+  G->addCopyEdge(src, dst);
+  if ((*G)[dst].pts.unionWith((*G)[src].pts))
+    push(dst);
+}
+
+/* dst = *src, @dst is demanded */
+void DemandEngine::addLoadEdge(NodeId src, NodeId dst) {
+  demand(src);
+  G->addLoadEdge(src, dst);
+
+  const NodeSet S = (*G)[src].pts;
+  for (NodeSet::const_iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    (*G)[*I].key = true;
+    addCopyEdge(*I, dst);
+  }
+}
+
+/*
+ * See ConstraintGraph::takeCollapsedFields(). Both ends are demanded, they
+ * stand for the same object.
+ */
+void DemandEngine::tieFields() {
+  std::vector<std::pair<NodeId, NodeId> > fields;
+
+  if (!G->takeCollapsedFields(fields))
+    return;
+
+  grow();
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    demand(fields[i].first);
+    demand(fields[i].second);
+    addCopyEdge(fields[i].first, fields[i].second);
+    addCopyEdge(fields[i].second, fields[i].first);
+  }
+}
+
+/* the stores through @l write into @o, which is demanded */
+void DemandEngine::applyStore(NodeId l, NodeId o) {
+  const Node &N = (*G)[l];
+
+  for (std::size_t i = 0; i < N.storeFrom.size(); ++i)
+    addCopyEdge(N.storeFrom[i], o);
+  for (std::size_t i = 0; i < N.storeAddr.size(); ++i)
+    if ((*G)[o].pts.insert(N.storeAddr[i]))
+      push(o);
+  for (std::size_t i = 0; i < N.storeLoad.size(); ++i)
+    addLoadEdge(N.storeLoad[i], o);
+}
+
+/*
+ * @n has just been demanded. Its sources may have pushed their sets
+ * already, so it takes them as they are now. What they gain later comes
+ * through visit().
+ */
+void DemandEngine::expand(NodeId n) {
+  grow();
+
+  for (std::size_t i = 0; i < copyFrom[n].size(); ++i)
+    addCopyEdge(copyFrom[n][i], n);
+
+  for (std::size_t i = 0; i < gepFrom[n].size(); ++i) {
+    const NodeId r = gepFrom[n][i].first;
+    const GepEdge E = (*G)[r].gepTo[gepFrom[n][i].second];
+    bool change = false;
+
+    demand(r);
+    const NodeSet S = (*G)[r].pts;
+    for (NodeSet::const_iterator I = S.begin(), EE = S.end(); I != EE; ++I)
+      change |= G->insertGep(E, *I);
+    if (change)
+      push(n);
+  }
+  tieFields();
+
+  for (std::size_t i = 0; i < loadFrom[n].size(); ++i)
+    addLoadEdge(loadFrom[n][i], n);
+
+  /* only objects are written through pointers */
+  if (G->getLocation(n).second >= 0) {
+    demandStores(n);
+    for (std::size_t i = 0; i < storesTo[n].size(); ++i)
+      applyStore(storesTo[n][i], n);
+  }
+
+  push(n);
+}
+
+/*
+ * The same as WorklistSolver::visit(), but the edges are followed only to
+ * the demanded nodes.
+ */
+void DemandEngine::visit(NodeId n) {
+  Node &N = (*G)[n];
+  NodeSet D;
+
+  grow();
+
+  D.assignDifference(N.pts, N.done);
+  N.done.unionWith(D);
+
+  const bool store = isStore(n);
+  for (NodeSet::const_iterator I = D.begin(), E = D.end(); I != E; ++I) {
+    const NodeId o = *I;
+
+    if (!N.loadTo.empty() || store)
+      (*G)[o].key = true;
+
+    for (std::size_t i = 0; i < N.loadTo.size(); ++i)
+      if (demanded[N.loadTo[i]])
+	addCopyEdge(o, N.loadTo[i]);
+
+    if (store) {
+      storesTo[o].push_back(n);
+      if (demanded[o])
+	applyStore(n, o);
+    }
+  }
+
+  for (std::size_t i = 0; i < N.copyTo.size(); ++i) {
+    const NodeId dst = N.copyTo[i];
+
+    if (demanded[dst] && (*G)[dst].pts.unionWith(D))
+      push(dst);
+  }
+
+  for (std::size_t i = 0; i < N.gepTo.size(); ++i) {
+    const GepEdge E = N.gepTo[i];
+    bool change = false;
+
+    if (!demanded[E.dst])
+      continue;
+    for (NodeSet::const_iterator I = D.begin(), EE = D.end(); I != EE; ++I)
+      change |= G->insertGep(E, *I);
+    if (change)
+      push(E.dst);
+  }
+  tieFields();
+}
+
+/* false if the budget ran out */
+bool DemandEngine::solve() {
+  unsigned steps = 0;
+
+  tieFields();
+  while (!unexpanded.empty() || !worklist.empty()) {
+    if (++steps > options.budget)
+      return false;
+
+    if (!unexpanded.empty()) {
+      const NodeId n = unexpanded.back();
+      unexpanded.pop_back();
+      expand(n);
+    } else {
+      const NodeId n = worklist.front();
+      worklist.pop_front();
+      (*G)[n].queued = false;
+      visit(n);
+    }
+  }
+
+  return true;
+}
+
+bool DemandEngine::isSolved(const PointsToSets::Pointer &Ptr) const {
+  if (whole)
+    return true;
+  if (!G)
+    return false;
+
+  const NodeId n = L.lookup(Ptr);
+
+  return n < demanded.size() && demanded[n];
+}
+
+const DemandEngine::PTSet *
+DemandEngine::query(const PointsToSets::Pointer &Ptr) {
+  if (whole)
+    return whole->query(Ptr);
+
+  /* computePointsToSets() prunes these */
+  if (isa<Function>(Ptr.first))
+    return 0;
+
+  init();
+
+  const NodeId n = L.lookup(Ptr);
+  if (n >= G->size())
+    return 0;
+
+  grow();
+  if (answers[n])
+    return answers[n];
+
+  demand(n);
+  if (!solve()) {
+    unsigned count = 0;
+    for (std::size_t i = 0; i < demanded.size(); ++i)
+      count += demanded[i];
+    if (options.stats)
+      errs() << "PointsTo: query budget exceeded with " << count << " of " <<
+	G->size() << " nodes demanded, solving the whole module\n";
+
+    whole = new PointsToSets;
+    computePointsToSets(*P, *whole, options);
+    return whole->query(Ptr);
+  }
+
+  if (!(*G)[n].key)
+    return 0;
+
+  PTSet X;
+  for (NodeSet::const_iterator I = (*G)[n].pts.begin(), E = (*G)[n].pts.end();
+      I != E; ++I)
+    X.insert(G->getLocation(*I));
+  answers[n] = pool.take(X);
+
+  return answers[n];
+}
+
+}
+
+DemandPointsToSets::DemandPointsToSets(Module &M, const SolverOptions &O) :
+    E(new detail::DemandEngine(M, getLocations(), O)) {
+  setPartial(true);
+}
+
+DemandPointsToSets::~DemandPointsToSets() {
+  delete E;
+}
+
+const PointsToSets::PointsToSet *
+DemandPointsToSets::query(const Pointer &P) const {
+  return E->query(P);
+}
+
+bool DemandPointsToSets::isSolved(const Pointer &P) const {
+  return E->isSolved(P);
+}
+
+}}
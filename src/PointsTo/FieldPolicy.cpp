@@ -0,0 +1,154 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <algorithm>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+
+#include "FieldPolicy.h"
+#include "Solvers.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+FieldPolicy::FieldPolicy(const Module &M, const FieldOptions &O) : DL(&M),
+    O(O) {
+  /* with no offset at all, recursive GEPs would never stop */
+  if (!this->O.maxOffsets)
+    this->O.maxOffsets = 1;
+}
+
+FieldPolicy::FieldPolicy(const FieldOptions &O) : DL(""), O(O) {
+  if (!this->O.maxOffsets)
+    this->O.maxOffsets = 1;
+}
+
+uint64_t FieldPolicy::getStoreSize(Type *T) {
+  DenseMap<Type *, uint64_t>::const_iterator I = storeSizes.find(T);
+
+  if (I != storeSizes.end())
+    return I->second;
+
+  return storeSizes[T] = DL.getTypeStoreSize(T);
+}
+
+/*
+ * The struct layouts are cached by the DataLayout itself. The array part is
+ * left out when the arrays are collapsed, @isArray is set anyway.
+ */
+int64_t FieldPolicy::getOffset(const GetElementPtrInst *gep, bool &isArray) {
+  int64_t off = 0;
+
+  for (gep_type_iterator GTI = gep_type_begin(gep), GTE = gep_type_end(gep);
+      GTI != GTE; ++GTI) {
+    ConstantInt *OpC = dyn_cast<ConstantInt>(GTI.getOperand());
+    if (!OpC || OpC->isZero())
+      continue;
+
+    int64_t ElementIdx = OpC->getSExtValue();
+
+    if (StructType *STy = dyn_cast<StructType>(*GTI)) {
+      off += DL.getStructLayout(STy)->getElementOffset(ElementIdx);
+    } else if (isa<SequentialType>(*GTI)) {
+      if (!O.collapseArrays)
+	off += ElementIdx * getStoreSize(GTI.getIndexedType());
+      isArray = true;
+    }
+  }
+
+  return off;
+}
+
+const FieldPolicy::Object &FieldPolicy::getObject(const Value *V) {
+  DenseMap<const Value *, Object>::iterator I = objects.find(V);
+
+  if (I != objects.end())
+    return I->second;
+
+  Object X;
+
+  X.id = values.size();
+  values.push_back(V);
+  if (!getObjectSize(DL, V, X.size))
+    X.size = ConstraintFile::UNBOUNDED;
+  X.flags = 0;
+  if (isa<Function>(V))
+    X.flags |= ConstraintFile::OF_FUNCTION;
+  if (isa<ConstantPointerNull>(V))
+    X.flags |= ConstraintFile::OF_NULL;
+
+  return objects[V] = X;
+}
+
+bool FieldPolicy::fits(const Value *V, uint64_t sum) {
+  const uint64_t size = getObject(V).size;
+
+  return size == ConstraintFile::UNBOUNDED || sum < size;
+}
+
+bool FieldPolicy::move(unsigned dst, unsigned object, uint64_t size,
+    unsigned flags, int64_t off, int64_t gepOff, bool isArray, int64_t &sum) {
+  if (gepOff &&
+      (flags & (ConstraintFile::OF_FUNCTION | ConstraintFile::OF_NULL)))
+    return false;
+
+  sum = off + gepOff;
+
+  if (size != ConstraintFile::UNBOUNDED && static_cast<uint64_t>(sum) >= size)
+    return false;
+
+  if (sum < 0)
+    sum = 0;
+
+  /* an unsoundness :) */
+  if (isArray && sum > O.arrayLimit)
+    sum = O.arrayLimit;
+
+  if (collapsed.count(object)) {
+    sum = 0;
+    return true;
+  }
+
+  Offsets &X = offsets[Key(dst, object)];
+
+  if (std::find(X.begin(), X.end(), sum) != X.end())
+    return true;
+
+  if (X.size() >= O.maxOffsets) {
+    collapse(object);
+    sum = 0;
+  } else
+    X.push_back(sum);
+
+  return true;
+}
+
+void FieldPolicy::merge(unsigned from, unsigned into, unsigned object) {
+  DenseMap<Key, Offsets>::iterator I = offsets.find(Key(from, object));
+
+  if (I == offsets.end())
+    return;
+
+  const Offsets X = I->second;
+  offsets.erase(I);
+
+  if (collapsed.count(object))
+    return;
+
+  Offsets &Y = offsets[Key(into, object)];
+  for (std::size_t i = 0; i < X.size(); ++i)
+    if (std::find(Y.begin(), Y.end(), X[i]) == Y.end())
+      Y.push_back(X[i]);
+
+  if (Y.size() > O.maxOffsets)
+    collapse(object);
+}
+
+/* the offsets of the object are of no use any more */
+void FieldPolicy::collapse(unsigned object) {
+  if (collapsed.insert(object).second)
+    fresh.push_back(object);
+}
+
+}}}
@@ -0,0 +1,136 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_FIELDPOLICY_H
+#define POINTSTO_FIELDPOLICY_H
+
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+
+#include "ConstraintFile.h"
+#include "PointsTo.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+  /*
+   * Decides which offset a pointee gets when it goes through a GEP, the
+   * same way in all the solvers (see FieldOptions):
+   *  - the offset has to stay within the object if its size is known
+   *    (getObjectSize()), functions and null do not move at all,
+   *  - negative offsets are cropped to 0, offsets into arrays are clamped
+   *    to arrayLimit, or the array indices are ignored altogether,
+   *  - one object gets at most maxOffsets distinct offsets in the set of
+   *    one GEP result. Past that, the object is collapsed: from then on it
+   *    is pointed to as a whole, at offset 0, in every set. The offsets
+   *    are remembered as they are moved to, so this costs no scan of the
+   *    set,
+   *  - with cutRecursion, the solvers do not move a pointee which is in
+   *    the set of the GEP result already. This stops recursive structures
+   *    early, but what is cut depends on the order the pointees come in.
+   *
+   * A collapsed object has a single location for all its fields. The
+   * solver learns about it from takeCollapsed() and merges the locations
+   * of the fields it has into <object, 0>, see LocationTable::collapse().
+   *
+   * Type and object sizes are cached, so the solvers do not keep asking
+   * the DataLayout. The policy itself needs no IR, only the size and the
+   * flags of an object (see ConstraintFile::Object), so it serves the
+   * compiled rules as well.
+   */
+  class FieldPolicy {
+  public:
+    FieldPolicy(const Module &M, const FieldOptions &O);
+    /* for the compiled rules, getOffset() and the values are not used */
+    explicit FieldPolicy(const FieldOptions &O);
+
+    const FieldOptions &getOptions() const { return O; }
+
+    /*
+     * The constant offset of @gep, @isArray set if it indexes an array. All
+     * that looks at GEP offsets asks here, so that the reduction and the
+     * cache see the very offsets the solvers do.
+     */
+    int64_t getOffset(const GetElementPtrInst *gep, bool &isArray);
+    /* whether @sum is within @V, see getObjectSize() */
+    bool fits(const Value *V, uint64_t sum);
+    /*
+     * The offset of pointee <@V, @off> moved by a GEP of @gepOff into the
+     * set identified by @dst is stored to @sum. False if it is dropped.
+     */
+    bool move(unsigned dst, const Value *V, int64_t off, int64_t gepOff,
+	bool isArray, int64_t &sum) {
+      const Object &X = getObject(V);
+      return move(dst, X.id, X.size, X.flags, off, gepOff, isArray, sum);
+    }
+    /*
+     * The set @from was merged into @into (see ConstraintGraph::merge()),
+     * so are the offsets of @V moved to them.
+     */
+    void merge(unsigned from, unsigned into, const Value *V) {
+      DenseMap<const Value *, Object>::const_iterator I = objects.find(V);
+      if (I != objects.end())
+	merge(from, into, I->second.id);
+    }
+    const Value *getValue(unsigned object) const { return values[object]; }
+
+    /*
+     * The same for an object numbered by the caller, @size and @flags are
+     * those of ConstraintFile::Object. The numbers must not be mixed with
+     * values in one policy.
+     */
+    bool move(unsigned dst, unsigned object, uint64_t size, unsigned flags,
+	int64_t off, int64_t gepOff, bool isArray, int64_t &sum);
+    void merge(unsigned from, unsigned into, unsigned object);
+
+    bool isCollapsed(unsigned object) const {
+      return collapsed.count(object);
+    }
+    /*
+     * Moves the objects collapsed since the last call to @objects. Returns
+     * false if there are none.
+     */
+    bool takeCollapsed(std::vector<unsigned> &objects) {
+      objects.clear();
+      objects.swap(fresh);
+      return !objects.empty();
+    }
+
+    /* a value numbered for move() */
+    struct Object {
+      unsigned id;
+      uint64_t size;	/* or ConstraintFile::UNBOUNDED */
+      unsigned flags;	/* ConstraintFile::ObjectFlags */
+    };
+
+    /* the reference is valid until another value is asked for */
+    const Object &getObject(const Value *V);
+
+  private:
+    typedef std::pair<unsigned, unsigned> Key;
+    typedef SmallVector<int64_t, 4> Offsets;
+
+    DataLayout DL;
+    FieldOptions O;
+    DenseMap<Type *, uint64_t> storeSizes;
+    DenseMap<const Value *, Object> objects;
+    /* the values of the objects, by id */
+    std::vector<const Value *> values;
+    /* distinct offsets of an object moved to a set, <set, object> */
+    DenseMap<Key, Offsets> offsets;
+    DenseSet<unsigned> collapsed;
+    /* collapsed since the last takeCollapsed() */
+    std::vector<unsigned> fresh;
+
+    uint64_t getStoreSize(Type *T);
+    void collapse(unsigned object);
+  };
+
+}}}
+
+#endif
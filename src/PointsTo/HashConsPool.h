@@ -0,0 +1,86 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_HASHCONSPOOL_H
+#define POINTSTO_HASHCONSPOOL_H
+
+#include <deque>
+#include <map>
+
+#include "llvm/ADT/Hashing.h"
+
+namespace llvm { namespace ptr {
+
+  /*
+   * Stores each distinct set once. Equal sets interned into the same pool
+   * get the very same canonical copy, so they can be compared by address.
+   * The canonical copies are immutable and live as long as the pool does.
+   *
+   * @Set is a sorted container (std::set) of hashable elements.
+   */
+  template<typename Set>
+  class HashConsPool {
+  public:
+    HashConsPool() : interned(0) {}
+
+    const Set *intern(const Set &S) {
+      const unsigned hash = hash_combine_range(S.begin(), S.end());
+
+      interned++;
+      if (const Set *C = find(S, hash))
+	return C;
+
+      sets.push_back(S);
+      buckets.insert(std::make_pair(hash, &sets.back()));
+
+      return &sets.back();
+    }
+
+    /* Like intern(), but takes the contents of @S, which is left empty. */
+    const Set *take(Set &S) {
+      const unsigned hash = hash_combine_range(S.begin(), S.end());
+
+      interned++;
+      if (const Set *C = find(S, hash)) {
+	S.clear();
+	return C;
+      }
+
+      sets.push_back(Set());
+      sets.back().swap(S);
+      buckets.insert(std::make_pair(hash, &sets.back()));
+
+      return &sets.back();
+    }
+
+    /* Frees all the canonical copies, the pointers to them dangle then. */
+    void clear() {
+      std::deque<Set>().swap(sets);
+      buckets.clear();
+    }
+
+    /* distinct sets */
+    std::size_t size() const { return sets.size(); }
+    /* calls to intern() and take() */
+    std::size_t getInterned() const { return interned; }
+
+  private:
+    typedef std::multimap<unsigned, const Set *> Buckets;
+
+    /* deque, so that the canonical copies never move */
+    std::deque<Set> sets;
+    Buckets buckets;
+    std::size_t interned;
+
+    const Set *find(const Set &S, unsigned hash) const {
+      for (typename Buckets::const_iterator I = buckets.lower_bound(hash),
+	  E = buckets.upper_bound(hash); I != E; ++I)
+	if (*I->second == S)
+	  return I->second;
+      return 0;
+    }
+  };
+
+}}
+
+#endif
@@ -0,0 +1,99 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "llvm/IR/Argument.h"
+#include "llvm/IR/Instruction.h"
+
+#include "LocationTable.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr {
+
+const LocationTable::LocationId LocationTable::NONE;
+
+LocationTable::LocationId LocationTable::getId(const Location &L) {
+  std::pair<DenseMap<Location, LocationId>::iterator, bool> I =
+    ids.insert(std::make_pair(L, locations.size()));
+
+  if (!I.second)
+    return I.first->second;
+
+  if (L.second > 0 && collapsed.count(L.first)) {
+    ids.erase(I.first);
+    return getId(L.first, 0);
+  }
+
+  locations.push_back(L);
+  if (L.second > 0)
+    fields[L.first].push_back(I.first->second);
+
+  return I.first->second;
+}
+
+LocationTable::LocationId LocationTable::lookup(const Location &L) const {
+  DenseMap<Location, LocationId>::const_iterator I = ids.find(L);
+
+  if (I != ids.end())
+    return I->second;
+  if (L.second > 0 && collapsed.count(L.first))
+    return lookup(Location(L.first, 0));
+  return NONE;
+}
+
+void LocationTable::collapse(const Value *V,
+    std::vector<std::pair<LocationId, LocationId> > &out) {
+  if (!collapsed.insert(V).second)
+    return;
+
+  DenseMap<const Value *, std::vector<LocationId> >::iterator I =
+    fields.find(V);
+  if (I == fields.end())
+    return;
+
+  const std::vector<LocationId> F = I->second;
+  const LocationId first = getId(V, 0);
+
+  fields.erase(I);
+  for (std::size_t i = 0; i < F.size(); ++i) {
+    out.push_back(std::make_pair(F[i], first));
+    collapsedFields.push_back(out.back());
+  }
+}
+
+static LocationTable::MemoryManKind getMemoryManKind(const Value *V) {
+  if (isMemoryAllocation(V))
+    return LocationTable::MM_ALLOC;
+  if (isMemoryDeallocation(V))
+    return LocationTable::MM_DEALLOC;
+  if (isMemoryCopy(V))
+    return LocationTable::MM_COPY;
+  if (isMemoryMove(V))
+    return LocationTable::MM_MOVE;
+  if (isMemorySet(V))
+    return LocationTable::MM_SET;
+  return LocationTable::MM_NONE;
+}
+
+const LocationTable::ValueInfo &LocationTable::getInfo(const Value *V) const {
+  DenseMap<const Value *, ValueInfo>::iterator I = infos.find(V);
+
+  if (I != infos.end())
+    return I->second;
+
+  ValueInfo &VI = infos[V];
+
+  if (const Instruction *Ins = dyn_cast<Instruction>(V))
+    VI.parent = Ins->getParent()->getParent();
+  else if (const Argument *A = dyn_cast<Argument>(V))
+    VI.parent = A->getParent();
+  else
+    VI.parent = 0;
+  VI.memKind = getMemoryManKind(V);
+  VI.extraRef = hasExtraReference(V);
+  VI.pointer = isPointerValue(V);
+
+  return VI;
+}
+
+}}
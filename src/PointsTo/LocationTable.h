@@ -0,0 +1,85 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_LOCATIONTABLE_H
+#define POINTSTO_LOCATIONTABLE_H
+
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Value.h"
+
+namespace llvm { namespace ptr {
+
+  /*
+   * Interns <location, offset> pairs (see PointsToSets::Pointer) to dense
+   * ids, starting at 0, so that they can index vectors instead of being
+   * looked up in trees. The ids are stable for the life of the table.
+   *
+   * It also caches facts about the values which are asked for over and
+   * over while solving.
+   */
+  class LocationTable {
+  public:
+    typedef unsigned LocationId;
+    typedef std::pair<const llvm::Value *, int> Location;
+
+    static const LocationId NONE = ~0U;
+
+    enum MemoryManKind {
+      MM_NONE,
+      MM_ALLOC,		/* isMemoryAllocation() */
+      MM_DEALLOC,	/* isMemoryDeallocation() */
+      MM_COPY,		/* isMemoryCopy() */
+      MM_MOVE,		/* isMemoryMove() */
+      MM_SET,		/* isMemorySet() */
+    };
+
+    struct ValueInfo {
+      const llvm::Function *parent;	/* 0 for globals and constants */
+      MemoryManKind memKind;
+      bool extraRef;			/* hasExtraReference() */
+      bool pointer;			/* isPointerValue() */
+    };
+
+    LocationId getId(const Location &L);
+    LocationId getId(const llvm::Value *V, int off) {
+      return getId(Location(V, off));
+    }
+    /* NONE when @L was not interned yet */
+    LocationId lookup(const Location &L) const;
+
+    /*
+     * Makes <@V, 0> stand for all the fields of @V (see FieldPolicy): the
+     * fields not interned yet get its id. The ids of those interned already
+     * stay, the solver has to merge them into <@V, 0>. They are appended to
+     * @fields, paired with the id of <@V, 0>.
+     */
+    void collapse(const llvm::Value *V,
+	std::vector<std::pair<LocationId, LocationId> > &fields);
+    /* the same for all the values collapsed so far, for a new solver */
+    const std::vector<std::pair<LocationId, LocationId> > &
+    getCollapsed() const { return collapsedFields; }
+
+    const Location &getLocation(LocationId id) const { return locations[id]; }
+    std::size_t size() const { return locations.size(); }
+
+    /* the reference is valid until another value is asked for */
+    const ValueInfo &getInfo(const llvm::Value *V) const;
+
+  private:
+    std::vector<Location> locations;
+    DenseMap<Location, LocationId> ids;
+    /* the ids of the fields past offset 0 of a value */
+    DenseMap<const llvm::Value *, std::vector<LocationId> > fields;
+    DenseSet<const llvm::Value *> collapsed;
+    std::vector<std::pair<LocationId, LocationId> > collapsedFields;
+    mutable DenseMap<const llvm::Value *, ValueInfo> infos;
+  };
+
+}}
+
+#endif
@@ -0,0 +1,80 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cstdlib>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include "MappedFile.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+/* the least the file grows by, it doubles past that */
+static const std::size_t MIN_SIZE = 1 << 20;
+
+bool MappedFile::open(const std::string &dir) {
+  std::string path = dir + "/slicer-pts-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+
+  close();
+  name.push_back('\0');
+  fd = mkstemp(&name[0]);
+  if (fd < 0)
+    return false;
+  /* nobody else needs to see it, it is removed once closed */
+  unlink(&name[0]);
+
+  return true;
+}
+
+void MappedFile::close() {
+  if (base)
+    munmap(base, length);
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+  base = 0;
+  length = 0;
+}
+
+void MappedFile::reserve(std::size_t bytes) {
+  if (bytes <= length)
+    return;
+
+  std::size_t newLength = length < MIN_SIZE ? MIN_SIZE : length;
+  while (newLength < bytes)
+    newLength *= 2;
+
+  /* the data are in the file, a new mapping sees them again */
+  if (base)
+    munmap(base, length);
+  base = 0;
+  length = 0;
+
+  if (fd < 0 || ftruncate(fd, newLength))
+    report_fatal_error("cannot grow the file of the points-to sets");
+
+  void *p = mmap(0, newLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    report_fatal_error("cannot map the file of the points-to sets");
+
+  base = static_cast<char *>(p);
+  length = newLength;
+}
+
+void MappedFile::release(std::size_t from, std::size_t to) {
+  const std::size_t page = sysconf(_SC_PAGESIZE);
+
+  /* only the pages wholly within the range */
+  from = (from + page - 1) / page * page;
+  to = to / page * page;
+  if (from < to && to <= length)
+    madvise(base + from, to - from, MADV_DONTNEED);
+}
+
+}}}
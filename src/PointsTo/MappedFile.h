@@ -0,0 +1,84 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_MAPPEDFILE_H
+#define POINTSTO_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace llvm { namespace ptr { namespace detail {
+
+  /*
+   * A growable memory region backed by an unlinked temporary file, so that
+   * the kernel can write its pages out to the file and drop them instead of
+   * keeping them all in RAM. It is gone once closed.
+   *
+   * Growing may move the region, keep indices rather than pointers to it.
+   */
+  class MappedFile {
+  public:
+    MappedFile() : fd(-1), base(0), length(0) {}
+    ~MappedFile() { close(); }
+
+    /* false if no file can be created in @dir */
+    bool open(const std::string &dir);
+    void close();
+
+    /* makes it at least @bytes long, it is a fatal error if that fails */
+    void reserve(std::size_t bytes);
+    /* the pages in [@from, @to) are not needed in RAM soon */
+    void release(std::size_t from, std::size_t to);
+
+    char *data() const { return base; }
+    std::size_t size() const { return length; }
+
+  private:
+    int fd;
+    char *base;
+    std::size_t length;
+
+    MappedFile(const MappedFile &);
+    void operator=(const MappedFile &);
+  };
+
+  /*
+   * A vector of plain data in a MappedFile. The elements are copied around
+   * as bytes, never constructed nor destroyed.
+   */
+  template<typename T>
+  class MappedArray {
+  public:
+    MappedArray() : count(0) {}
+
+    bool open(const std::string &dir) { return F.open(dir); }
+
+    T &operator[](std::size_t i) { return data()[i]; }
+    const T &operator[](std::size_t i) const { return data()[i]; }
+    std::size_t size() const { return count; }
+    T *data() const { return reinterpret_cast<T *>(F.data()); }
+
+    /* appends @n elements set to @val, returns the index of the first */
+    std::size_t append(std::size_t n, const T &val = T()) {
+      const std::size_t first = count;
+
+      F.reserve((count + n) * sizeof(T));
+      for (std::size_t i = 0; i < n; ++i)
+	data()[count++] = val;
+
+      return first;
+    }
+    void push_back(const T &val) { append(1, val); }
+
+    void release(std::size_t from, std::size_t to) {
+      F.release(from * sizeof(T), to * sizeof(T));
+    }
+
+  private:
+    MappedFile F;
+    std::size_t count;
+  };
+
+}}}
+
+#endif
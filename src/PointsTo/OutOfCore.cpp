@@ -0,0 +1,758 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Out-of-core solver: the sweep solver (Sweep.cpp) with its rules and sets
+ * kept in memory-mapped temporary files (see MappedFile), so that the
+ * kernel pages them in and out as they are used instead of failing when
+ * they do not fit in RAM.
+ *
+ * A set is a sorted array of location ids in one big element file. It
+ * lives in a chunk of a power-of-two capacity and moves to a bigger one
+ * when it outgrows it, the old chunk is reused by another set later.
+ *
+ * The rules are those of ConstraintFile, compiled straight to their files,
+ * an array per side and kind. To keep the pages in use few, the nodes are ordered along the copy and gep edges (reverse
+ * postorder of a depth-first search): the chunks are allocated in that
+ * order and the rules of each kind are swept in the order of their
+ * sources. A sweep then walks the files mostly forward, and values flow
+ * to the following rules within the same sweep.
+ *
+ * The sets of the fields of a collapsed object are merged into that of
+ * <object, 0> as in Sweep.cpp, their chunks are reused.
+ *
+ * PointsToAnalysis keeps the solver once it is done and reads the sets
+ * from its files as they are asked for, see MappedPointsToSets.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Budget.h"
+#include "ConstraintFile.h"
+#include "FieldPolicy.h"
+#include "HashConsPool.h"
+#include "MappedFile.h"
+#include "PointsTo.h"
+#include "Solvers.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+typedef uint32_t Id;
+
+/* where the elements of a set are, cap is 0 if it has no entry yet */
+struct SetRef {
+  uint64_t first;
+  uint32_t size;
+  uint32_t cap;
+};
+
+/* the capacity of the smallest chunk, they are MIN_CAP << class */
+static const uint32_t MIN_CAP = 4;
+
+/* ConstraintFile::Rules in files */
+struct MappedRules {
+  MappedArray<Id> lval;
+  MappedArray<Id> rval;
+  /* R_GEP only */
+  MappedArray<int64_t> off;
+  MappedArray<uint8_t> isArray;
+
+  bool open(const std::string &dir, bool gep) {
+    return lval.open(dir) && rval.open(dir) &&
+      (!gep || (off.open(dir) && isArray.open(dir)));
+  }
+  std::size_t size() const { return lval.size(); }
+
+  /* the i-th rule becomes rule @by[i], all the sides along */
+  void permute(const std::vector<uint32_t> &by);
+};
+
+void MappedRules::permute(const std::vector<uint32_t> &by) {
+  const bool gep = off.size();
+  std::vector<char> done(by.size(), false);
+
+  for (uint32_t first = 0; first < by.size(); ++first) {
+    if (done[first])
+      continue;
+
+    const Id l = lval[first], r = rval[first];
+    const int64_t o = gep ? off[first] : 0;
+    const uint8_t a = gep ? isArray[first] : 0;
+    uint32_t i = first;
+
+    /* follow the cycle of @first, it ends where it began */
+    while (true) {
+      const uint32_t from = by[i];
+
+      done[i] = true;
+      if (from == first)
+	break;
+      lval[i] = lval[from];
+      rval[i] = rval[from];
+      if (gep) {
+	off[i] = off[from];
+	isArray[i] = isArray[from];
+      }
+      i = from;
+    }
+    lval[i] = l;
+    rval[i] = r;
+    if (gep) {
+      off[i] = o;
+      isArray[i] = a;
+    }
+  }
+}
+
+/* the rules as they are compiled, straight to their files */
+class MappedRuleSink : public RuleSink {
+public:
+  explicit MappedRuleSink(MappedRules *rules) : rules(rules) {}
+
+  virtual void addRule(ConstraintFile::RuleKind kind, uint32_t lval,
+      uint32_t rval, int64_t off, bool isArray) {
+    MappedRules &M = rules[kind];
+
+    M.lval.push_back(lval);
+    M.rval.push_back(rval);
+    if (kind == ConstraintFile::R_GEP) {
+      M.off.push_back(off);
+      M.isArray.push_back(isArray);
+    }
+  }
+
+private:
+  MappedRules *rules;
+};
+
+/* a rule is swept when its source is */
+static const MappedArray<Id> &getSources(const MappedRules &R,
+    unsigned kind) {
+  return kind == ConstraintFile::R_ADDR ||
+    kind == ConstraintFile::R_STORE_ADDR ? R.lval : R.rval;
+}
+
+struct ByRank {
+  ByRank(const std::vector<Id> &rank, const MappedArray<Id> &source) :
+    rank(rank), source(source) {}
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    return rank[source[a]] < rank[source[b]];
+  }
+
+  const std::vector<Id> &rank;
+  const MappedArray<Id> &source;
+};
+
+}
+
+class OutOfCoreSolver {
+public:
+  explicit OutOfCoreSolver(const FieldOptions &O) : O(O), FP(O) {}
+
+  /* false if the files cannot be created in @dir */
+  bool open(const std::string &dir);
+  void compile(const ProgramStructure &P);
+  bool sweep();
+  void fill(PointsToSets &S) const;
+  /*
+   * The set fill() would store for @P to @out. False if it would store
+   * none.
+   */
+  bool query(const PointsToSets::Pointer &P, PointsToSets::PointsToSet &out);
+
+private:
+  FieldOptions O;
+  /* the objects and the locations, the rules are in their files */
+  ConstraintFile F;
+  FieldPolicy FP;
+  /* the objects by value, for query() */
+  DenseMap<const Value *, uint32_t> objectOf;
+
+  MappedRules rules[ConstraintFile::R_KINDS];
+  MappedArray<SetRef> sets;
+  MappedArray<Id> elems;
+  /* first elements of the unused chunks, by class */
+  std::vector<std::vector<uint64_t> > unused;
+  /* the fields of the collapsed objects, merged into <object, 0> */
+  DenseMap<Id, Id> collapsedInto;
+
+  /* copies of sets being iterated while others change */
+  std::vector<Id> pointers, pointees, values, merged;
+  std::vector<unsigned> objects;
+  std::vector<Id> fields;
+
+  void order(std::vector<Id> &rank) const;
+
+  static unsigned getClass(uint32_t size);
+  uint64_t allocate(unsigned cls);
+  Id find(Id id) const {
+    DenseMap<Id, Id>::const_iterator I = collapsedInto.find(id);
+    return I == collapsedInto.end() ? id : I->second;
+  }
+  SetRef &getSet(Id id);
+  void grow(SetRef &R, uint32_t size);
+  void release(SetRef &R);
+  void collapse();
+  void read(Id id, std::vector<Id> &out);
+  bool contains(Id id, Id e);
+  bool insert(Id id, Id e);
+  bool unite(Id id, const std::vector<Id> &add);
+
+  bool applyGep(Id l, Id r, int64_t off, bool isArray);
+  bool applyLoad(Id l, Id r);
+  bool applyStoreAddr(Id l, Id r);
+  bool applyStore(Id l, Id r);
+  bool applyStoreLoad(Id l, Id r);
+};
+
+bool OutOfCoreSolver::open(const std::string &dir) {
+  for (unsigned k = 0; k < ConstraintFile::R_KINDS; ++k)
+    if (!rules[k].open(dir, k == ConstraintFile::R_GEP))
+      return false;
+
+  return sets.open(dir) && elems.open(dir);
+}
+
+void OutOfCoreSolver::compile(const ProgramStructure &P) {
+  MappedRuleSink out(rules);
+
+  compileConstraints(P, O, F, &out);
+  for (uint32_t i = 0; i < F.values.size(); ++i)
+    objectOf[F.values[i]] = i;
+
+  sets.append(F.locations.size(), SetRef());
+
+  std::vector<Id> rank;
+  order(rank);
+
+  /*
+   * The rules of a kind are sorted in their files, only their order is in
+   * memory. The sets they use get their chunks in the order they are swept.
+   */
+  std::vector<char> used(rank.size(), false);
+  for (unsigned k = 0; k < ConstraintFile::R_KINDS; ++k) {
+    MappedRules &M = rules[k];
+    std::vector<uint32_t> by(M.size());
+
+    for (uint32_t i = 0; i < by.size(); ++i)
+      by[i] = i;
+    std::stable_sort(by.begin(), by.end(), ByRank(rank, getSources(M, k)));
+    M.permute(by);
+
+    for (std::size_t i = 0; i < M.size(); ++i) {
+      used[M.lval[i]] = true;
+      if (k != ConstraintFile::R_ADDR && k != ConstraintFile::R_STORE_ADDR)
+	used[M.rval[i]] = true;
+    }
+  }
+
+  std::vector<Id> byRank(rank.size());
+  for (Id id = 0; id < rank.size(); ++id)
+    byRank[rank[id]] = id;
+  for (std::size_t i = 0; i < byRank.size(); ++i)
+    if (used[byRank[i]])
+      getSet(byRank[i]);
+}
+
+/* reverse postorder over the copy and gep edges, as ranks of the ids */
+void OutOfCoreSolver::order(std::vector<Id> &rank) const {
+  const std::size_t n = sets.size();
+  std::vector<unsigned> first(n + 1, 0);
+  std::vector<Id> succ;
+
+  const MappedRules *edges[] = {
+    &rules[ConstraintFile::R_COPY], &rules[ConstraintFile::R_GEP]
+  };
+
+  for (unsigned k = 0; k < 2; ++k)
+    for (std::size_t i = 0; i < edges[k]->size(); ++i)
+      first[edges[k]->rval[i] + 1]++;
+  for (std::size_t i = 0; i < n; ++i)
+    first[i + 1] += first[i];
+
+  std::vector<unsigned> pos(first.begin(), first.end() - 1);
+  succ.resize(first[n]);
+  for (unsigned k = 0; k < 2; ++k)
+    for (std::size_t i = 0; i < edges[k]->size(); ++i)
+      succ[pos[edges[k]->rval[i]]++] = edges[k]->lval[i];
+
+  std::vector<char> seen(n, false);
+  std::vector<std::pair<Id, unsigned> > stack;
+  Id next = n;
+
+  rank.assign(n, 0);
+  for (Id root = 0; root < n; ++root) {
+    if (seen[root])
+      continue;
+    seen[root] = true;
+    stack.push_back(std::make_pair(root, first[root]));
+
+    while (!stack.empty()) {
+      std::pair<Id, unsigned> &top = stack.back();
+
+      if (top.second == first[top.first + 1]) {
+	rank[top.first] = --next;
+	stack.pop_back();
+	continue;
+      }
+
+      const Id s = succ[top.second++];
+      if (!seen[s]) {
+	seen[s] = true;
+	stack.push_back(std::make_pair(s, first[s]));
+      }
+    }
+  }
+}
+
+unsigned OutOfCoreSolver::getClass(uint32_t size) {
+  unsigned cls = 0;
+
+  while ((MIN_CAP << cls) < size)
+    cls++;
+
+  return cls;
+}
+
+uint64_t OutOfCoreSolver::allocate(unsigned cls) {
+  if (cls < unused.size() && !unused[cls].empty()) {
+    const uint64_t first = unused[cls].back();
+
+    unused[cls].pop_back();
+    return first;
+  }
+
+  return elems.append(MIN_CAP << cls);
+}
+
+/* creates the entry of @id if there is none, like PointsToSets does */
+SetRef &OutOfCoreSolver::getSet(Id id) {
+  id = find(id);
+  if (id >= sets.size())
+    sets.append(id + 1 - sets.size(), SetRef());
+
+  SetRef &R = sets[id];
+  if (!R.cap) {
+    R.first = allocate(0);
+    R.size = 0;
+    R.cap = MIN_CAP;
+  }
+
+  return R;
+}
+
+/* moves @R to a chunk for at least @size elements */
+void OutOfCoreSolver::grow(SetRef &R, uint32_t size) {
+  const unsigned cls = getClass(size);
+  const uint64_t first = allocate(cls);
+
+  std::copy(elems.data() + R.first, elems.data() + R.first + R.size,
+      elems.data() + first);
+  release(R);
+
+  R.first = first;
+  R.cap = MIN_CAP << cls;
+}
+
+/* gives the chunk of @R for reuse, @R itself is left as it is */
+void OutOfCoreSolver::release(SetRef &R) {
+  const unsigned cls = getClass(R.cap);
+
+  if (cls >= unused.size())
+    unused.resize(cls + 1);
+  unused[cls].push_back(R.first);
+  elems.release(R.first, R.first + R.cap);
+}
+
+void OutOfCoreSolver::read(Id id, std::vector<Id> &out) {
+  const SetRef &R = getSet(id);
+  const Id *E = elems.data() + R.first;
+
+  out.assign(E, E + R.size);
+}
+
+bool OutOfCoreSolver::contains(Id id, Id e) {
+  const SetRef &R = getSet(id);
+  const Id *E = elems.data() + R.first;
+
+  return std::binary_search(E, E + R.size, e);
+}
+
+bool OutOfCoreSolver::insert(Id id, Id e) {
+  SetRef &R = getSet(id);
+  Id *E = elems.data() + R.first;
+  Id *pos = std::lower_bound(E, E + R.size, e);
+
+  if (pos != E + R.size && *pos == e)
+    return false;
+
+  const std::size_t at = pos - E;
+  if (R.size == R.cap)
+    grow(R, R.size + 1);
+
+  E = elems.data() + R.first;
+  std::copy_backward(E + at, E + R.size, E + R.size + 1);
+  E[at] = e;
+  R.size++;
+
+  return true;
+}
+
+/* @add is sorted */
+bool OutOfCoreSolver::unite(Id id, const std::vector<Id> &add) {
+  SetRef &R = getSet(id);
+  const Id *E = elems.data() + R.first;
+
+  merged.clear();
+  std::set_union(E, E + R.size, add.begin(), add.end(),
+      std::back_inserter(merged));
+  if (merged.size() == R.size)
+    return false;
+
+  if (merged.size() > R.cap)
+    grow(R, merged.size());
+  std::copy(merged.begin(), merged.end(), elems.data() + R.first);
+  R.size = merged.size();
+
+  return true;
+}
+
+bool OutOfCoreSolver::applyGep(Id l, Id r, int64_t off, bool isArray) {
+  bool change = false;
+
+  read(r, pointees);
+  for (std::size_t i = 0; i < pointees.size(); ++i) {
+    /* disable recursive structures */
+    if (O.cutRecursion && contains(l, pointees[i]))
+      continue;
+
+    /* a copy, getLocation() may add locations */
+    const ConstraintFile::Location L = F.locations[pointees[i]];
+    const ConstraintFile::Object &X = F.objects[L.object];
+    int64_t sum;
+
+    assert(L.offset >= 0);
+    if (!FP.move(l, L.object, X.size, X.flags, L.offset, off, isArray, sum))
+      continue;
+
+    change |= insert(l, F.getLocation(L.object, sum));
+  }
+
+  if (FP.takeCollapsed(objects)) {
+    collapse();
+    change = true;
+  }
+
+  return change;
+}
+
+void OutOfCoreSolver::collapse() {
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    fields.clear();
+    F.collapse(objects[i], fields);
+
+    const Id first = F.getLocation(objects[i], 0);
+    for (std::size_t j = 0; j < fields.size(); ++j) {
+      if (fields[j] < sets.size() && sets[fields[j]].cap) {
+	read(fields[j], values);
+	release(sets[fields[j]]);
+	unite(first, values);
+      }
+      collapsedInto[fields[j]] = first;
+    }
+  }
+}
+
+bool OutOfCoreSolver::applyLoad(Id l, Id r) {
+  bool change = false;
+
+  read(r, pointees);
+  for (std::size_t i = 0; i < pointees.size(); ++i) {
+    read(pointees[i], values);
+    change |= unite(l, values);
+  }
+
+  return change;
+}
+
+bool OutOfCoreSolver::applyStoreAddr(Id l, Id r) {
+  bool change = false;
+
+  read(l, pointers);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= insert(pointers[i], r);
+
+  return change;
+}
+
+bool OutOfCoreSolver::applyStore(Id l, Id r) {
+  bool change = false;
+
+  read(l, pointers);
+  read(r, values);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= unite(pointers[i], values);
+
+  return change;
+}
+
+/* each pointee of l is a pointer loading from r */
+bool OutOfCoreSolver::applyStoreLoad(Id l, Id r) {
+  bool change = false;
+
+  read(l, pointers);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= applyLoad(pointers[i], r);
+
+  return change;
+}
+
+bool OutOfCoreSolver::sweep() {
+  const MappedRules &addr = rules[ConstraintFile::R_ADDR];
+  const MappedRules &copy = rules[ConstraintFile::R_COPY];
+  const MappedRules &geps = rules[ConstraintFile::R_GEP];
+  const MappedRules &load = rules[ConstraintFile::R_LOAD];
+  const MappedRules &storeAddr = rules[ConstraintFile::R_STORE_ADDR];
+  const MappedRules &store = rules[ConstraintFile::R_STORE];
+  const MappedRules &storeLoad = rules[ConstraintFile::R_STORE_LOAD];
+  bool change = false;
+
+  for (std::size_t i = 0; i < addr.size(); ++i)
+    change |= insert(addr.lval[i], addr.rval[i]);
+  for (std::size_t i = 0; i < copy.size(); ++i) {
+    read(copy.rval[i], values);
+    change |= unite(copy.lval[i], values);
+  }
+  for (std::size_t i = 0; i < geps.size(); ++i)
+    change |= applyGep(geps.lval[i], geps.rval[i], geps.off[i],
+	geps.isArray[i]);
+  for (std::size_t i = 0; i < load.size(); ++i)
+    change |= applyLoad(load.lval[i], load.rval[i]);
+  for (std::size_t i = 0; i < storeAddr.size(); ++i)
+    change |= applyStoreAddr(storeAddr.lval[i], storeAddr.rval[i]);
+  for (std::size_t i = 0; i < store.size(); ++i)
+    change |= applyStore(store.lval[i], store.rval[i]);
+  for (std::size_t i = 0; i < storeLoad.size(); ++i)
+    change |= applyStoreLoad(storeLoad.lval[i], storeLoad.rval[i]);
+
+  return change;
+}
+
+void OutOfCoreSolver::fill(PointsToSets &S) const {
+  for (Id id = 0; id < sets.size(); ++id) {
+    if (!sets[id].cap)
+      continue;
+
+    const SetRef &R = sets[find(id)];
+    const ConstraintFile::Location &L = F.locations[id];
+    PointsToSets::PointsToSet &X =
+      S[PointsToSets::Pointer(F.values[L.object], L.offset)];
+
+    for (uint32_t i = 0; i < R.size; ++i) {
+      const ConstraintFile::Location &P = F.locations[elems[R.first + i]];
+      X.insert(PointsToSets::Pointee(F.values[P.object], P.offset));
+    }
+  }
+}
+
+bool OutOfCoreSolver::query(const PointsToSets::Pointer &P,
+    PointsToSets::PointsToSet &out) {
+  DenseMap<const Value *, uint32_t>::const_iterator I =
+    objectOf.find(P.first);
+  if (I == objectOf.end())
+    return false;
+
+  const Id id = F.lookup(I->second, P.second);
+  if (id == ConstraintFile::NONE || id >= sets.size() || !sets[id].cap)
+    return false;
+
+  const SetRef &R = sets[find(id)];
+  for (uint32_t i = 0; i < R.size; ++i) {
+    const ConstraintFile::Location &L = F.locations[elems[R.first + i]];
+    out.insert(PointsToSets::Pointee(F.values[L.object], L.offset));
+  }
+
+  return true;
+}
+
+class MappedEngine {
+public:
+  typedef PointsToSets::PointsToSet PTSet;
+
+  /* @S gets the sets if the files cannot be created */
+  MappedEngine(Module &M, const SolverOptions &O, PointsToSets &S);
+  ~MappedEngine() { delete W; }
+
+  const PTSet *query(const PointsToSets::Pointer &P);
+  /* whether the sets stay in the files, not solved in memory */
+  bool isMapped() const { return W != 0; }
+
+private:
+  typedef PointsToSets::Pointer Pointer;
+
+  PointsToSets &S;
+  OutOfCoreSolver *W;
+  /* the variables substituted by the reduction, see expandSubstitution() */
+  DenseMap<const Value *, const Value *> substituted;
+  DenseMap<Pointer, const PTSet *> answers;
+  HashConsPool<PTSet> pool;
+
+  bool solve(ProgramStructure &P, const SolverOptions &O);
+  bool read(const Pointer &P, PTSet &out);
+};
+
+/* The rules are held once, reduced in place. */
+MappedEngine::MappedEngine(Module &M, const SolverOptions &O,
+    PointsToSets &S) : S(S), W(0) {
+  ProgramStructure P(M, O.onTheFly, O.threads);
+
+  if (O.reduce) {
+    Substitution Sub;
+    ReductionStats St;
+
+    reduceConstraints(P, O.fields, Sub, St);
+    for (std::size_t i = 0; i < Sub.size(); ++i)
+      substituted[Sub[i].first] = Sub[i].second;
+  }
+
+  if (!solve(P, O)) {
+    SolverOptions D(O);
+
+    errs() << "WARNING[PointsTo]: cannot create files in '" << O.mapDir <<
+      "', solving in memory\n";
+    substituted.clear();
+    D.kind = SK_SWEEP;
+
+    /* the reduced rules are no use to it */
+    ProgramStructure::Container().swap(P.getContainer());
+    ProgramStructure U(M, O.onTheFly, O.threads);
+    computePointsToSets(U, S, D);
+  }
+}
+
+/*
+ * In rounds as solveCalls() in PointsTo.cpp does, each with the calls to
+ * the functions found by the previous one, whose rules are appended to
+ * @P. False if the files cannot be created.
+ */
+bool MappedEngine::solve(ProgramStructure &P, const SolverOptions &O) {
+  const ProgramStructure::CallsContainer &calls = P.getIndirectCalls();
+  DenseSet<std::pair<const CallInst *, const Function *> > resolved;
+  unsigned rounds = 0;
+  bool change;
+
+  do {
+    delete W;
+    W = new OutOfCoreSolver(O.fields);
+    if (!W->open(O.mapDir)) {
+      delete W;
+      W = 0;
+      return false;
+    }
+
+    W->compile(P);
+    while (W->sweep())
+      ;
+    rounds++;
+    change = false;
+
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+      PTSet X;
+
+      if (!read(Pointer(getCalledPointer(calls[i]), -1), X))
+	continue;
+
+      for (PTSet::const_iterator I = X.begin(), E = X.end(); I != E; ++I)
+	if (const Function *F = dyn_cast<Function>(I->first))
+	  if (resolved.insert(std::make_pair(calls[i], F)).second) {
+	    collectResolvedCall(calls[i], F, P.getContainer());
+	    change = true;
+	  }
+    }
+  } while (change);
+
+  if (O.stats)
+    errs() << "PointsTo: " << P.getContainer().size() << " rules solved " <<
+      "out of core in " << rounds << " rounds\n";
+
+  return true;
+}
+
+/* false if there is no set for @P, the substituted variables have one */
+bool MappedEngine::read(const Pointer &P, PTSet &out) {
+  DenseMap<const Value *, const Value *>::const_iterator I =
+    substituted.find(P.first);
+
+  if (P.second < 0 && I != substituted.end()) {
+    W->query(Pointer(I->second, -1), out);
+    return true;
+  }
+
+  return W->query(P, out);
+}
+
+const MappedEngine::PTSet *MappedEngine::query(const Pointer &P) {
+  if (!W)
+    return S.PointsToSets::query(P);
+
+  /* computePointsToSets() prunes these */
+  if (isa<Function>(P.first))
+    return 0;
+
+  std::pair<DenseMap<Pointer, const PTSet *>::iterator, bool> I =
+    answers.insert(std::make_pair(P, (const PTSet *)0));
+  if (!I.second)
+    return I.first->second;
+
+  PTSet X;
+  if (read(P, X))
+    I.first->second = pool.take(X);
+
+  return I.first->second;
+}
+
+PointsToSets &solveOutOfCore(const ProgramStructure &P, PointsToSets &S,
+    const FieldOptions &O, const std::string &dir, Budget *B) {
+  OutOfCoreSolver W(O);
+
+  if (!W.open(dir)) {
+    errs() << "WARNING[PointsTo]: cannot create files in '" << dir <<
+      "', solving in memory\n";
+    return solveSweep(P, S, O, B);
+  }
+
+  W.compile(P);
+  while (W.sweep())
+    if (B && B->check())
+      break;
+  W.fill(S);
+
+  return S;
+}
+
+}
+
+MappedPointsToSets::MappedPointsToSets(Module &M, const SolverOptions &O) :
+    E(new detail::MappedEngine(M, O, *this)) {
+  setPartial(E->isMapped());
+}
+
+MappedPointsToSets::~MappedPointsToSets() {
+  delete E;
+}
+
+const PointsToSets::PointsToSet *
+MappedPointsToSets::query(const Pointer &P) const {
+  return E->query(P);
+}
+
+}}
@@ -0,0 +1,137 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Splitting the rules into independent groups.
+ *
+ * A pointee gets from one set to another only through a rule which names
+ * both of them, or through an object which was itself put into a set by
+ * such a rule. So rules which share no value, transitively, never exchange
+ * anything and their groups can be solved apart, each in its own
+ * PointsToSets. The groups are the connected components of the values,
+ * found by union-find. For a GEP, the value is its pointer operand, as
+ * that is what the solvers look at.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Instructions.h"
+
+#include "PointsTo.h"
+#include "RuleExpressions.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+class Components {
+public:
+  unsigned find(const Value *V) { return find(getIndex(V)); }
+  void join(const Value *a, const Value *b) {
+    const unsigned ra = find(a), rb = find(b);
+
+    if (ra != rb)
+      parent[ra] = rb;
+  }
+
+private:
+  DenseMap<const Value *, unsigned> index;
+  std::vector<unsigned> parent;
+
+  unsigned getIndex(const Value *V) {
+    std::pair<DenseMap<const Value *, unsigned>::iterator, bool> I =
+      index.insert(std::make_pair(V, parent.size()));
+
+    if (I.second)
+      parent.push_back(parent.size());
+
+    return I.first->second;
+  }
+
+  unsigned find(unsigned i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+
+    return i;
+  }
+};
+
+/* the value the rule reads, see the header */
+const Value *getSource(const RuleCode &RC) {
+  if (RC.getType() == RCT_VAR_ASGN_GEP)
+    return elimConstExpr(cast<GetElementPtrInst>(RC.getRvalue())->
+	getPointerOperand());
+
+  return RC.getRvalue();
+}
+
+struct BySize {
+  explicit BySize(const std::vector<std::size_t> &size) : size(size) {}
+
+  bool operator()(unsigned a, unsigned b) const {
+    return size[a] > size[b] || (size[a] == size[b] && a < b);
+  }
+
+  const std::vector<std::size_t> &size;
+};
+
+}
+
+void partitionConstraints(const ProgramStructure &P,
+    std::vector<ProgramStructure::Container> &parts, std::size_t minRules) {
+  const ProgramStructure::Container &C = P.getContainer();
+  Components CC;
+
+  for (std::size_t i = 0; i < C.size(); ++i)
+    CC.join(C[i].getLvalue(), getSource(C[i]));
+
+  /* rule -> its component, components numbered as they show up */
+  DenseMap<unsigned, unsigned> number;
+  std::vector<unsigned> comp(C.size());
+  std::vector<std::size_t> size;
+
+  for (std::size_t i = 0; i < C.size(); ++i) {
+    std::pair<DenseMap<unsigned, unsigned>::iterator, bool> I =
+      number.insert(std::make_pair(CC.find(C[i].getLvalue()), size.size()));
+
+    if (I.second)
+      size.push_back(0);
+    comp[i] = I.first->second;
+    size[comp[i]]++;
+  }
+
+  /*
+   * The big components get a part each, the small ones are packed until
+   * they reach @minRules, so that a part is worth a solver.
+   */
+  std::vector<unsigned> order(size.size());
+  for (unsigned i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), BySize(size));
+
+  std::vector<unsigned> part(size.size());
+  std::size_t packed = minRules;
+
+  parts.clear();
+  for (unsigned i = 0; i < order.size(); ++i) {
+    if (size[order[i]] >= minRules || packed >= minRules) {
+      parts.push_back(ProgramStructure::Container());
+      packed = 0;
+    }
+    part[order[i]] = parts.size() - 1;
+    packed += size[order[i]];
+  }
+
+  /* the rules keep their order within a part */
+  for (std::size_t i = 0; i < C.size(); ++i)
+    parts[part[comp[i]]].push_back(C[i]);
+}
+
+}}}
@@ -1,54 +1,146 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <map>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DataLayout.h"
-#include "llvm/Support/GetElementPtrTypeIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 
+#include "Budget.h"
+#include "Cache.h"
+#include "ConstraintFile.h"
 #include "PointsTo.h"
 #include "RuleExpressions.h"
+#include "Solvers.h"
+#include "WorkerPool.h"
 
 #include "../Languages/LLVM.h"
 
 namespace llvm { namespace ptr { namespace detail {
 
+/*
+ * Matches the calls with the functions they may call and the returns with
+ * the calls they return to.
+ *
+ * Functions and indirect calls are bucketed by their signature class, see
+ * Signature. An indirect call may call the functions of all the classes
+ * compatible with its own, this is computed once per class. The returns of
+ * the functions of a class are gathered in one return node, so that each
+ * return is linked to it once and each call reads from it once.
+ *
+ * The functions and the calls are added as the module is walked, then
+ * finish() matches the classes. The rules are collected only after that,
+ * possibly from several threads at once.
+ *
+ * Without @indirect, the indirect calls are left to the solver (see
+ * ProgramStructure::getIndirectCalls()) and only direct calls are matched.
+ */
 class CallMaps {
-private:
-  /* return type -> function */
-  typedef std::multimap<const Type *, const Function *> FunctionsMap;
-  typedef std::multimap<const Type *, const CallInst *> CallsMap;
-
 public:
-  CallMaps(const Module &M) {
-    buildCallMaps(M);
-  }
+  explicit CallMaps(bool indirect = true) : indirect(indirect) {}
+
+  /* a defined function */
+  void addFunction(const Function *f);
+  void addCall(const CallInst *c);
+  /* a memory management function stored to memory */
+  void addStoredFunction(const Function *f);
+  void finish();
+
+  template <typename OutIterator>
+  static void collectCallRuleCodes(const CallInst *c, const Function *f,
+      OutIterator out, RuleWarnings &W);
 
+  /* the returns of @f to @c, for calls resolved by the solver */
   template <typename OutIterator>
-  void collectCallRuleCodes(const CallInst *c, const Function *f,
-      OutIterator out);
+  static void collectResolvedReturnRuleCodes(const CallInst *c,
+      const Function *f, OutIterator out);
 
   template <typename OutIterator>
-  void collectCallRuleCodes(const CallInst *c, OutIterator out);
+  void collectCallRuleCodes(const CallInst *c, OutIterator out,
+      RuleWarnings &W) const;
 
   template <typename OutIterator>
-  void collectReturnRuleCodes(const ReturnInst *r, OutIterator out);
+  void collectReturnRuleCodes(const ReturnInst *r, OutIterator out) const;
 
 private:
-  FunctionsMap FM;
-  CallsMap CM;
+  /*
+   * A prototype as far as matching calls goes. Casting sucks, we can call
+   * (int *) with (char *) parameters. Let's over-approximate: all pointer
+   * parameters are the same (0 here). The return type has to match
+   * exactly.
+   */
+  struct Signature {
+    explicit Signature(const FunctionType *FT);
+
+    bool operator<(const Signature &o) const {
+      if (ret != o.ret)
+	return ret < o.ret;
+      if (isVarArg != o.isVarArg)
+	return isVarArg < o.isVarArg;
+      return params < o.params;
+    }
 
-  static bool compatibleTypes(const Type *t1, const Type *t2);
-  static bool compatibleFunTypes(const FunctionType *f1,
-      const FunctionType *f2);
+    const Type *ret;
+    std::vector<const Type *> params;
+    bool isVarArg;
+  };
+
+  struct SignatureClass {
+    explicit SignatureClass(const Signature &sig) : sig(sig), retNode(0),
+	calledIndirectly(false) {}
+
+    Signature sig;
+    /* which may be called indirectly */
+    std::vector<const Function *> functions;
+    /* classes of the functions the calls of this class may call */
+    std::vector<unsigned> callees;
+    /*
+     * The return node, the first defined function of the class stands
+     * for it. A function is never a variable otherwise.
+     */
+    const Function *retNode;
+    bool calledIndirectly;
+  };
+
+  typedef std::map<Signature, unsigned> ClassMap;
+  typedef DenseMap<const Function *, std::vector<const CallInst *> >
+    DirectCalls;
+
+  bool indirect;
+  ClassMap classIds;
+  std::vector<SignatureClass> classes;
+  DirectCalls directCalls;
+  /* classes of the indirect calls */
+  std::vector<unsigned> callClasses;
+
+  unsigned getClass(const FunctionType *FT);
+  /* the class has to be there already */
+  unsigned findClass(const FunctionType *FT) const;
+  static bool compatible(const Signature &call, const Signature &fun);
   static RuleCode argPassRuleCode(const Value *l, const Value *r);
-  void buildCallMaps(const Module &M);
+  static RuleCode retNodeRuleCode(const Value *l, const Value *r);
 };
 
+CallMaps::Signature::Signature(const FunctionType *FT) :
+    ret(FT->getReturnType()), isVarArg(FT->isVarArg()) {
+  for (unsigned i = 0; i < FT->getNumParams(); ++i) {
+    const Type *T = FT->getParamType(i);
+
+    params.push_back(T->isPointerTy() ? 0 : T);
+  }
+}
+
 RuleCode CallMaps::argPassRuleCode(const Value *l, const Value *r)
 {
     if (isa<ConstantPointerNull const>(r))
@@ -65,9 +157,19 @@ RuleCode CallMaps::argPassRuleCode(const Value *l, const Value *r)
 	    return ruleCode(ruleVar(l) = ruleVar(r));
 }
 
+/* the same as argPassRuleCode() for @l being a return node */
+RuleCode CallMaps::retNodeRuleCode(const Value *l, const Value *r)
+{
+    if (isa<ConstantPointerNull const>(r))
+	return ruleCode(ruleVar(l) = ruleNull(r));
+    if (hasExtraReference(r))
+	return ruleCode(ruleVar(l) = &ruleVar(r));
+    return ruleCode(ruleVar(l) = ruleVar(r));
+}
+
 template <typename OutIterator>
 void CallMaps::collectCallRuleCodes(const CallInst *c, const Function *f,
-    OutIterator out) {
+    OutIterator out, RuleWarnings &W) {
   assert(!isInlineAssembly(c) && "Inline assembly is not supported!");
 
   if (memoryManStuff(f) && !isMemoryAllocation(f))
@@ -77,7 +179,6 @@ void CallMaps::collectCallRuleCodes(const CallInst *c, const Function *f,
     const Value *V = c;
     *out++ = ruleCode(ruleVar(V) = ruleAllocSite(V));
   } else {
-    static unsigned warned = 0;
     Function::const_arg_iterator fit = f->arg_begin();
     unsigned callNumOperands = c->getNumArgOperands();
     size_t i = 0;
@@ -86,444 +187,392 @@ void CallMaps::collectCallRuleCodes(const CallInst *c, const Function *f,
       if (isPointerValue(&*fit))
 	*out++ = argPassRuleCode(&*fit, elimConstExpr(c->getOperand(i)));
 
-    if (i < callNumOperands && warned++ < 3) {
-      errs() << __func__ << ": skipped some vararg arguments in '" <<
-	f->getName() << "(" << i << ", " << callNumOperands << ")'\n";
-    }
+    if (i < callNumOperands)
+      W.varargs.push_back(std::make_pair(c, f));
   }
 }
 
-bool CallMaps::compatibleTypes(const Type *t1, const Type *t2) {
+template <typename OutIterator>
+void CallMaps::collectResolvedReturnRuleCodes(const CallInst *c,
+    const Function *f, OutIterator out) {
+  if (!isPointerValue(c) || memoryManStuff(f))
+    return;
 
-  /*
-   * Casting sucks, we can call (int *) with (char *) parameters.
-   * Let's over-approximate.
-   */
-  if (t1->isPointerTy() && t2->isPointerTy())
-    return true;
+  for (Function::const_iterator B = f->begin(), E = f->end(); B != E; ++B)
+    if (const ReturnInst *r = dyn_cast<ReturnInst>(B->getTerminator())) {
+      const Value *retVal = r->getReturnValue();
 
-  return t1 == t2;
+      if (retVal && isPointerValue(retVal))
+	*out++ = argPassRuleCode(c, retVal);
+    }
 }
 
-bool CallMaps::compatibleFunTypes(const FunctionType *f1,
-		const FunctionType *f2) {
-
-  unsigned params1 = f1->getNumParams();
-  unsigned params2 = f2->getNumParams();
+/* The parameter counts have to match unless one of them is variadic. */
+bool CallMaps::compatible(const Signature &call, const Signature &fun) {
+  const std::size_t params1 = call.params.size();
+  const std::size_t params2 = fun.params.size();
 
-  if (!f1->isVarArg() && !f2->isVarArg() && params1 != params2)
+  if (call.ret != fun.ret)
     return false;
 
-  if (!compatibleTypes(f1->getReturnType(), f2->getReturnType()))
+  if (!call.isVarArg && !fun.isVarArg && params1 != params2)
     return false;
 
-  for (int i = 0; i < params1 && i < params2; i++)
-    if (!compatibleTypes(f1->getParamType(i), f2->getParamType(i)))
+  for (std::size_t i = 0; i < params1 && i < params2; i++)
+    if (call.params[i] != fun.params[i])
       return false;
 
   return true;
 }
 
+unsigned CallMaps::getClass(const FunctionType *FT) {
+  const Signature sig(FT);
+  ClassMap::const_iterator I = classIds.find(sig);
+
+  if (I != classIds.end())
+    return I->second;
+
+  classes.push_back(SignatureClass(sig));
+  classIds.insert(std::make_pair(sig, classes.size() - 1));
+
+  return classes.size() - 1;
+}
+
+unsigned CallMaps::findClass(const FunctionType *FT) const {
+  ClassMap::const_iterator I = classIds.find(Signature(FT));
+
+  assert(I != classIds.end() && "The class was not added");
+  return I->second;
+}
+
 template<typename OutIterator>
-void CallMaps::collectCallRuleCodes(const CallInst *c, OutIterator out) {
+void CallMaps::collectCallRuleCodes(const CallInst *c,
+    OutIterator out, RuleWarnings &W) const {
 
     if (const Function *f = c->getCalledFunction()) {
-      collectCallRuleCodes(c, f, out);
+      collectCallRuleCodes(c, f, out, W);
       return;
     }
 
-    const FunctionType *funTy = getCalleePrototype(c);
-    const Type *retTy = funTy->getReturnType();
+    const SignatureClass &C = classes[findClass(getCalleePrototype(c))];
 
-    for (FunctionsMap::const_iterator I = FM.lower_bound(retTy),
-	E = FM.upper_bound(retTy); I != E; ++I) {
-      const Function *fun = I->second;
+    for (std::size_t i = 0; i < C.callees.size(); ++i) {
+      const SignatureClass &F = classes[C.callees[i]];
 
-      if (compatibleFunTypes(funTy, fun->getFunctionType()))
-	collectCallRuleCodes(c, fun, out);
+      for (std::size_t j = 0; j < F.functions.size(); ++j)
+	collectCallRuleCodes(c, F.functions[j], out, W);
+      if (F.retNode && isPointerValue(c) && !callToMemoryManStuff(c)) {
+	const Value *V = c, *R = F.retNode;
+	*out++ = ruleCode(ruleVar(V) = ruleVar(R));
+      }
     }
 }
 
 template<typename OutIterator>
-void CallMaps::collectReturnRuleCodes(const ReturnInst *r, OutIterator out) {
+void CallMaps::collectReturnRuleCodes(const ReturnInst *r,
+    OutIterator out) const {
   const Value *retVal = r->getReturnValue();
 
   if (!retVal || !isPointerValue(retVal))
     return;
 
   const Function *f = r->getParent()->getParent();
-  const FunctionType *funTy = f->getFunctionType();
-  const Type *retTy = funTy->getReturnType();
-
-  for (CallsMap::const_iterator b = CM.lower_bound(retTy),
-      e = CM.upper_bound(retTy); b != e; ++b) {
-    const CallInst *CI = b->second;
-
-    if (const Function *g = CI->getCalledFunction()) {
-      if (f == g)
-	*out++ = argPassRuleCode(CI, retVal);
-    } else if (compatibleFunTypes(funTy, getCalleePrototype(CI)))
-	*out++ = argPassRuleCode(CI, retVal);
-  }
+  const DirectCalls::const_iterator I = directCalls.find(f);
+
+  if (I != directCalls.end())
+    for (std::size_t i = 0; i < I->second.size(); ++i)
+      *out++ = argPassRuleCode(I->second[i], retVal);
+
+  const SignatureClass &F = classes[findClass(f->getFunctionType())];
+  if (F.calledIndirectly)
+    *out++ = retNodeRuleCode(F.retNode, retVal);
 }
 
-void CallMaps::buildCallMaps(const Module &M) {
-    for (Module::const_iterator f = M.begin(); f != M.end(); ++f) {
-	if (!f->isDeclaration()) {
-	    const FunctionType *funTy = f->getFunctionType();
+void CallMaps::addFunction(const Function *f) {
+  SignatureClass &F = classes[getClass(f->getFunctionType())];
 
-	    FM.insert(std::make_pair(funTy->getReturnType(), &*f));
-	}
+  F.functions.push_back(f);
+  if (!F.retNode)
+    F.retNode = f;
+}
+
+void CallMaps::addCall(const CallInst *c) {
+  if (!c->getCalledFunction()) {
+    if (indirect)
+      callClasses.push_back(getClass(getCalleePrototype(c)));
+  } else if (!callToMemoryManStuff(c))
+    directCalls[c->getCalledFunction()].push_back(c);
+}
 
-	for (const_inst_iterator i = inst_begin(f), E = inst_end(f);
-		i != E; ++i) {
-	    if (const CallInst *CI = dyn_cast<CallInst>(&*i)) {
-		if (!isInlineAssembly(CI) && !callToMemoryManStuff(CI)) {
-		    const FunctionType *funTy = getCalleePrototype(CI);
+void CallMaps::addStoredFunction(const Function *f) {
+  classes[getClass(f->getFunctionType())].functions.push_back(f);
+}
 
-		    CM.insert(std::make_pair(funTy->getReturnType(), CI));
-		}
-	    } else if (const StoreInst *SI = dyn_cast<StoreInst>(&*i)) {
-		const Value *r = SI->getValueOperand();
+void CallMaps::finish() {
+    std::sort(callClasses.begin(), callClasses.end());
+    callClasses.erase(std::unique(callClasses.begin(), callClasses.end()),
+	    callClasses.end());
 
-		if (hasExtraReference(r) && memoryManStuff(r)) {
-		    const Function *fn = dyn_cast<Function>(r);
-		    const FunctionType *funTy = fn->getFunctionType();
+    for (std::size_t i = 0; i < callClasses.size(); ++i) {
+	SignatureClass &C = classes[callClasses[i]];
 
-		    FM.insert(std::make_pair(funTy->getReturnType(), fn));
-		}
+	for (unsigned k = 0; k < classes.size(); ++k) {
+	    SignatureClass &F = classes[k];
+
+	    if (!F.functions.empty() && compatible(C.sig, F.sig)) {
+		C.callees.push_back(k);
+		F.calledIndirectly = true;
 	    }
 	}
     }
 }
 
-}}}
+/*
+ * What one function contributes to ProgramStructure, collected apart from
+ * the others. The rules of the returns and of the matched indirect calls
+ * need CallMaps of the whole module, so they are only marked in @rules by
+ * @deferred for now.
+ */
+struct FunctionRules {
+  std::vector<RuleCode> rules;
+  /* <index to rules, the call or return whose rules go there> */
+  std::vector<std::pair<std::size_t, const Instruction *> > deferred;
+  /* for CallMaps */
+  std::vector<const CallInst *> calls;
+  std::vector<const Function *> stored;
+  /* left to the solver, see ProgramStructure::getIndirectCalls() */
+  std::vector<const CallInst *> unresolved;
+  RuleWarnings warnings;
+};
 
-namespace llvm { namespace ptr {
+static void collectResolvedCall(const CallInst *c, const Function *f,
+    std::vector<RuleCode> &out, RuleWarnings &W) {
+  CallMaps::collectCallRuleCodes(c, f, std::back_inserter(out), W);
+  CallMaps::collectResolvedReturnRuleCodes(c, f, std::back_inserter(out));
+}
 
-typedef PointsToSets::PointsToSet PTSet;
-typedef PointsToSets::Pointer Ptr;
+static void collectFunctionRules(const Function &f, bool deferCalls,
+    FunctionRules &FR) {
+    for (const_inst_iterator i = inst_begin(f), E = inst_end(f); i != E;
+	    ++i) {
+	const Instruction *I = &*i;
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    VARIABLE<const llvm::Value *>
-		    > const& E) {
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    const PTSet &R = S[Ptr(rval, -1)];
-    const std::size_t old_size = L.size();
-
-    std::copy(R.begin(), R.end(), std::inserter(L, L.end()));
-
-    return old_size != L.size();
-}
-
-static int64_t accumulateConstantOffset(const GetElementPtrInst *gep,
-	const DataLayout &DL, bool &isArray) {
-    int64_t off = 0;
-
-    for (gep_type_iterator GTI = gep_type_begin(gep), GTE = gep_type_end(gep);
-	    GTI != GTE; ++GTI) {
-	ConstantInt *OpC = dyn_cast<ConstantInt>(GTI.getOperand());
-	if (!OpC) /* skip non-const array indices */
-	    continue;
-	if (OpC->isZero())
-	    continue;
-
-	int64_t ElementIdx = OpC->getSExtValue();
-
-	// Handle a struct index, which adds its field offset to the pointer.
-	if (StructType *STy = dyn_cast<StructType>(*GTI)) {
-	    const StructLayout *SL = DL.getStructLayout(STy);
-	    off += SL->getElementOffset(ElementIdx);
-	    continue;
-	} else if (SequentialType *STy = dyn_cast<SequentialType>(*GTI)) {
-	    off += ElementIdx * DL.getTypeStoreSize(GTI.getIndexedType());
-	    isArray = true;
-	    continue;
+	if (const CallInst *c = dyn_cast<CallInst>(I)) {
+	    if (!isInlineAssembly(c))
+		FR.calls.push_back(c);
+	} else if (const StoreInst *SI = dyn_cast<StoreInst>(I)) {
+	    const Value *r = SI->getValueOperand();
+
+	    if (hasExtraReference(r) && memoryManStuff(r))
+		FR.stored.push_back(cast<Function>(r));
 	}
-#ifdef FIELD_DEBUG
-	errs() << "skipping " << OpC->getValue() << " in ";
-	gep->dump();
-#endif
-    }
 
-    return off;
+	if (isPointerManipulation(I))
+	    toRuleCode(I, std::back_inserter(FR.rules), FR.warnings);
+	else if (const CallInst *c = dyn_cast<CallInst>(I)) {
+	    if (isInlineAssembly(c))
+		continue;
+	    if (const Function *callee = c->getCalledFunction())
+		CallMaps::collectCallRuleCodes(c, callee,
+			std::back_inserter(FR.rules), FR.warnings);
+	    else if (!deferCalls)
+		FR.deferred.push_back(std::make_pair(FR.rules.size(), I));
+	    else if (const Function *callee =
+		    dyn_cast<Function>(getCalledPointer(c)))
+		/* a cast function, no need to wait for the solver */
+		collectResolvedCall(c, callee, FR.rules, FR.warnings);
+	    else
+		FR.unresolved.push_back(c);
+	} else if (isa<ReturnInst>(I))
+	    FR.deferred.push_back(std::make_pair(FR.rules.size(), I));
+    }
 }
 
-static bool checkOffset(const DataLayout &DL, const Value *Rval, uint64_t sum) {
-  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(Rval)) {
-    if (GV->hasInitializer() &&
-	sum >= DL.getTypeAllocSize(GV->getInitializer()->getType()))
-      return false;
-  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(Rval)) {
-    if (!AI->isArrayAllocation() &&
-	sum >= DL.getTypeAllocSize(AI->getAllocatedType()))
-      return false;
+/* the rules of @FR with the deferred ones in place, to @out */
+static void expandFunctionRules(const CallMaps &CM, FunctionRules &FR,
+    std::vector<RuleCode> &out) {
+  std::size_t from = 0;
+
+  for (std::size_t i = 0; i < FR.deferred.size(); ++i) {
+    const std::size_t to = FR.deferred[i].first;
+    const Instruction *I = FR.deferred[i].second;
+
+    out.insert(out.end(), FR.rules.begin() + from, FR.rules.begin() + to);
+    from = to;
+
+    if (const CallInst *c = dyn_cast<CallInst>(I))
+      CM.collectCallRuleCodes(c, std::back_inserter(out), FR.warnings);
+    else
+      CM.collectReturnRuleCodes(cast<ReturnInst>(I),
+	  std::back_inserter(out));
   }
+  out.insert(out.end(), FR.rules.begin() + from, FR.rules.end());
+}
 
-  return true;
+const Value *getCalledPointer(const CallInst *c) {
+  return c->getCalledValue()->stripPointerCasts();
 }
 
-static bool applyRule(PointsToSets &S, const llvm::DataLayout &DL, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    GEP<VARIABLE<const llvm::Value *> >
-		    > const& E) {
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    const std::size_t old_size = L.size();
+/* the solvers resolve the calls in one thread, the warnings go right away */
+void collectResolvedCall(const CallInst *c, const Function *f,
+    std::vector<RuleCode> &out) {
+  RuleWarnings W;
 
-    const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(rval);
-    const llvm::Value *op = elimConstExpr(gep->getPointerOperand());
-    bool isArray = false;
-    int64_t off = accumulateConstantOffset(gep, DL, isArray);
+  collectResolvedCall(c, f, out, W);
+  printRuleWarnings(W);
+}
 
-    if (hasExtraReference(op)) {
-	L.insert(Ptr(op, off)); /* VAR = REF */
-    } else {
-	const PTSet &R = S[Ptr(op, -1)];
-	for (PTSet::const_iterator I = R.begin(), E = R.end(); I != E; ++I) {
-	    assert(I->second >= 0);
+void printRuleWarnings(const RuleWarnings &W) {
+  static std::atomic<unsigned> warned(0);
 
-	    /* disable recursive structures */
-	    if (L.count(*I))
-		    continue;
+  for (std::size_t i = 0; i < W.intToPtr.size(); ++i) {
+    const IntToPtrInst *I = W.intToPtr[i];
 
-	    const Value *Rval = I->first;
+    errs() << "WARNING[PointsTo]: Integer ";
+    if (const ConstantInt *C = dyn_cast<ConstantInt>(I->getOperand(0)))
+      errs() << "(" << C->getValue() << ") ";
+    errs() << "converted to a pointer in '" <<
+      I->getParent()->getParent()->getName() <<
+      "' => getting unsound analysis!\n";
+  }
 
-	    if (off && (isa<Function>(Rval) || isa<ConstantPointerNull>(Rval)))
-	      continue;
+  for (std::size_t i = 0; i < W.varargs.size() && warned++ < 3; ++i) {
+    const CallInst *c = W.varargs[i].first;
+    const Function *f = W.varargs[i].second;
 
-	    int64_t sum = I->second + off;
+    errs() << "WARNING[PointsTo]: skipped some vararg arguments in '" <<
+      f->getName() << "(" << f->arg_size() << ", " <<
+      c->getNumArgOperands() << ")'\n";
+  }
+}
 
-	    if (!checkOffset(DL, Rval, sum))
-	      continue;
+}}}
 
-	    unsigned int sameCount = 0;
-	    for (PTSet::const_iterator II = L.begin(), EE = L.end();
-		II != EE; ++II) {
-	      if (II->first == Rval)
-		if (++sameCount >= 5)
-		  break;
-	    }
+namespace llvm { namespace ptr {
 
-	    if (sameCount >= 3) {
-#ifdef DEBUG_CROPPING
-	      errs() << "dropping GEP ";
-	      gep->dump();
-	      errs() << "\tHAVE " << off << "+" << " OFF=" << I->second << " ";
-	      Rval->dump();
-#endif
-	      continue;
-	    }
+typedef PointsToSets::PointsToSet PTSet;
+typedef PointsToSets::Pointer Ptr;
 
-	    if (sum < 0) {
-		    assert(I->second >= 0);
-#ifdef DEBUG_CROPPING
-		    errs() << "variable index, cropping to 0: " <<
-			    I->second << "+" << off << "\n\t";
-		    gep->dump();
-		    errs() << "\tPTR=";
-		    Rval->dump();
-#endif
-		    sum = 0;
-	    }
+const unsigned PointsToSets::NONE;
 
-	    /* an unsoundness :) */
-	    if (isArray && sum > 64)
-		sum = 64;
+PointsToSets::insert_retval PointsToSets::insert(value_type const& val) {
+  LocationId id = L.getId(val.first);
 
-	    L.insert(Ptr(Rval, sum)); /* V = V */
-	}
-    }
+  if (id >= slots.size())
+    slots.resize(id + 1, NONE);
+  if (slots[id] != NONE)
+    return insert_retval(C.begin() + slots[id], false);
 
-    return old_size != L.size();
-}
+  slots[id] = C.size();
+  C.push_back(val);
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    REFERENCE<VARIABLE<const llvm::Value *> >
-		    > const& E) {
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    const std::size_t old_size = L.size();
+  return insert_retval(C.end() - 1, true);
+}
 
-    L.insert(Ptr(rval, 0));
+PointsToSets::SharedSet &PointsToSets::getSlot(LocationId id) {
+  if (id >= slots.size())
+    slots.resize(id + 1, NONE);
+  if (slots[id] == NONE) {
+    slots[id] = C.size();
+    C.push_back(value_type(L.getLocation(id), SharedSet()));
+  }
 
-    return old_size != L.size();
+  return C[slots[id]].second;
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    DEREFERENCE< VARIABLE<const llvm::Value *> >
-		    > const& E, const int idx = -1)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument().getArgument();
-    PTSet &L = S[Ptr(lval, idx)];
-    PTSet &R = S[Ptr(rval, -1)];
-    const std::size_t old_size = L.size();
-
-    for (PTSet::const_iterator i = R.begin(); i!=R.end(); ++i) {
-	PTSet &X = S[*i];
-	std::copy(X.begin(), X.end(), std::inserter(L, L.end()));
-    }
+PTSet &PointsToSets::operator[](LocationId id) {
+  SharedSet &X = getSlot(id);
+
+  if (X.shared) {
+    X.own = *X.shared;
+    X.shared = 0;
+  }
 
-    return old_size != L.size();
+  return X.own;
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    DEREFERENCE<VARIABLE<const llvm::Value *> >,
-		    VARIABLE<const llvm::Value *>
-		    > const& E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    PTSet &R = S[Ptr(rval, -1)];
-    bool change = false;
-
-    for (PTSet::const_iterator i = L.begin(); i != L.end(); ++i) {
-	PTSet &X = S[*i];
-	const std::size_t old_size = X.size();
-
-	std::copy(R.begin(), R.end(), std::inserter(X, X.end()));
-	change = change || X.size() != old_size;
-    }
+PointsToSets::const_iterator PointsToSets::find(key_type const& key) const {
+  assertWhole();
+  LocationId id = L.lookup(key);
 
-    return change;
-}
+  if (id >= slots.size() || slots[id] == NONE)
+    return C.end();
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    DEREFERENCE<VARIABLE<const llvm::Value *> >,
-		    REFERENCE<VARIABLE<const llvm::Value *> >
-		    > const &E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    bool change = false;
+  return C.begin() + slots[id];
+}
 
-    for (PTSet::const_iterator i = L.begin(); i != L.end(); ++i) {
-	PTSet &X = S[*i];
-	const std::size_t old_size = X.size();
+PointsToSets::iterator PointsToSets::find(key_type const& key) {
+  assertWhole();
+  LocationId id = L.lookup(key);
 
-	X.insert(Ptr(rval, 0));
-	change = change || X.size() != old_size;
-    }
+  if (id >= slots.size() || slots[id] == NONE)
+    return C.end();
 
-    return change;
+  return C.begin() + slots[id];
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    DEREFERENCE<VARIABLE<const llvm::Value *> >,
-		    DEREFERENCE<VARIABLE<const llvm::Value *> >
-		    > const& E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    bool change = false;
-
-    for (PTSet::const_iterator i = L.begin(); i != L.end(); ++i)
-	if (applyRule(S, (ruleVar(i->first) = *ruleVar(rval)).getSort(),
-				i->second))
-	    change = true;
+const PTSet *PointsToSets::lookup(LocationId id) const {
+  assertWhole();
+  if (id >= slots.size() || slots[id] == NONE)
+    return 0;
 
-    return change;
+  return &C[slots[id]].second.get();
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    ALLOC<const llvm::Value *>
-		    > const &E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    const std::size_t old_size = L.size();
+const PTSet *PointsToSets::query(const Pointer &P) const {
+  return lookup(L.lookup(P));
+}
 
-    L.insert(Ptr(rval, 0));
+void PointsToSets::share() {
+  for (iterator I = C.begin(), E = C.end(); I != E; ++I) {
+    SharedSet &X = I->second;
 
-    return old_size != L.size();
+    if (!X.shared)
+      X.shared = pool.take(X.own);
+  }
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    VARIABLE<const llvm::Value *>,
-		    NULLPTR<const llvm::Value *>
-		    > const &E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    const std::size_t old_size = L.size();
+const PTSet *PointsToSets::share(LocationId id) {
+  SharedSet &X = getSlot(id);
 
-    L.insert(Ptr(rval, 0));
+  if (!X.shared)
+    X.shared = pool.take(X.own);
 
-    return old_size != L.size();
+  return X.shared;
 }
 
-static bool applyRule(PointsToSets &S, ASSIGNMENT<
-		    DEREFERENCE<VARIABLE<const llvm::Value *> >,
-		    NULLPTR<const llvm::Value *>
-		    > const &E)
-{
-    const llvm::Value *lval = E.getArgument1().getArgument().getArgument();
-    const llvm::Value *rval = E.getArgument2().getArgument();
-    PTSet &L = S[Ptr(lval, -1)];
-    bool change = false;
+void PointsToSets::assign(LocationId id, const PTSet *shared) {
+  SharedSet &X = getSlot(id);
 
-    for (PTSet::const_iterator i = L.begin(); i != L.end(); ++i) {
-	PTSet &X = S[*i];
-	const std::size_t old_size = X.size();
-
-	X.insert(Ptr(rval, 0));
-	change = change || X.size() != old_size;
-    }
-
-    return change;
+  X.own.clear();
+  X.shared = shared;
 }
 
-static bool applyRule(PointsToSets &S, DEALLOC<const llvm::Value *>) {
-    return false;
+void PointsToSets::clear() {
+  C.clear();
+  std::vector<unsigned>().swap(slots);
+  pool.clear();
 }
 
-static bool applyRules(const RuleCode &RC, PointsToSets &S,
-		const llvm::DataLayout &DL)
-{
-    const llvm::Value *lval = RC.getLvalue();
-    const llvm::Value *rval = RC.getRvalue();
-
-    switch (RC.getType()) {
-    case RCT_VAR_ASGN_ALLOC:
-	return applyRule(S, (ruleVar(lval) = ruleAllocSite(rval)).getSort());
-    case RCT_VAR_ASGN_NULL:
-	return applyRule(S, (ruleVar(lval) = ruleNull(rval)).getSort());
-    case RCT_VAR_ASGN_VAR:
-	return applyRule(S, (ruleVar(lval) = ruleVar(rval)).getSort());
-    case RCT_VAR_ASGN_GEP:
-	return applyRule(S, DL,
-			(ruleVar(lval) = ruleVar(rval).gep()).getSort());
-    case RCT_VAR_ASGN_REF_VAR:
-	return applyRule(S, (ruleVar(lval) = &ruleVar(rval)).getSort());
-    case RCT_VAR_ASGN_DREF_VAR:
-	return applyRule(S, (ruleVar(lval) = *ruleVar(rval)).getSort());
-    case RCT_DREF_VAR_ASGN_NULL:
-	return applyRule(S, (*ruleVar(lval) = ruleNull(rval)).getSort());
-    case RCT_DREF_VAR_ASGN_VAR:
-	return applyRule(S, (*ruleVar(lval) = ruleVar(rval)).getSort());
-    case RCT_DREF_VAR_ASGN_REF_VAR:
-	return applyRule(S, (*ruleVar(lval) = &ruleVar(rval)).getSort());
-    case RCT_DREF_VAR_ASGN_DREF_VAR:
-	return applyRule(S, (*ruleVar(lval) = *ruleVar(rval)).getSort());
-    case RCT_DEALLOC:
-	return applyRule(S, ruleDeallocSite(RC.getValue()).getSort());
-    default:
-	assert(0);
+bool detail::getObjectSize(const DataLayout &DL, const Value *V,
+	uint64_t &size) {
+  if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(V)) {
+    if (GV->hasInitializer()) {
+      size = DL.getTypeAllocSize(GV->getInitializer()->getType());
+      return true;
+    }
+  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(V)) {
+    if (!AI->isArrayAllocation()) {
+      size = DL.getTypeAllocSize(AI->getAllocatedType());
+      return true;
     }
+  }
+
+  return false;
+}
+
+static bool isFunctionEntry(const PointsToSets::value_type &V) {
+  return llvm::isa<llvm::Function>(V.first.first);
 }
 
 /*
@@ -531,14 +580,11 @@ static bool applyRules(const RuleCode &RC, PointsToSets &S,
  * account bitcast instructions in the code.
  */
 static PointsToSets &pruneByType(PointsToSets &S) {
+  S.remove_if(isFunctionEntry);
+#if 0
   typedef PointsToSets::mapped_type PTSet;
-  for (PointsToSets::iterator s = S.begin(); s != S.end(); ) {
+  for (PointsToSets::iterator s = S.begin(); s != S.end(); ++s) {
       const llvm::Value *first = s->first.first;
-      if (llvm::isa<llvm::Function>(first)) {
-	const PointsToSets::iterator tmp = s++;
-	S.getContainer().erase(tmp);
-      } else {
-#if 0
 	if (isPointerValue(first)) {
 	  const llvm::Type *firstTy;
 	  if (const llvm::BitCastInst *BC =
@@ -566,70 +612,407 @@ static PointsToSets &pruneByType(PointsToSets &S) {
 	      ++v;
 	  }
 	}
+  }
 #endif
-	++s;
-      }
+  return S;
+}
+
+SolverOptions getSolverOptions() {
+  SolverOptions O;
+
+  if (const char *solver = getenv("SLICE_PTS_SOLVER")) {
+    if (!strcmp(solver, "sweep"))
+      O.kind = SK_SWEEP;
+    else if (!strcmp(solver, "worklist"))
+      O.kind = SK_WORKLIST;
+    else if (!strcmp(solver, "wave"))
+      O.kind = SK_WAVE;
+    else if (!strcmp(solver, "steensgaard"))
+      O.kind = SK_STEENSGAARD;
+    else if (!strcmp(solver, "mapped"))
+      O.kind = SK_MAPPED;
+    else
+      errs() << "WARNING[PointsTo]: unknown solver '" << solver <<
+	"', using the default one\n";
   }
+
+  if (const char *reduce = getenv("SLICE_PTS_REDUCE"))
+    O.reduce = atoi(reduce);
+
+  if (const char *stats = getenv("SLICE_PTS_STATS"))
+    O.stats = atoi(stats);
+
+  if (const char *threads = getenv("SLICE_PTS_THREADS"))
+    O.threads = atoi(threads);
+
+  if (const char *cache = getenv("SLICE_PTS_CACHE"))
+    O.cache = cache;
+
+  if (const char *demand = getenv("SLICE_PTS_DEMAND"))
+    O.demand = atoi(demand);
+
+  if (const char *budget = getenv("SLICE_PTS_BUDGET"))
+    O.budget = atoi(budget);
+
+  if (const char *otf = getenv("SLICE_PTS_OTF"))
+    O.onTheFly = atoi(otf);
+
+  if (const char *offsets = getenv("SLICE_PTS_MAX_OFFSETS"))
+    O.fields.maxOffsets = atoi(offsets);
+
+  if (const char *limit = getenv("SLICE_PTS_ARRAY_LIMIT"))
+    O.fields.arrayLimit = atoi(limit);
+
+  if (const char *arrays = getenv("SLICE_PTS_COLLAPSE_ARRAYS"))
+    O.fields.collapseArrays = atoi(arrays);
+
+  if (const char *cut = getenv("SLICE_PTS_CUT_RECURSION"))
+    O.fields.cutRecursion = atoi(cut);
+
+  if (const char *time = getenv("SLICE_PTS_TIME_LIMIT"))
+    O.timeLimit = atoi(time);
+
+  if (const char *mem = getenv("SLICE_PTS_MEM_LIMIT"))
+    O.memLimit = atoi(mem);
+
+  if (const char *dump = getenv("SLICE_PTS_DUMP"))
+    O.dump = dump;
+
+  if (const char *partition = getenv("SLICE_PTS_PARTITION"))
+    O.partition = atoi(partition);
+
+  if (const char *dir = getenv("SLICE_PTS_MAP_DIR"))
+    O.mapDir = dir;
+  else if (const char *tmp = getenv("TMPDIR"))
+    O.mapDir = tmp;
+
+  return O;
+}
+
+PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S) {
+  return computePointsToSets(P, S, getSolverOptions());
+}
+
+static PointsToSets &solveWhole(const ProgramStructure &P, PointsToSets &S,
+		const SolverOptions &O, detail::Budget *B) {
+  switch (O.kind) {
+  case SK_SWEEP:
+    return detail::solveSweep(P, S, O.fields, B);
+  case SK_WORKLIST:
+    return detail::solveWorklist(P, S, O.fields, B);
+  case SK_WAVE:
+    return detail::solveWave(P, S, O.threads, O.fields, B);
+  case SK_MAPPED:
+    return detail::solveOutOfCore(P, S, O.fields, O.mapDir, B);
+  case SK_STEENSGAARD:
+    return detail::solveSteensgaard(P, S, O.fields);
+  }
+
+  assert(0 && "Unknown points-to solver");
   return S;
 }
 
-static PointsToSets &fixpoint(const ProgramStructure &P, PointsToSets &S)
-{
-  bool change;
+/*
+ * With O.partition, the parts of @P which share no value are solved apart
+ * (see partitionConstraints()), in parallel, and merged into @S. A small
+ * part is done as soon as it converges, it does not wait for the others.
+ */
+static PointsToSets &solve(const ProgramStructure &P, PointsToSets &S,
+		const SolverOptions &O, detail::Budget *B) {
+  if (!O.partition)
+    return solveWhole(P, S, O, B);
+
+  std::vector<ProgramStructure::Container> parts;
+
+  detail::partitionConstraints(P, parts, O.partition);
+  if (parts.size() < 2)
+    return solveWhole(P, S, O, B);
+
+  std::deque<PointsToSets> solved(parts.size());
+  SolverOptions PO(O);
+  WorkerPool pool(O.threads);
+
+  /* the parts are run in parallel already */
+  PO.threads = 1;
+  pool.run(parts.size(), [&](std::size_t i) {
+    ProgramStructure part(P.getModule(), parts[i]);
+
+    solveWhole(part, solved[i], PO, B);
+  });
+
+  for (std::size_t i = 0; i < solved.size(); ++i)
+    for (PointsToSets::const_iterator I = solved[i].begin(),
+	E = solved[i].end(); I != E; ++I) {
+      PTSet &X = S[I->first];
+      X.insert(I->second.begin(), I->second.end());
+    }
+
+  if (O.stats)
+    errs() << "PointsTo: solved in " << parts.size() << " parts\n";
 
-  DataLayout DL(&P.getModule());
+  return S;
+}
+
+/*
+ * The worklist solver adds the rules of the indirect calls as it goes. The
+ * other ones cannot take new rules while solving, so they are run in rounds
+ * instead, each with the calls to the functions found by the previous one,
+ * until no new function shows up or @B is exceeded.
+ */
+static PointsToSets &solveCalls(const ProgramStructure &P, PointsToSets &S,
+		const SolverOptions &O, detail::Budget *B) {
+  const ProgramStructure::CallsContainer &calls = P.getIndirectCalls();
+
+  /* the parts have no calls to resolve, see solve() */
+  if (calls.empty() || (O.kind == SK_WORKLIST && !O.partition))
+    return solve(P, S, O, B);
+
+  ProgramStructure R(P);
+  DenseSet<std::pair<const CallInst *, const Function *> > resolved;
+  unsigned rounds = 0;
+  bool change;
 
   do {
+    solve(R, S, O, B);
+    rounds++;
     change = false;
 
-    for (ProgramStructure::const_iterator i = P.begin(); i != P.end(); ++i)
-      change |= applyRules(*i, S, DL);
+    if (B && B->check())
+      break;
+
+    for (std::size_t i = 0; i < calls.size(); ++i) {
+      const PTSet *X = S.query(Ptr(detail::getCalledPointer(calls[i]), -1));
+      if (!X)
+	continue;
+
+      for (PTSet::const_iterator I = X->begin(), E = X->end(); I != E; ++I)
+	if (const Function *F = dyn_cast<Function>(I->first))
+	  if (resolved.insert(std::make_pair(calls[i], F)).second) {
+	    detail::collectResolvedCall(calls[i], F, R.getContainer());
+	    change = true;
+	  }
+    }
   } while (change);
 
+  if (O.stats)
+    errs() << "PointsTo: " << calls.size() << " indirect calls resolved to " <<
+      resolved.size() << " callees in " << rounds << " rounds\n";
+
   return S;
 }
 
-PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S) {
-  return pruneByType(fixpoint(P, S));
+static void warnExceeded(const detail::Budget &B, const char *next) {
+  errs() << "WARNING[PointsTo]: out of " <<
+    (B.getHit() == detail::Budget::TIME ? "time" : "memory") <<
+    ", solving again " << next << '\n';
+}
+
+/*
+ * Solves within O.timeLimit and O.memLimit. The sets of a solver which runs
+ * out of them are incomplete, so they are thrown away and solved again in a
+ * cheaper way, less precise but complete, see detail::solveDegrading().
+ */
+static PointsToSets &solveLimited(const ProgramStructure &P, PointsToSets &S,
+		const SolverOptions &O) {
+  if ((!O.timeLimit && !O.memLimit) || O.kind == SK_STEENSGAARD)
+    return solveCalls(P, S, O, 0);
+
+  detail::Budget B(O.timeLimit, O.memLimit), B2(O.timeLimit, O.memLimit);
+
+  return detail::solveDegrading(P, S, O, B, B2);
+}
+
+/*
+ * The steps are:
+ *  1. with the objects collapsed to a single field, arrays included,
+ *  2. by unification, which is almost linear and runs with no limit.
+ * The steps taken are recorded in @S, see PointsToSets::getDegradation().
+ */
+PointsToSets &detail::solveDegrading(const ProgramStructure &P,
+		PointsToSets &S, const SolverOptions &O, Budget &B, Budget &B2) {
+  SolverOptions D(O);
+
+  solveCalls(P, S, D, &B);
+  if (!B.getHit())
+    return S;
+
+  if (D.fields.maxOffsets > 1 || !D.fields.collapseArrays) {
+    warnExceeded(B, "with the objects collapsed");
+    S.clear();
+    S.degrade(PointsToSets::DG_FIELDS);
+    D.fields.maxOffsets = 1;
+    D.fields.collapseArrays = true;
+
+    B2.restart();
+    solveCalls(P, S, D, &B2);
+    if (!B2.getHit())
+      return S;
+
+    warnExceeded(B2, "by unification");
+  } else
+    warnExceeded(B, "by unification");
+
+  S.clear();
+  S.degrade(PointsToSets::DG_UNIFICATION);
+  D.kind = SK_STEENSGAARD;
+
+  return solveCalls(P, S, D, 0);
+}
+
+/* the rules as the solver gets them, see ConstraintFile */
+static void dumpConstraints(const ProgramStructure &P, const SolverOptions &O) {
+  detail::ConstraintFile F;
+
+  detail::compileConstraints(P, O.fields, F);
+  if (!F.write(O.dump))
+    errs() << "WARNING[PointsTo]: cannot write the rules to '" << O.dump <<
+      "'\n";
+  else if (!P.getIndirectCalls().empty())
+    errs() << "WARNING[PointsTo]: '" << O.dump << "' lacks the " <<
+      P.getIndirectCalls().size() << " calls to be resolved while solving\n";
+}
+
+static PointsToSets &solveAndPrune(const ProgramStructure &P,
+		PointsToSets &S, const SolverOptions &O) {
+  if (!O.reduce) {
+    if (!O.dump.empty())
+      dumpConstraints(P, O);
+    solveLimited(P, S, O);
+  } else {
+    ProgramStructure R(P);
+    detail::Substitution Sub;
+    detail::ReductionStats St;
+
+    detail::reduceConstraints(R, O.fields, Sub, St);
+    if (O.stats)
+      errs() << "PointsTo: " << St.rules << " rules reduced to " <<
+	St.rules - St.eliminated << " (" << St.duplicates << " duplicates), " <<
+	St.substituted << " of " << St.variables <<
+	" variables substituted\n";
+
+    if (!O.dump.empty())
+      dumpConstraints(R, O);
+    solveLimited(R, S, O);
+    detail::expandSubstitution(Sub, S);
+  }
+
+  pruneByType(S);
+  S.share();
+  if (O.stats)
+    errs() << "PointsTo: " << S.size() << " sets, " << S.getDistinct() <<
+      " distinct\n";
+
+  return S;
+}
+
+PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
+		const SolverOptions &O) {
+  if (O.cache.empty())
+    return solveAndPrune(P, S, O);
+
+  detail::SetsCache C(O.cache, P, O);
+  if (!C.load(S)) {
+    solveAndPrune(P, S, O);
+    /* a run with more time or memory would do better */
+    if (!S.getDegradation())
+      C.store(S);
+  }
+
+  return S;
 }
 
+bool PointsToAnalysis::runOnModule(Module &M) {
+  const SolverOptions O = getSolverOptions();
+
+  releaseMemory();
+  if (O.demand) {
+    PS = new DemandPointsToSets(M, O);
+    return false;
+  }
+  if (O.kind == SK_MAPPED && O.cache.empty() && O.dump.empty() &&
+      !O.partition && !O.timeLimit && !O.memLimit) {
+    PS = new MappedPointsToSets(M, O);
+    return false;
+  }
+  PS = new PointsToSets;
+
+  ProgramStructure P(M, O.onTheFly, O.threads);
+  computePointsToSets(P, *PS, O);
+
+  return false;
+}
+
+static RegisterPass<PointsToAnalysis> X("pointsto",
+		"Computes points-to sets of the module", false, true);
+char PointsToAnalysis::ID;
+
 const PTSet &
 getPointsToSet(const llvm::Value *const &memLoc, const PointsToSets &S,
 		const int idx) {
-  const PointsToSets::const_iterator it = S.find(Ptr(memLoc, idx));
-  if (it == S.end()) {
+  const PTSet *set = S.query(Ptr(memLoc, idx));
+  if (!set) {
     static const PTSet emptySet;
     errs() << "WARNING[PointsTo]: No points-to set has been found: ";
     memLoc->print(errs());
     errs() << '\n';
     return emptySet;
   }
-  return it->second;
+  return *set;
 }
 
-ProgramStructure::ProgramStructure(Module &M) : M(M) {
+/*
+ * The functions are walked in parallel, each into rules of its own. CallMaps
+ * is then filled from what was found, in the order of the module, and the
+ * rules of the returns and indirect calls are added, in parallel again. The
+ * rules are concatenated in the order of the module at last, so the result
+ * does not depend on the threads. So are the warnings, they are printed only
+ * then.
+ */
+ProgramStructure::ProgramStructure(Module &M, bool deferCalls,
+	unsigned threads) : M(M) {
+    detail::RuleWarnings W;
+
     for (Module::const_global_iterator g = M.global_begin(), E = M.global_end();
 	    g != E; ++g)
       if (isGlobalPointerInitialization(&*g))
-	detail::toRuleCode(&*g,std::back_inserter(this->getContainer()));
-
-    detail::CallMaps CM(M);
-
-    for (Module::const_iterator f = M.begin(); f != M.end(); ++f) {
-	for (const_inst_iterator i = inst_begin(f), E = inst_end(f);
-		i != E; ++i) {
-	    if (isPointerManipulation(&*i))
-		detail::toRuleCode(&*i,
-			    std::back_inserter(this->getContainer()));
-	    else if (const CallInst *c = dyn_cast<CallInst>(&*i)) {
-		if (!isInlineAssembly(c))
-		    CM.collectCallRuleCodes(c,
-			std::back_inserter(this->getContainer()));
-	    } else if (const ReturnInst *r = dyn_cast<ReturnInst>(&*i)) {
-		CM.collectReturnRuleCodes(r,
-			std::back_inserter(this->getContainer()));
-	    }
-	}
+	detail::toRuleCode(&*g,std::back_inserter(this->getContainer()), W);
+    detail::printRuleWarnings(W);
+
+    std::vector<const Function *> functions;
+    for (Module::const_iterator f = M.begin(); f != M.end(); ++f)
+	functions.push_back(&*f);
+
+    std::vector<detail::FunctionRules> FR(functions.size());
+    WorkerPool pool(threads);
+
+    pool.run(functions.size(), [&](std::size_t i) {
+	detail::collectFunctionRules(*functions[i], deferCalls, FR[i]);
+    });
+
+    detail::CallMaps CM(!deferCalls);
+
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+	if (!functions[i]->isDeclaration())
+	    CM.addFunction(functions[i]);
+	for (std::size_t j = 0; j < FR[i].calls.size(); ++j)
+	    CM.addCall(FR[i].calls[j]);
+	for (std::size_t j = 0; j < FR[i].stored.size(); ++j)
+	    CM.addStoredFunction(FR[i].stored[j]);
+    }
+    CM.finish();
+
+    std::vector<std::vector<RuleCode> > out(functions.size());
+
+    pool.run(functions.size(), [&](std::size_t i) {
+	detail::expandFunctionRules(CM, FR[i], out[i]);
+	std::vector<RuleCode>().swap(FR[i].rules);
+    });
+
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+	C.insert(C.end(), out[i].begin(), out[i].end());
+	indirect.insert(indirect.end(), FR[i].unresolved.begin(),
+		FR[i].unresolved.end());
+	detail::printRuleWarnings(FR[i].warnings);
     }
 #ifdef PS_DEBUG
     errs() << "==PS START\n";
@@ -4,12 +4,19 @@
 #ifndef POINTSTO_POINTSTO_H
 #define POINTSTO_POINTSTO_H
 
-#include <map>
+#include <cassert>
+#include <deque>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Pass.h"
 
+#include "HashConsPool.h"
+#include "LocationTable.h"
 #include "RuleExpressions.h"
 
 namespace llvm { namespace ptr {
@@ -33,29 +40,165 @@ namespace llvm { namespace ptr {
      */
     typedef std::pair<MemoryLocation, int> Pointee;
     typedef std::set<Pointee> PointsToSet;
+    typedef LocationTable::LocationId LocationId;
 
-    typedef std::map<Pointer, PointsToSet> Container;
-    typedef Container::key_type key_type;
-    typedef Container::mapped_type mapped_type;
+    /*
+     * A points-to set which is either owned or shared with other pointers.
+     * Once solved, equal sets are stored once (see share()) and the
+     * pointers refer to the same immutable copy. Writing through
+     * PointsToSets::operator[] makes a private copy again.
+     */
+    class SharedSet {
+    public:
+      typedef PointsToSet::const_iterator const_iterator;
+      typedef const_iterator iterator;
+
+      SharedSet() : shared(0) {}
+      SharedSet(const PointsToSet &S) : own(S), shared(0) {}
+
+      const PointsToSet &get() const { return shared ? *shared : own; }
+      operator const PointsToSet &() const { return get(); }
+      bool isShared() const { return shared; }
+
+      const_iterator begin() const { return get().begin(); }
+      const_iterator end() const { return get().end(); }
+      std::size_t size() const { return get().size(); }
+      bool empty() const { return get().empty(); }
+      std::size_t count(const Pointee &P) const { return get().count(P); }
+
+      /* shared sets of the same PointsToSets are equal iff they are one */
+      bool operator==(const SharedSet &o) const {
+	return (shared && shared == o.shared) || get() == o.get();
+      }
+      bool operator!=(const SharedSet &o) const { return !(*this == o); }
+
+      void swap(SharedSet &o) {
+	own.swap(o.own);
+	std::swap(shared, o.shared);
+      }
+
+    private:
+      friend class PointsToSets;
+
+      PointsToSet own;
+      const PointsToSet *shared;
+    };
+
+    /*
+     * The sets are kept in the order they were created, a deque so that the
+     * references survive adding more of them. They are found through the
+     * location ids (see LocationTable), no tree is walked.
+     */
+    typedef std::deque<std::pair<const Pointer, SharedSet> > Container;
+    typedef Pointer key_type;
+    typedef SharedSet mapped_type;
     typedef Container::value_type value_type;
     typedef Container::iterator iterator;
     typedef Container::const_iterator const_iterator;
     typedef std::pair<iterator, bool> insert_retval;
 
+    /*
+     * The cheaper ways the sets were solved in, once the solver ran out of
+     * SolverOptions::timeLimit or memLimit. A mask.
+     */
+    enum Degradation {
+      DG_NONE = 0,
+      DG_FIELDS = 1,		/* objects collapsed to a single field */
+      DG_UNIFICATION = 2,	/* solved by unification */
+    };
+
+    PointsToSets() : degradation(DG_NONE), partial(false) {}
     virtual ~PointsToSets() {}
 
-    insert_retval insert(value_type const& val) { return C.insert(val); }
-    PointsToSet& operator[](key_type const& key) { return C[key]; }
-    const_iterator find(key_type const& key) const { return C.find(key); }
-    iterator find(key_type const& key) { return C.find(key); }
-    const_iterator begin() const { return C.begin(); }
-    iterator begin() { return C.begin(); }
-    const_iterator end() const { return C.end(); }
-    iterator end() { return C.end(); }
+    insert_retval insert(value_type const& val);
+    /* the set is un-shared, it is going to be modified */
+    PointsToSet& operator[](key_type const& key) { return (*this)[L.getId(key)]; }
+    PointsToSet& operator[](LocationId id);
+    const_iterator find(key_type const& key) const;
+    iterator find(key_type const& key);
+    /*
+     * 0 if there is no set for @id. After share(), equal sets are returned
+     * as the same pointer, so the pointers can be compared instead.
+     */
+    const PointsToSet *lookup(LocationId id) const;
+    /*
+     * The set of @P, 0 if there is none. This is what getPointsToSet()
+     * asks, subclasses may compute the set only then.
+     */
+    virtual const PointsToSet *query(const Pointer &P) const;
+    const_iterator begin() const { assertWhole(); return C.begin(); }
+    iterator begin() { assertWhole(); return C.begin(); }
+    const_iterator end() const { assertWhole(); return C.end(); }
+    iterator end() { assertWhole(); return C.end(); }
+    std::size_t size() const { assertWhole(); return C.size(); }
+    /*
+     * Whether only query() knows the sets, the subclass computes them as
+     * they are asked for. find(), lookup(), begin(), end() and size() of
+     * such sets assert.
+     */
+    bool isPartial() const { return partial; }
     Container const& getContainer() const { return C; }
-    Container& getContainer() { return C; }
+
+    LocationTable &getLocations() { return L; }
+    const LocationTable &getLocations() const { return L; }
+
+    /* Makes all the sets shared, equal ones are stored only once. */
+    void share();
+    /* Shares the set of @id and returns the shared copy. */
+    const PointsToSet *share(LocationId id);
+    /* Returns the shared copy of @X, the contents of @X are taken. */
+    const PointsToSet *intern(PointsToSet &X) { return pool.take(X); }
+    /* Makes @id use @shared, which was returned by share() or intern(). */
+    void assign(LocationId id, const PointsToSet *shared);
+    /* the number of distinct shared sets */
+    std::size_t getDistinct() const { return pool.size(); }
+
+    /* Drops all the sets and their shared copies, the locations stay. */
+    void clear();
+    unsigned getDegradation() const { return degradation; }
+    void degrade(Degradation D) { degradation |= D; }
+
+    /* Drops the sets for which @P holds, the others keep their order. */
+    template<typename Predicate>
+    void remove_if(Predicate P) {
+      Container kept;
+
+      for (iterator I = C.begin(), E = C.end(); I != E; ++I) {
+	LocationId id = L.lookup(I->first);
+
+	if (P(*I)) {
+	  slots[id] = NONE;
+	  continue;
+	}
+	slots[id] = kept.size();
+	kept.push_back(value_type(I->first, SharedSet()));
+	kept.back().second.swap(I->second);
+      }
+      C.swap(kept);
+    }
+
+  protected:
+    void setPartial(bool P) { partial = P; }
+
   private:
+    static const unsigned NONE = ~0U;
+
+    LocationTable L;
     Container C;
+    /* location id -> index to C */
+    std::vector<unsigned> slots;
+    /* owns the shared sets, hence no copying */
+    HashConsPool<PointsToSet> pool;
+    unsigned degradation;
+    bool partial;
+
+    PointsToSets(const PointsToSets &);
+    void operator=(const PointsToSets &);
+
+    SharedSet &getSlot(LocationId id);
+    void assertWhole() const {
+      assert(!partial && "the sets are computed as queried, use query()");
+    }
   };
 
 }}
@@ -70,7 +213,21 @@ namespace llvm { namespace ptr {
         typedef Container::iterator iterator;
         typedef Container::const_iterator const_iterator;
 
-        explicit ProgramStructure(Module &M);
+        typedef std::vector<const CallInst *> CallsContainer;
+
+        /*
+         * With @deferCalls, the calls through pointers are not matched with
+         * the functions they may call. They are only listed in
+         * getIndirectCalls() and the solver adds their rules once a function
+         * shows up in the points-to set of the called pointer.
+         *
+         * The rules are generated on @threads threads, 0 means one per
+         * core. They come in the same order with any number of them.
+         */
+        explicit ProgramStructure(Module &M, bool deferCalls = false,
+		unsigned threads = 1);
+        /* just the rules @C of @M, no calls are deferred */
+        ProgramStructure(Module &M, const Container &C) : C(C), M(M) {}
 
         llvm::Module &getModule() const { return M; }
 
@@ -82,8 +239,10 @@ namespace llvm { namespace ptr {
         iterator end() { return C.end(); }
         Container const& getContainer() const { return C; }
         Container& getContainer() { return C; }
+        const CallsContainer &getIndirectCalls() const { return indirect; }
     private:
         Container C;
+        CallsContainer indirect;
         llvm::Module &M;
     };
 
@@ -91,11 +250,169 @@ namespace llvm { namespace ptr {
 
 namespace llvm { namespace ptr {
 
+  enum SolverKind {
+    SK_SWEEP,		/* re-apply every rule until nothing changes */
+    SK_WORKLIST,	/* propagate only the differences along the edges */
+    SK_WAVE,		/* the same in waves in topological order, parallel,
+			   see FieldOptions for where the two differ */
+    SK_STEENSGAARD,	/* unify instead of include, fast but imprecise */
+    SK_MAPPED,		/* sweep with the sets in files, for huge modules,
+			   see MappedPointsToSets */
+  };
+
+  /*
+   * How GEP offsets of pointees are tracked, see detail::FieldPolicy. The
+   * defaults keep recursive structures and objects indexed all over cheap,
+   * but both cutRecursion and maxOffsets depend on the order the pointees
+   * reach a GEP. The inclusion solvers go in different orders, so they may
+   * reach different fixpoints with these on: SK_WAVE need not get the sets
+   * of SK_WORKLIST (see Wave.cpp). With cutRecursion off and maxOffsets
+   * above what any object gets, they all get the same sets.
+   */
+  struct FieldOptions {
+    FieldOptions() : maxOffsets(3), arrayLimit(64), collapseArrays(false),
+      cutRecursion(true) {}
+
+    unsigned maxOffsets;	/* per object in one set, at least 1 */
+    unsigned arrayLimit;	/* offsets into arrays are clamped to this */
+    bool collapseArrays;	/* all the elements of an array are one */
+    bool cutRecursion;		/* a GEP does not move its own pointees */
+  };
+
+  struct SolverOptions {
+    SolverOptions() : kind(SK_WORKLIST), reduce(true), stats(false),
+      threads(0), demand(false), budget(1000000), onTheFly(false),
+      timeLimit(0), memLimit(0), mapDir("/tmp"), partition(0) {}
+
+    SolverKind kind;
+    bool reduce;	/* drop redundant rules and variables before solving */
+    bool stats;		/* report what the reduction eliminated */
+    unsigned threads;	/* for SK_WAVE, partition and the rules, 0 = per core */
+    std::string cache;	/* file with solved sets, none if empty */
+    bool demand;	/* solve only for the pointers asked about */
+    unsigned budget;	/* steps of one demand query before giving up */
+    bool onTheFly;	/* resolve indirect calls while solving, not demand */
+    FieldOptions fields;
+    unsigned timeLimit;	/* seconds of solving, 0 means no limit */
+    unsigned memLimit;	/* megabytes of heap, 0 means no limit */
+    std::string mapDir;	/* for the files of SK_MAPPED */
+    /* solve independent rules apart, in parts of this many, 0 means not */
+    unsigned partition;
+    std::string dump;	/* file to write the rules to, none if empty */
+  };
+
+  /*
+   * Options as requested by the environment:
+   *   SLICE_PTS_SOLVER=sweep|worklist|wave|steensgaard|mapped
+   *   SLICE_PTS_REDUCE=0 to disable the reduction
+   *   SLICE_PTS_STATS=1 to print the statistics
+   *   SLICE_PTS_THREADS=N to use N threads in the wave solver, for the
+   *     partitions and to generate the rules
+   *   SLICE_PTS_CACHE=file to load the sets from and store them to @file
+   *   SLICE_PTS_DEMAND=1 to solve on demand (see DemandPointsToSets)
+   *   SLICE_PTS_BUDGET=N to give up a demand query after N steps
+   *   SLICE_PTS_OTF=1 to resolve indirect calls while solving
+   *   SLICE_PTS_MAX_OFFSETS=N to collapse objects with more offsets in a set
+   *   SLICE_PTS_ARRAY_LIMIT=N to clamp the offsets into arrays to N
+   *   SLICE_PTS_COLLAPSE_ARRAYS=1 to ignore the array indices
+   *   SLICE_PTS_CUT_RECURSION=0 to move the pointees a GEP result has too
+   *   SLICE_PTS_TIME_LIMIT=N to solve in a cheaper way after N seconds
+   *   SLICE_PTS_MEM_LIMIT=N to solve in a cheaper way past N MB of heap
+   *   SLICE_PTS_MAP_DIR=dir for the files of the mapped solver ($TMPDIR)
+   *   SLICE_PTS_PARTITION=N to solve rules sharing no value apart, in
+   *     parallel, in parts of at least N rules (1000 or so)
+   *   SLICE_PTS_DUMP=file to write the rules to @file before solving them,
+   *     test/solve-points-to solves them from there
+   */
+  SolverOptions getSolverOptions();
+
   const PointsToSets::PointsToSet &
   getPointsToSet(const llvm::Value *const &memLoc, const PointsToSets &S,
 		  const int offset = -1);
 
   PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S);
+  PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S,
+		  const SolverOptions &O);
+
+  namespace detail { class DemandEngine; }
+
+  /*
+   * Points-to sets computed only when asked for through getPointsToSet().
+   * A query solves the constraints its pointer depends on: the copies and
+   * geps it comes from, the pointees of the loads, and for objects the
+   * stores which may write into them. This is usually a small part of the
+   * module. What is solved is kept for the following queries.
+   *
+   * A query which takes more than SolverOptions::budget steps is not worth
+   * it, the whole module is solved then and all the queries are answered
+   * from that.
+   *
+   * The container itself stays empty, isPartial() holds and only query()
+   * answers.
+   */
+  class DemandPointsToSets : public PointsToSets {
+  public:
+    DemandPointsToSets(Module &M, const SolverOptions &O);
+    virtual ~DemandPointsToSets();
+
+    virtual const PointsToSet *query(const Pointer &P) const;
+    /* whether the set of @P is solved, asked for or needed by a query */
+    bool isSolved(const Pointer &P) const;
+
+  private:
+    detail::DemandEngine *E;
+  };
+
+  namespace detail { class MappedEngine; }
+
+  /*
+   * Points-to sets solved by SK_MAPPED and left in the files of the solver.
+   * A query reads the set of its pointer from there and keeps it, so only
+   * the sets asked for are ever in RAM. The indirect calls are resolved in
+   * rounds as computePointsToSets() does, the reduction is undone as the
+   * queries come.
+   *
+   * The cache, the dump, the partitions and the limits all need the sets
+   * in memory, PointsToAnalysis solves by computePointsToSets() with them.
+   * If the files cannot be created, the sets are solved in memory too.
+   *
+   * The container itself stays empty, isPartial() holds and only query()
+   * answers. Not so when the sets were solved in memory.
+   */
+  class MappedPointsToSets : public PointsToSets {
+  public:
+    MappedPointsToSets(Module &M, const SolverOptions &O);
+    virtual ~MappedPointsToSets();
+
+    virtual const PointsToSet *query(const Pointer &P) const;
+
+  private:
+    detail::MappedEngine *E;
+  };
+
+  /*
+   * The points-to sets of the whole module as an analysis, so that the
+   * passes of one pipeline share them until a pass changes the module.
+   */
+  class PointsToAnalysis : public ModulePass {
+  public:
+    static char ID;
+
+    PointsToAnalysis() : ModulePass(ID), PS(0) {}
+    virtual ~PointsToAnalysis() { releaseMemory(); }
+
+    virtual bool runOnModule(Module &M);
+    virtual void releaseMemory() { delete PS; PS = 0; }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+    const PointsToSets &getPointsToSets() const { return *PS; }
+
+  private:
+    PointsToSets *PS;
+  };
 
 }}
 
@@ -0,0 +1,480 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Offline constraint reduction.
+ *
+ * ProgramStructure is full of redundancy: each PHI incoming value, each
+ * bitcast and each call/return pairing is a rule of its own and identical
+ * rules are never removed. Before any solver runs, identical rules are
+ * dropped here and variables which are bound to end up with the same
+ * points-to set are found by hash-based value numbering (HVN, Hardekopf and
+ * Lin, SAS'07). The rules are then rewritten so that each class of such
+ * variables is represented by a single variable. The others get a copy of
+ * its set once the rules are solved.
+ *
+ * Variables (<V, -1>) are labelled in topological order of the copy edges
+ * (x = y), a copy cycle is labelled as a whole. The incoming labels are:
+ *  - x = &a, x = alloc, x = null, x = gep &a: the label of the pointee,
+ *  - x = y: the label of y,
+ *  - x = *y, x = gep y: a fresh label. The former is not known before
+ *    solving, the latter is subject to the GEP heuristics, so it is not
+ *    a function of the set of y only.
+ * No incoming label means the empty set (label 0). A single incoming label
+ * is inherited, a set of them is hash-consed to a new label.
+ *
+ * The rules of the deferred indirect calls are not known yet, see
+ * Reducer::pinCalls().
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "FieldPolicy.h"
+#include "PointsTo.h"
+#include "RuleExpressions.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+typedef std::pair<unsigned, std::pair<const Value *, const Value *> > RuleKey;
+
+RuleKey getRuleKey(const RuleCode &RC) {
+  return RuleKey(RC.getType(), std::make_pair(RC.getLvalue(),
+	RC.getRvalue()));
+}
+
+/* Keeps the first occurrence of each rule, returns how many were dropped. */
+unsigned removeDuplicates(ProgramStructure::Container &C) {
+  DenseSet<RuleKey> seen;
+  ProgramStructure::Container::iterator out = C.begin();
+
+  for (ProgramStructure::Container::iterator I = C.begin(), E = C.end();
+      I != E; ++I)
+    if (seen.insert(getRuleKey(*I)).second)
+      *out++ = *I;
+
+  unsigned removed = C.end() - out;
+  C.erase(out, C.end());
+
+  return removed;
+}
+
+class Reducer {
+public:
+  Reducer(ProgramStructure &P, const FieldOptions &O) : C(P.getContainer()),
+    calls(P.getIndirectCalls()), M(P.getModule()), FP(M, O), nextLabel(1) {}
+
+  void run(Substitution &Sub, ReductionStats &St);
+
+private:
+  static const unsigned NONE = ~0U;
+
+  struct Var {
+    explicit Var(const Value *V) : V(V), label(0), scc(NONE), rep(NONE),
+      fresh(false), pinned(false) {}
+
+    const Value *V;
+    std::vector<unsigned> preds;	/* this = pred */
+    std::vector<unsigned> items;	/* labels of pointees */
+    unsigned label;
+    unsigned scc;
+    unsigned rep;
+    bool fresh;
+    bool pinned;		/* must keep its own rules */
+  };
+
+  ProgramStructure::Container &C;
+  const ProgramStructure::CallsContainer &calls;
+  const Module &M;
+  FieldPolicy FP;
+  std::vector<Var> vars;
+  DenseMap<const Value *, unsigned> ids;
+  DenseMap<PointsToSets::Pointee, unsigned> pointees;
+  std::map<std::vector<unsigned>, unsigned> sets;
+  unsigned nextLabel;
+
+  unsigned getVar(const Value *V);
+  unsigned getPointeeLabel(const Value *V, int64_t off);
+  void build();
+  void pinCalls();
+  void labelSCC(const std::vector<unsigned> &members, unsigned scc);
+  void label();
+  unsigned pickRepresentatives();
+  const Value *subst(const Value *V) const;
+  void rewrite();
+};
+
+const unsigned Reducer::NONE;
+
+unsigned Reducer::getVar(const Value *V) {
+  DenseMap<const Value *, unsigned>::const_iterator I = ids.find(V);
+
+  if (I != ids.end())
+    return I->second;
+
+  unsigned n = vars.size();
+  vars.push_back(Var(V));
+  ids[V] = n;
+
+  return n;
+}
+
+unsigned Reducer::getPointeeLabel(const Value *V, int64_t off) {
+  const PointsToSets::Pointee P(V, off);
+  DenseMap<PointsToSets::Pointee, unsigned>::const_iterator I =
+    pointees.find(P);
+
+  if (I != pointees.end())
+    return I->second;
+
+  return pointees[P] = nextLabel++;
+}
+
+void Reducer::build() {
+  for (ProgramStructure::const_iterator I = C.begin(), E = C.end(); I != E;
+      ++I) {
+    const Value *lval = I->getLvalue();
+    const Value *rval = I->getRvalue();
+
+    switch (I->getType()) {
+    case RCT_VAR_ASGN_ALLOC:
+    case RCT_VAR_ASGN_NULL:
+    case RCT_VAR_ASGN_REF_VAR: {
+      unsigned l = getVar(lval);
+      vars[l].items.push_back(getPointeeLabel(rval, 0));
+      break;
+    }
+    case RCT_VAR_ASGN_VAR: {
+      unsigned l = getVar(lval), r = getVar(rval);
+      vars[l].preds.push_back(r);
+      break;
+    }
+    case RCT_VAR_ASGN_GEP: {
+      const GetElementPtrInst *gep = cast<GetElementPtrInst>(rval);
+      const Value *op = elimConstExpr(gep->getPointerOperand());
+      unsigned l = getVar(lval);
+
+      if (hasExtraReference(op)) {
+	bool isArray = false;
+	int64_t off = FP.getOffset(gep, isArray);
+
+	vars[l].items.push_back(getPointeeLabel(op, off));
+	/* <op, -1> is a pointee then, stores through pointers write to it */
+	if (off == -1)
+	  vars[getVar(op)].fresh = true;
+      } else {
+	vars[l].fresh = true;
+	/* the rule refers to the operand through the instruction */
+	vars[getVar(op)].pinned = true;
+      }
+      break;
+    }
+    case RCT_VAR_ASGN_DREF_VAR:
+      vars[getVar(lval)].fresh = true;
+      getVar(rval);
+      break;
+    case RCT_DREF_VAR_ASGN_NULL:
+    case RCT_DREF_VAR_ASGN_REF_VAR:
+      getVar(lval);
+      break;
+    case RCT_DREF_VAR_ASGN_VAR:
+    case RCT_DREF_VAR_ASGN_DREF_VAR:
+      getVar(lval);
+      getVar(rval);
+      break;
+    case RCT_DEALLOC:
+      break;
+    default:
+      assert(0 && "Unknown rule code");
+    }
+  }
+}
+
+/*
+ * The solver adds the rules of the deferred calls by the names of their
+ * variables, so these must not be substituted. The variables they assign
+ * to, the calls and the parameters of the functions whose address is
+ * taken, have inputs unknown here, so they cannot share a label either.
+ */
+void Reducer::pinCalls() {
+  if (calls.empty())
+    return;
+
+  for (std::size_t i = 0; i < calls.size(); ++i) {
+    const CallInst *c = calls[i];
+
+    vars[getVar(getCalledPointer(c))].pinned = true;
+    if (isPointerValue(c)) {
+      unsigned n = getVar(c);
+      vars[n].fresh = vars[n].pinned = true;
+    }
+    for (unsigned j = 0; j < c->getNumArgOperands(); ++j) {
+      const Value *op = elimConstExpr(c->getArgOperand(j));
+      if (isPointerValue(op))
+	vars[getVar(op)].pinned = true;
+    }
+  }
+
+  for (Module::const_iterator f = M.begin(); f != M.end(); ++f) {
+    if (f->isDeclaration() || !f->hasAddressTaken())
+      continue;
+
+    for (Function::const_arg_iterator A = f->arg_begin(), E = f->arg_end();
+	A != E; ++A)
+      if (isPointerValue(&*A)) {
+	unsigned n = getVar(&*A);
+	vars[n].fresh = vars[n].pinned = true;
+      }
+
+    for (Function::const_iterator B = f->begin(), E = f->end(); B != E; ++B)
+      if (const ReturnInst *r = dyn_cast<ReturnInst>(B->getTerminator()))
+	if (r->getReturnValue() && isPointerValue(r->getReturnValue()))
+	  vars[getVar(r->getReturnValue())].pinned = true;
+  }
+}
+
+/*
+ * All the predecessors outside of the component are labelled already.
+ */
+void Reducer::labelSCC(const std::vector<unsigned> &members, unsigned scc) {
+  std::vector<unsigned> items;
+  bool fresh = false;
+
+  for (unsigned i = 0; i < members.size(); ++i)
+    vars[members[i]].scc = scc;
+
+  for (unsigned i = 0; i < members.size(); ++i) {
+    const Var &V = vars[members[i]];
+
+    fresh |= V.fresh;
+    items.insert(items.end(), V.items.begin(), V.items.end());
+    for (unsigned j = 0; j < V.preds.size(); ++j) {
+      const Var &P = vars[V.preds[j]];
+      if (P.scc != scc && P.label)
+	items.push_back(P.label);
+    }
+  }
+
+  std::sort(items.begin(), items.end());
+  items.erase(std::unique(items.begin(), items.end()), items.end());
+
+  unsigned label;
+  if (fresh)
+    label = nextLabel++;
+  else if (items.empty())
+    label = 0;
+  else if (items.size() == 1)
+    label = items.front();
+  else {
+    std::map<std::vector<unsigned>, unsigned>::iterator I =
+      sets.lower_bound(items);
+    if (I == sets.end() || I->first != items)
+      I = sets.insert(I, std::make_pair(items, nextLabel++));
+    label = I->second;
+  }
+
+  for (unsigned i = 0; i < members.size(); ++i)
+    vars[members[i]].label = label;
+}
+
+/*
+ * Iterative Tarjan over the edges to the predecessors. A component is
+ * finished only after all its predecessors are, so it can be labelled right
+ * away.
+ */
+void Reducer::label() {
+  typedef std::pair<unsigned, unsigned> Frame;
+  std::vector<unsigned> index(vars.size(), NONE), lowlink(vars.size());
+  std::vector<bool> onStack(vars.size());
+  std::vector<unsigned> stack, members;
+  std::vector<Frame> frames;
+  unsigned counter = 0, sccs = 0;
+
+  for (unsigned root = 0; root < vars.size(); ++root) {
+    if (index[root] != NONE)
+      continue;
+
+    index[root] = lowlink[root] = counter++;
+    stack.push_back(root);
+    onStack[root] = true;
+    frames.push_back(Frame(root, 0));
+
+    while (!frames.empty()) {
+      const unsigned n = frames.back().first;
+      const unsigned next = frames.back().second;
+
+      if (next < vars[n].preds.size()) {
+	unsigned m = vars[n].preds[next];
+
+	frames.back().second++;
+	if (index[m] == NONE) {
+	  index[m] = lowlink[m] = counter++;
+	  stack.push_back(m);
+	  onStack[m] = true;
+	  frames.push_back(Frame(m, 0));
+	} else if (onStack[m])
+	  lowlink[n] = std::min(lowlink[n], index[m]);
+	continue;
+      }
+
+      frames.pop_back();
+      if (!frames.empty()) {
+	unsigned parent = frames.back().first;
+	lowlink[parent] = std::min(lowlink[parent], lowlink[n]);
+      }
+
+      if (lowlink[n] != index[n])
+	continue;
+
+      members.clear();
+      while (true) {
+	unsigned m = stack.back();
+
+	stack.pop_back();
+	onStack[m] = false;
+	members.push_back(m);
+	if (m == n)
+	  break;
+      }
+      labelSCC(members, sccs++);
+    }
+  }
+}
+
+/*
+ * A pinned variable keeps its rules anyway, so it is preferred as the
+ * representative. Returns the number of substituted variables.
+ */
+unsigned Reducer::pickRepresentatives() {
+  DenseMap<unsigned, unsigned> reps;
+  unsigned substituted = 0;
+
+  for (unsigned n = 0; n < vars.size(); ++n)
+    if (vars[n].pinned && !reps.count(vars[n].label))
+      reps[vars[n].label] = n;
+
+  for (unsigned n = 0; n < vars.size(); ++n) {
+    Var &V = vars[n];
+    DenseMap<unsigned, unsigned>::const_iterator I = reps.find(V.label);
+
+    if (I == reps.end()) {
+      reps[V.label] = n;
+      continue;
+    }
+    if (V.pinned || I->second == n)
+      continue;
+
+    V.rep = I->second;
+    substituted++;
+  }
+
+  return substituted;
+}
+
+const Value *Reducer::subst(const Value *V) const {
+  DenseMap<const Value *, unsigned>::const_iterator I = ids.find(V);
+
+  if (I == ids.end() || vars[I->second].rep == NONE)
+    return V;
+
+  return vars[vars[I->second].rep].V;
+}
+
+void Reducer::rewrite() {
+  ProgramStructure::Container::iterator out = C.begin();
+
+  for (ProgramStructure::Container::iterator I = C.begin(), E = C.end();
+      I != E; ++I) {
+    const RuleCodeType type = I->getType();
+    const Value *lval = I->getLvalue();
+    const Value *rval = I->getRvalue();
+
+    switch (type) {
+    case RCT_VAR_ASGN_VAR:
+    case RCT_VAR_ASGN_DREF_VAR:
+      rval = subst(rval);
+      /* FALLTHROUGH */
+    case RCT_VAR_ASGN_ALLOC:
+    case RCT_VAR_ASGN_NULL:
+    case RCT_VAR_ASGN_GEP:
+    case RCT_VAR_ASGN_REF_VAR: {
+      /*
+       * The rules of a substituted variable are moved to the representative,
+       * they add nothing new to its set. Mostly they become duplicates or
+       * self-assignments.
+       */
+      lval = subst(lval);
+      if (type == RCT_VAR_ASGN_VAR && lval == rval)
+	continue;
+      break;
+    }
+    case RCT_DREF_VAR_ASGN_VAR:
+    case RCT_DREF_VAR_ASGN_DREF_VAR:
+      rval = subst(rval);
+      /* FALLTHROUGH */
+    case RCT_DREF_VAR_ASGN_NULL:
+    case RCT_DREF_VAR_ASGN_REF_VAR:
+      lval = subst(lval);
+      break;
+    default:
+      break;
+    }
+
+    if (lval == I->getLvalue() && rval == I->getRvalue())
+      *out++ = *I;
+    else
+      *out++ = makeRuleCode(type, lval, rval);
+  }
+
+  C.erase(out, C.end());
+}
+
+void Reducer::run(Substitution &Sub, ReductionStats &St) {
+  St.rules = C.size();
+  St.duplicates = removeDuplicates(C);
+
+  build();
+  pinCalls();
+  label();
+  St.variables = vars.size();
+  St.substituted = pickRepresentatives();
+  rewrite();
+  /* PHIs of equivalent values, for one */
+  removeDuplicates(C);
+  St.eliminated = St.rules - C.size();
+
+  for (unsigned n = 0; n < vars.size(); ++n)
+    if (vars[n].rep != NONE)
+      Sub.push_back(std::make_pair(vars[n].V, vars[vars[n].rep].V));
+}
+
+}
+
+void reduceConstraints(ProgramStructure &P, const FieldOptions &O,
+    Substitution &Sub, ReductionStats &St) {
+  Reducer R(P, O);
+
+  R.run(Sub, St);
+}
+
+void expandSubstitution(const Substitution &Sub, PointsToSets &S) {
+  for (Substitution::const_iterator I = Sub.begin(), E = Sub.end(); I != E;
+      ++I) {
+    LocationTable &L = S.getLocations();
+
+    S.assign(L.getId(I->first, -1), S.share(L.getId(I->second, -1)));
+  }
+}
+
+}}}
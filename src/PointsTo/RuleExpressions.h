@@ -4,6 +4,9 @@
 #ifndef POINTSTO_RULEEXPRESSIONS_H
 #define POINTSTO_RULEEXPRESSIONS_H
 
+#include <utility>
+#include <vector>
+
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -299,8 +302,21 @@ namespace llvm { namespace ptr {
 
 namespace llvm { namespace ptr { namespace detail {
 
+  /*
+   * What makes the rules unsound. The rules of the functions are collected
+   * from several threads, so this is only recorded and printed later by
+   * printRuleWarnings(), in the order of the module.
+   */
+  struct RuleWarnings {
+    std::vector<const IntToPtrInst *> intToPtr;
+    /* calls passing more arguments than the callee has parameters */
+    std::vector<std::pair<const CallInst *, const Function *> > varargs;
+  };
+
+  void printRuleWarnings(const RuleWarnings &W);
+
   template<typename OutIterator>
-  void toRuleCode(const Value *V, OutIterator out) {
+  void toRuleCode(const Value *V, OutIterator out, RuleWarnings &W) {
     if (const llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(V)) {
       if (const llvm::LoadInst *LI = llvm::dyn_cast<llvm::LoadInst>(I)) {
 	const llvm::Value *op = elimConstExpr(LI->getPointerOperand());
@@ -397,15 +413,7 @@ namespace llvm { namespace ptr { namespace detail {
 	}
       } else if (const llvm::IntToPtrInst *ITPI =
 		 llvm::dyn_cast<llvm::IntToPtrInst>(I)) {
-	errs() << __func__ << ": WARNING[PointsTo]: Integer ";
-
-	if (const llvm::ConstantInt *C =
-	    llvm::dyn_cast<llvm::ConstantInt>(ITPI->getOperand(0)))
-	  errs() << "(" << C->getValue() << ") ";
-
-	errs() << "converted to a pointer in '" <<
-	    I->getParent()->getParent()->getName() <<
-	    "' => getting unsound analysis!\n";
+	W.intToPtr.push_back(ITPI);
       } else if (const llvm::SelectInst *SEL =
 		 llvm::dyn_cast<llvm::SelectInst>(I)) {
 	  const llvm::Value *r1 = elimConstExpr(SEL->getTrueValue());
@@ -433,6 +441,41 @@ namespace llvm { namespace ptr { namespace detail {
     }
   }
 
+  /*
+   * Builds a rule of the given type back from its operands, e.g. when
+   * the operands were rewritten.
+   */
+  inline RuleCode makeRuleCode(RuleCodeType type, const Value *l,
+      const Value *r) {
+    switch (type) {
+    case RCT_VAR_ASGN_ALLOC:
+      return ruleCode(ruleVar(l) = ruleAllocSite(r));
+    case RCT_VAR_ASGN_NULL:
+      return ruleCode(ruleVar(l) = ruleNull(r));
+    case RCT_VAR_ASGN_VAR:
+      return ruleCode(ruleVar(l) = ruleVar(r));
+    case RCT_VAR_ASGN_GEP:
+      return ruleCode(ruleVar(l) = ruleVar(r).gep());
+    case RCT_VAR_ASGN_REF_VAR:
+      return ruleCode(ruleVar(l) = &ruleVar(r));
+    case RCT_VAR_ASGN_DREF_VAR:
+      return ruleCode(ruleVar(l) = *ruleVar(r));
+    case RCT_DREF_VAR_ASGN_NULL:
+      return ruleCode(*ruleVar(l) = ruleNull(r));
+    case RCT_DREF_VAR_ASGN_VAR:
+      return ruleCode(*ruleVar(l) = ruleVar(r));
+    case RCT_DREF_VAR_ASGN_REF_VAR:
+      return ruleCode(*ruleVar(l) = &ruleVar(r));
+    case RCT_DREF_VAR_ASGN_DREF_VAR:
+      return ruleCode(*ruleVar(l) = *ruleVar(r));
+    case RCT_DEALLOC:
+      return ruleCode(ruleDeallocSite(l));
+    default:
+      assert(0 && "Unknown rule code");
+      return RuleCode();
+    }
+  }
+
 }}}
 
 #endif
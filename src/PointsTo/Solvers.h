@@ -0,0 +1,93 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_SOLVERS_H
+#define POINTSTO_SOLVERS_H
+
+#include <string>
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+
+#include "PointsTo.h"
+
+/*
+ * Internal interface shared by the points-to solver engines. Users should
+ * stick to computePointsToSets() from PointsTo.h.
+ */
+namespace llvm { namespace ptr { namespace detail {
+
+  /* false if @V has no size to check the offsets against */
+  bool getObjectSize(const DataLayout &DL, const Value *V, uint64_t &size);
+
+  /* the pointer an indirect call goes through, see getCalledFunctions() */
+  const Value *getCalledPointer(const CallInst *c);
+  /*
+   * Appends the rules of @c calling @f to @out: the arguments passed to the
+   * parameters of @f and its returns to @c. For the calls resolved while
+   * solving (SolverOptions::onTheFly).
+   */
+  void collectResolvedCall(const CallInst *c, const Function *f,
+		  std::vector<RuleCode> &out);
+
+  class Budget;
+
+  /*
+   * With @B, the solver stops once the budget is exceeded and leaves the
+   * sets incomplete. Unification is cheap enough to be run without one.
+   */
+  PointsToSets &solveSweep(const ProgramStructure &P, PointsToSets &S,
+		  const FieldOptions &O, Budget *B = 0);
+  PointsToSets &solveWorklist(const ProgramStructure &P, PointsToSets &S,
+		  const FieldOptions &O, Budget *B = 0);
+  /* @threads == 0 means one per core */
+  PointsToSets &solveWave(const ProgramStructure &P, PointsToSets &S,
+		  unsigned threads, const FieldOptions &O, Budget *B = 0);
+  /* the sets live in temporary files in @dir */
+  PointsToSets &solveOutOfCore(const ProgramStructure &P, PointsToSets &S,
+		  const FieldOptions &O, const std::string &dir, Budget *B = 0);
+  PointsToSets &solveSteensgaard(const ProgramStructure &P, PointsToSets &S,
+		  const FieldOptions &O);
+  /*
+   * Solves @P by O.kind within @B. Once @B is exceeded, the sets are solved
+   * again in cheaper ways, the first of them within @B2.
+   */
+  PointsToSets &solveDegrading(const ProgramStructure &P, PointsToSets &S,
+		  const SolverOptions &O, Budget &B, Budget &B2);
+
+  /*
+   * Splits the rules of @P into parts which share no value, directly or
+   * through others, so that they can be solved apart. Components of less
+   * than @minRules rules are packed together. The biggest parts go first.
+   */
+  void partitionConstraints(const ProgramStructure &P,
+		  std::vector<ProgramStructure::Container> &parts,
+		  std::size_t minRules);
+
+  /* <variable, its representative> */
+  typedef std::vector<std::pair<const Value *, const Value *> > Substitution;
+
+  struct ReductionStats {
+    ReductionStats() : rules(0), duplicates(0), eliminated(0), variables(0),
+      substituted(0) {}
+
+    unsigned rules;		/* rules on input */
+    unsigned duplicates;	/* identical rules dropped */
+    unsigned eliminated;	/* all the rules dropped */
+    unsigned variables;
+    unsigned substituted;	/* variables replaced by a representative */
+  };
+
+  /*
+   * Removes duplicate rules and substitutes pointer-equivalent variables in
+   * P. Once P is solved, expandSubstitution() fills in the sets of the
+   * substituted variables. The GEP offsets are those of @O, as the solvers
+   * see them.
+   */
+  void reduceConstraints(ProgramStructure &P, const FieldOptions &O,
+		  Substitution &Sub, ReductionStats &St);
+  void expandSubstitution(const Substitution &Sub, PointsToSets &S);
+
+}}}
+
+#endif
@@ -0,0 +1,387 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_SPARSEBITMAP_H
+#define POINTSTO_SPARSEBITMAP_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "llvm/Support/DataTypes.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace llvm { namespace ptr {
+
+  /*
+   * A set of small unsigned integers (interned location ids) as a sparse
+   * bitmap. Most points-to sets have a few elements only, those live inline
+   * in a sorted array. Once the set grows over SMALL elements, it switches
+   * to a sorted vector of 128-bit blocks which are united and subtracted
+   * word-parallel (with SSE2 where available).
+   *
+   * The interface follows std::set where it makes sense. Elements cannot be
+   * removed one by one, only by intersectWith(), assignDifference() and
+   * clear().
+   */
+  class SparseBitmap {
+  public:
+    typedef unsigned value_type;
+
+  private:
+    enum { SMALL = 4, BLOCK_BITS = 128 };
+
+    struct Block {
+      explicit Block(unsigned index) : index(index) {
+	bits[0] = bits[1] = 0;
+      }
+
+      unsigned index;
+      uint64_t bits[2];
+    };
+
+    typedef std::vector<Block> Blocks;
+
+  public:
+    class const_iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef unsigned value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const unsigned *pointer;
+      typedef const unsigned &reference;
+
+      const_iterator() : S(0), i(0), word(0), rest(0) {}
+
+      unsigned operator*() const {
+	if (S->small)
+	  return S->smallSet[i];
+	return S->blocks[i].index * BLOCK_BITS + word * 64 +
+	  __builtin_ctzll(rest);
+      }
+
+      const_iterator &operator++() {
+	if (S->small)
+	  i++;
+	else {
+	  rest &= rest - 1;
+	  settle();
+	}
+	return *this;
+      }
+
+      const_iterator operator++(int) {
+	const_iterator old(*this);
+	++*this;
+	return old;
+      }
+
+      bool operator==(const const_iterator &o) const {
+	return i == o.i && word == o.word && rest == o.rest;
+      }
+      bool operator!=(const const_iterator &o) const { return !(*this == o); }
+
+    private:
+      friend class SparseBitmap;
+
+      /* i is the element index of a small set, the block index otherwise */
+      const_iterator(const SparseBitmap *S, unsigned i) : S(S), i(i), word(0),
+	  rest(0) {
+	if (!S->small && i < S->blocks.size()) {
+	  rest = S->blocks[i].bits[0];
+	  settle();
+	}
+      }
+
+      /* moves to the next set bit, if the current word is exhausted */
+      void settle() {
+	while (!rest) {
+	  if (++word == 2) {
+	    word = 0;
+	    if (++i == S->blocks.size())
+	      return;
+	  }
+	  rest = S->blocks[i].bits[word];
+	}
+      }
+
+      const SparseBitmap *S;
+      unsigned i;
+      unsigned word;
+      uint64_t rest;
+    };
+
+    typedef const_iterator iterator;
+
+    SparseBitmap() : elements(0), small(true) {}
+
+    bool empty() const { return !elements; }
+    std::size_t size() const { return elements; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const {
+      return const_iterator(this, small ? elements : blocks.size());
+    }
+
+    std::size_t count(unsigned x) const {
+      if (small)
+	return std::binary_search(smallSet, smallSet + elements, x);
+
+      Blocks::const_iterator I = findBlock(x / BLOCK_BITS);
+      if (I == blocks.end() || I->index != x / BLOCK_BITS)
+	return 0;
+      return (I->bits[x / 64 % 2] >> x % 64) & 1;
+    }
+
+    /* returns true if @x was not there yet */
+    bool insert(unsigned x) {
+      if (small) {
+	unsigned *pos = std::lower_bound(smallSet, smallSet + elements, x);
+
+	if (pos != smallSet + elements && *pos == x)
+	  return false;
+	if (elements < SMALL) {
+	  std::copy_backward(pos, smallSet + elements,
+	      smallSet + elements + 1);
+	  *pos = x;
+	  elements++;
+	  return true;
+	}
+	toBlocks();
+      }
+
+      Blocks::iterator I = findBlock(x / BLOCK_BITS);
+      if (I == blocks.end() || I->index != x / BLOCK_BITS)
+	I = blocks.insert(I, Block(x / BLOCK_BITS));
+
+      uint64_t &w = I->bits[x / 64 % 2];
+      const uint64_t bit = uint64_t(1) << x % 64;
+      if (w & bit)
+	return false;
+      w |= bit;
+      elements++;
+      return true;
+    }
+
+    /* this |= o, returns true if anything was added */
+    bool unionWith(const SparseBitmap &o) {
+      if (o.small) {
+	bool changed = false;
+	for (unsigned i = 0; i < o.elements; ++i)
+	  changed |= insert(o.smallSet[i]);
+	return changed;
+      }
+      if (small)
+	toBlocks();
+      return unionBlocks(o.blocks);
+    }
+
+    /* this &= o */
+    void intersectWith(const SparseBitmap &o) {
+      SparseBitmap result;
+
+      for (const_iterator I = begin(), E = end(); I != E; ++I)
+	if (o.count(*I))
+	  result.insert(*I);
+      swap(result);
+    }
+
+    /* this = a - b */
+    void assignDifference(const SparseBitmap &a, const SparseBitmap &b) {
+      SparseBitmap result;
+
+      if (a.small || b.small) {
+	for (const_iterator I = a.begin(), E = a.end(); I != E; ++I)
+	  if (!b.count(*I))
+	    result.insert(*I);
+      } else
+	result.differenceBlocks(a.blocks, b.blocks);
+      swap(result);
+    }
+
+    bool operator==(const SparseBitmap &o) const {
+      if (elements != o.elements)
+	return false;
+      if (small != o.small)
+	return std::equal(begin(), end(), o.begin());
+      if (small)
+	return std::equal(smallSet, smallSet + elements, o.smallSet);
+      if (blocks.size() != o.blocks.size())
+	return false;
+      for (std::size_t i = 0; i < blocks.size(); ++i)
+	if (blocks[i].index != o.blocks[i].index ||
+	    blocks[i].bits[0] != o.blocks[i].bits[0] ||
+	    blocks[i].bits[1] != o.blocks[i].bits[1])
+	  return false;
+      return true;
+    }
+    bool operator!=(const SparseBitmap &o) const { return !(*this == o); }
+
+    void swap(SparseBitmap &o) {
+      std::swap(elements, o.elements);
+      std::swap(small, o.small);
+      for (unsigned i = 0; i < SMALL; ++i)
+	std::swap(smallSet[i], o.smallSet[i]);
+      blocks.swap(o.blocks);
+    }
+
+    /* frees the memory too */
+    void clear() {
+      SparseBitmap().swap(*this);
+    }
+
+  private:
+    unsigned elements;
+    bool small;
+    unsigned smallSet[SMALL];
+    Blocks blocks;
+
+    struct BlockLess {
+      bool operator()(const Block &B, unsigned index) const {
+	return B.index < index;
+      }
+    };
+
+    Blocks::iterator findBlock(unsigned index) {
+      return std::lower_bound(blocks.begin(), blocks.end(), index,
+	  BlockLess());
+    }
+    Blocks::const_iterator findBlock(unsigned index) const {
+      return std::lower_bound(blocks.begin(), blocks.end(), index,
+	  BlockLess());
+    }
+
+    void toBlocks() {
+      assert(small);
+      small = false;
+      for (unsigned i = 0; i < elements; ++i) {
+	const unsigned x = smallSet[i];
+	if (blocks.empty() || blocks.back().index != x / BLOCK_BITS)
+	  blocks.push_back(Block(x / BLOCK_BITS));
+	blocks.back().bits[x / 64 % 2] |= uint64_t(1) << x % 64;
+      }
+    }
+
+    static unsigned popcount(const Block &B) {
+      return __builtin_popcountll(B.bits[0]) + __builtin_popcountll(B.bits[1]);
+    }
+
+    /* dst |= src, returns the number of bits added */
+    static unsigned orBlock(Block &dst, const Block &src) {
+#ifdef __SSE2__
+      __m128i d = _mm_loadu_si128((const __m128i *)dst.bits);
+      __m128i s = _mm_loadu_si128((const __m128i *)src.bits);
+      __m128i added = _mm_andnot_si128(d, s);
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(added, _mm_setzero_si128())) ==
+	  0xffff)
+	return 0;
+      _mm_storeu_si128((__m128i *)dst.bits, _mm_or_si128(d, s));
+
+      uint64_t a[2];
+      _mm_storeu_si128((__m128i *)a, added);
+      return __builtin_popcountll(a[0]) + __builtin_popcountll(a[1]);
+#else
+      const uint64_t a0 = src.bits[0] & ~dst.bits[0];
+      const uint64_t a1 = src.bits[1] & ~dst.bits[1];
+
+      dst.bits[0] |= a0;
+      dst.bits[1] |= a1;
+      return __builtin_popcountll(a0) + __builtin_popcountll(a1);
+#endif
+    }
+
+    /* dst = a & ~b, returns false if nothing is left */
+    static bool andNotBlock(Block &dst, const Block &a, const Block &b) {
+#ifdef __SSE2__
+      __m128i x = _mm_andnot_si128(
+	  _mm_loadu_si128((const __m128i *)b.bits),
+	  _mm_loadu_si128((const __m128i *)a.bits));
+
+      _mm_storeu_si128((__m128i *)dst.bits, x);
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) !=
+	0xffff;
+#else
+      dst.bits[0] = a.bits[0] & ~b.bits[0];
+      dst.bits[1] = a.bits[1] & ~b.bits[1];
+      return dst.bits[0] || dst.bits[1];
+#endif
+    }
+
+    bool unionBlocks(const Blocks &src) {
+      unsigned added = 0;
+      std::size_t missing = 0;
+
+      /* in place as long as there are no new blocks, the common case */
+      for (Blocks::const_iterator I = src.begin(), E = src.end(); I != E;
+	  ++I) {
+	Blocks::iterator D = findBlock(I->index);
+	if (D == blocks.end() || D->index != I->index)
+	  missing++;
+      }
+
+      if (!missing) {
+	Blocks::iterator D = blocks.begin();
+	for (Blocks::const_iterator I = src.begin(), E = src.end(); I != E;
+	    ++I) {
+	  while (D->index != I->index)
+	    ++D;
+	  added += orBlock(*D, *I);
+	}
+	elements += added;
+	return added;
+      }
+
+      Blocks result;
+      result.reserve(blocks.size() + missing);
+
+      Blocks::const_iterator A = blocks.begin(), AE = blocks.end();
+      Blocks::const_iterator B = src.begin(), BE = src.end();
+      while (A != AE || B != BE) {
+	if (B == BE || (A != AE && A->index < B->index)) {
+	  result.push_back(*A++);
+	} else if (A == AE || B->index < A->index) {
+	  result.push_back(*B);
+	  added += popcount(*B++);
+	} else {
+	  result.push_back(*A++);
+	  added += orBlock(result.back(), *B++);
+	}
+      }
+
+      blocks.swap(result);
+      elements += added;
+      return added;
+    }
+
+    void differenceBlocks(const Blocks &a, const Blocks &b) {
+      Blocks::const_iterator B = b.begin(), BE = b.end();
+
+      small = false;
+      for (Blocks::const_iterator A = a.begin(), AE = a.end(); A != AE;
+	  ++A) {
+	while (B != BE && B->index < A->index)
+	  ++B;
+	if (B == BE || B->index != A->index) {
+	  blocks.push_back(*A);
+	  elements += popcount(*A);
+	  continue;
+	}
+
+	Block D(A->index);
+	if (andNotBlock(D, *A, *B)) {
+	  blocks.push_back(D);
+	  elements += popcount(D);
+	}
+      }
+    }
+  };
+
+}}
+
+#endif
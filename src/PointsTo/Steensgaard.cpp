@@ -0,0 +1,520 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Unification based points-to analysis (Steensgaard).
+ *
+ * Locations are grouped into classes and each class points to at most one
+ * other class. An assignment does not add a subset constraint, it unifies
+ * the pointee classes of both sides instead, so each rule is looked at once
+ * and the whole thing runs in almost linear time. The points-to set of a
+ * location is then the class its class points to.
+ *
+ * This is much less precise than the inclusion based solvers and meant for
+ * modules too big for them. Field offsets are kept: a gep with a non-zero
+ * offset moves each pointee by the offset, with the same FieldPolicy as the
+ * other solvers. Only these are not linear, they are re-applied until
+ * nothing new comes in. The fields of an object the policy collapses join
+ * the class of <object, 0>.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "FieldPolicy.h"
+#include "PointsTo.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+typedef LocationTable::LocationId NodeId;
+
+class UnificationSolver {
+public:
+  UnificationSolver(const ProgramStructure &P, LocationTable &L,
+      const FieldOptions &O) : F(P.getModule(), O), L(&L), CF(0) {}
+  /* for compiled rules, the nodes are the locations of @CF */
+  UnificationSolver(ConstraintFile &CF, const FieldOptions &O) : F(O), L(0),
+    CF(&CF) {}
+
+  void solve(const ProgramStructure &P);
+  void solve();
+  void fill(PointsToSets &S);
+  /* the same by location of @CF, sorted, as solveConstraintFile() */
+  void fill(std::vector<std::vector<uint32_t> > &sets);
+
+private:
+  typedef unsigned ClassId;
+  static const ClassId NONE = ~0U;
+
+  struct Class {
+    explicit Class(ClassId self) : parent(self), pointee(NONE) {}
+
+    ClassId parent;
+    ClassId pointee;
+    std::vector<NodeId> members;
+  };
+
+  /* x = gep y, handled after the rest */
+  struct Gep {
+    Gep(NodeId x, NodeId y, int64_t off, bool isArray) : x(x), y(y),
+      off(off), isArray(isArray) {}
+
+    NodeId x, y;
+    int64_t off;
+    bool isArray;
+    /* members of the pointee class of y done already */
+    DenseSet<NodeId> done;
+  };
+
+  FieldPolicy F;
+  /* exactly one of them is set */
+  LocationTable *L;
+  ConstraintFile *CF;
+  std::vector<Class> classes;
+  /* location -> its class, NONE until it is needed */
+  std::vector<ClassId> classOf;
+  /* the sweep solver would create an entry */
+  std::vector<bool> key;
+  /* pointers loaded or stored through, their pointees get entries */
+  std::vector<NodeId> derefs;
+  std::vector<Gep> geps;
+  std::vector<unsigned> objects;
+  std::vector<std::pair<NodeId, NodeId> > fields;
+
+  NodeId grow(NodeId n);
+  NodeId getNode(const Value *V, int off);
+  NodeId getKey(const Value *V, int off = -1);
+  ClassId newClass();
+  ClassId find(ClassId c);
+  ClassId get(NodeId n);
+  ClassId deref(ClassId c);
+  ClassId join(ClassId a, ClassId b);
+  void addRule(const RuleCode &RC);
+  void addRules(const ConstraintFile::Rules &R,
+      ConstraintFile::RuleKind kind);
+  bool joinFields();
+  void applyGeps();
+  void markDerefs();
+  bool applyGep(unsigned i);
+};
+
+const UnificationSolver::ClassId UnificationSolver::NONE;
+
+NodeId UnificationSolver::grow(NodeId n) {
+  if (classOf.size() <= n) {
+    classOf.resize(n + 1, NONE);
+    key.resize(n + 1);
+  }
+
+  return n;
+}
+
+NodeId UnificationSolver::getNode(const Value *V, int off) {
+  return grow(L->getId(V, off));
+}
+
+NodeId UnificationSolver::getKey(const Value *V, int off) {
+  const NodeId n = getNode(V, off);
+
+  key[n] = true;
+
+  return n;
+}
+
+UnificationSolver::ClassId UnificationSolver::newClass() {
+  classes.push_back(Class(classes.size()));
+
+  return classes.size() - 1;
+}
+
+UnificationSolver::ClassId UnificationSolver::find(ClassId c) {
+  ClassId r = c;
+
+  while (classes[r].parent != r)
+    r = classes[r].parent;
+
+  while (classes[c].parent != r) {
+    ClassId next = classes[c].parent;
+    classes[c].parent = r;
+    c = next;
+  }
+
+  return r;
+}
+
+UnificationSolver::ClassId UnificationSolver::get(NodeId n) {
+  if (classOf[n] == NONE) {
+    classOf[n] = newClass();
+    classes[classOf[n]].members.push_back(n);
+  }
+
+  return find(classOf[n]);
+}
+
+/* the class @c points to, a new empty one if none yet */
+UnificationSolver::ClassId UnificationSolver::deref(ClassId c) {
+  c = find(c);
+
+  if (classes[c].pointee == NONE) {
+    const ClassId p = newClass();
+    classes[c].pointee = p;
+  }
+
+  return find(classes[c].pointee);
+}
+
+/*
+ * Unifying two classes unifies their pointees too. Done with an explicit
+ * stack as pointer chains may be long.
+ */
+UnificationSolver::ClassId UnificationSolver::join(ClassId a, ClassId b) {
+  std::vector<std::pair<ClassId, ClassId> > todo;
+  const ClassId result = a;
+
+  todo.push_back(std::make_pair(a, b));
+  while (!todo.empty()) {
+    a = find(todo.back().first);
+    b = find(todo.back().second);
+    todo.pop_back();
+
+    if (a == b)
+      continue;
+
+    /* the bigger one stays */
+    if (classes[a].members.size() < classes[b].members.size())
+      std::swap(a, b);
+
+    Class &A = classes[a], &B = classes[b];
+
+    B.parent = a;
+    A.members.insert(A.members.end(), B.members.begin(), B.members.end());
+    std::vector<NodeId>().swap(B.members);
+
+    if (A.pointee == NONE)
+      A.pointee = B.pointee;
+    else if (B.pointee != NONE)
+      todo.push_back(std::make_pair(A.pointee, B.pointee));
+  }
+
+  return find(result);
+}
+
+/* The same translation as in ConstraintGraph::addRule(). */
+void UnificationSolver::addRule(const RuleCode &RC) {
+  const Value *lval = RC.getLvalue();
+  const Value *rval = RC.getRvalue();
+
+  switch (RC.getType()) {
+  case RCT_VAR_ASGN_ALLOC:
+  case RCT_VAR_ASGN_NULL:
+  case RCT_VAR_ASGN_REF_VAR: {
+    const NodeId l = getKey(lval), r = getNode(rval, 0);
+    join(deref(get(l)), get(r));
+    break;
+  }
+  case RCT_VAR_ASGN_VAR: {
+    const NodeId l = getKey(lval), r = getKey(rval);
+    join(deref(get(l)), deref(get(r)));
+    break;
+  }
+  case RCT_VAR_ASGN_GEP: {
+    const GetElementPtrInst *gep = cast<GetElementPtrInst>(rval);
+    const Value *op = elimConstExpr(gep->getPointerOperand());
+    bool isArray = false;
+    int64_t off = F.getOffset(gep, isArray);
+    const NodeId l = getKey(lval);
+
+    if (L->getInfo(op).extraRef)
+      join(deref(get(l)), get(getNode(op, off)));
+    else if (!off)
+      join(deref(get(l)), deref(get(getKey(op))));
+    else
+      geps.push_back(Gep(l, getKey(op), off, isArray));
+    break;
+  }
+  case RCT_VAR_ASGN_DREF_VAR: {
+    const NodeId l = getKey(lval), r = getKey(rval);
+    join(deref(get(l)), deref(deref(get(r))));
+    derefs.push_back(r);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_NULL:
+  case RCT_DREF_VAR_ASGN_REF_VAR: {
+    const NodeId l = getKey(lval), r = getNode(rval, 0);
+    join(deref(deref(get(l))), get(r));
+    derefs.push_back(l);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_VAR: {
+    const NodeId l = getKey(lval), r = getKey(rval);
+    join(deref(deref(get(l))), deref(get(r)));
+    derefs.push_back(l);
+    break;
+  }
+  case RCT_DREF_VAR_ASGN_DREF_VAR: {
+    const NodeId l = getKey(lval), r = getKey(rval);
+    join(deref(deref(get(l))), deref(deref(get(r))));
+    derefs.push_back(l);
+    derefs.push_back(r);
+    break;
+  }
+  case RCT_DEALLOC:
+    break;
+  default:
+    assert(0 && "Unknown rule code");
+  }
+}
+
+/* The same for compiled rules, see ConstraintGraph::addRules(). */
+void UnificationSolver::addRules(const ConstraintFile::Rules &R,
+    ConstraintFile::RuleKind kind) {
+  for (std::size_t i = 0; i < R.size(); ++i) {
+    const NodeId l = R.lval[i], r = R.rval[i];
+
+    key[l] = true;
+    if (kind != ConstraintFile::R_ADDR && kind != ConstraintFile::R_STORE_ADDR)
+      key[r] = true;
+
+    switch (kind) {
+    case ConstraintFile::R_ADDR:
+      join(deref(get(l)), get(r));
+      break;
+    case ConstraintFile::R_COPY:
+      join(deref(get(l)), deref(get(r)));
+      break;
+    case ConstraintFile::R_GEP:
+      if (!R.off[i])
+	join(deref(get(l)), deref(get(r)));
+      else
+	geps.push_back(Gep(l, r, R.off[i], R.isArray[i]));
+      break;
+    case ConstraintFile::R_LOAD:
+      join(deref(get(l)), deref(deref(get(r))));
+      derefs.push_back(r);
+      break;
+    case ConstraintFile::R_STORE_ADDR:
+      join(deref(deref(get(l))), get(r));
+      derefs.push_back(l);
+      break;
+    case ConstraintFile::R_STORE:
+      join(deref(deref(get(l))), deref(get(r)));
+      derefs.push_back(l);
+      break;
+    case ConstraintFile::R_STORE_LOAD:
+      join(deref(deref(get(l))), deref(deref(get(r))));
+      derefs.push_back(l);
+      derefs.push_back(r);
+      break;
+    default:
+      assert(0 && "Unknown rule kind");
+    }
+  }
+}
+
+/*
+ * Moves the pointees of y which were not seen yet by the offset. Returns
+ * true if anything was added to the pointees of x.
+ */
+bool UnificationSolver::applyGep(unsigned i) {
+  Gep &G = geps[i];
+  const ClassId src = deref(get(G.y));
+  const std::vector<NodeId> members = classes[src].members;
+  bool change = false;
+
+  for (std::size_t j = 0; j < members.size(); ++j) {
+    if (!G.done.insert(members[j]).second)
+      continue;
+
+    int64_t sum;
+    NodeId to;
+
+    /*
+     * Once x and y are unified, each derived pointee would be moved again
+     * on the next pass. Hence the offsets are counted per gep, not per
+     * class, and all the derived ones count.
+     */
+    if (CF) {
+      /* a copy, getLocation() may add locations */
+      const ConstraintFile::Location X = CF->locations[members[j]];
+      const ConstraintFile::Object &O = CF->objects[X.object];
+
+      if (!F.move(i, X.object, O.size, O.flags, X.offset, G.off, G.isArray,
+	    sum))
+	continue;
+      to = grow(CF->getLocation(X.object, sum));
+    } else {
+      const Value *Rval = L->getLocation(members[j]).first;
+
+      if (!F.move(i, Rval, L->getLocation(members[j]).second, G.off,
+	    G.isArray, sum))
+	continue;
+      to = getNode(Rval, sum);
+    }
+
+    const ClassId dst = deref(get(G.x));
+    const ClassId moved = get(to);
+    if (find(dst) != find(moved)) {
+      join(dst, moved);
+      change = true;
+    }
+  }
+
+  if (F.takeCollapsed(objects)) {
+    for (std::size_t j = 0; j < objects.size(); ++j) {
+      if (L) {
+	L->collapse(F.getValue(objects[j]), fields);
+	continue;
+      }
+
+      std::vector<uint32_t> ids;
+      CF->collapse(objects[j], ids);
+
+      const NodeId first = CF->getLocation(objects[j], 0);
+      for (std::size_t k = 0; k < ids.size(); ++k)
+	fields.push_back(std::make_pair(ids[k], first));
+    }
+    change |= joinFields();
+  }
+
+  return change;
+}
+
+/* the fields of the collapsed objects, see LocationTable::collapse() */
+bool UnificationSolver::joinFields() {
+  bool change = false;
+
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    const NodeId f = fields[i].first, first = fields[i].second;
+
+    if (classOf.size() <= std::max(f, first)) {
+      classOf.resize(std::max(f, first) + 1, NONE);
+      key.resize(classOf.size());
+    }
+    if (find(get(f)) != find(get(first))) {
+      join(get(f), get(first));
+      change = true;
+    }
+  }
+  fields.clear();
+
+  return change;
+}
+
+void UnificationSolver::solve(const ProgramStructure &P) {
+  for (ProgramStructure::const_iterator I = P.begin(), E = P.end(); I != E;
+      ++I)
+    addRule(*I);
+
+  /* collapsed while solving for the same table before */
+  fields = L->getCollapsed();
+  joinFields();
+
+  applyGeps();
+}
+
+void UnificationSolver::solve() {
+  if (!CF->locations.empty())
+    grow(CF->locations.size() - 1);
+
+  for (unsigned k = 0; k < ConstraintFile::R_KINDS; ++k)
+    addRules(CF->rules[k], ConstraintFile::RuleKind(k));
+
+  applyGeps();
+}
+
+void UnificationSolver::applyGeps() {
+  bool change;
+
+  do {
+    change = false;
+    for (unsigned i = 0; i < geps.size(); ++i)
+      change |= applyGep(i);
+  } while (change);
+}
+
+void UnificationSolver::markDerefs() {
+  for (std::size_t i = 0; i < derefs.size(); ++i) {
+    const std::vector<NodeId> &M = classes[deref(get(derefs[i]))].members;
+    for (std::size_t j = 0; j < M.size(); ++j)
+      key[M[j]] = true;
+  }
+}
+
+/* All the locations of one class get the very same set. */
+void UnificationSolver::fill(PointsToSets &S) {
+  markDerefs();
+
+  /* indexed by the pointee class */
+  std::vector<const PointsToSets::PointsToSet *> shared(classes.size());
+  PointsToSets::PointsToSet none;
+  const PointsToSets::PointsToSet *empty = S.intern(none);
+
+  for (NodeId n = 0; n < key.size(); ++n) {
+    if (!key[n])
+      continue;
+
+    const ClassId c = get(n);
+    if (classes[c].pointee == NONE) {
+      S.assign(n, empty);
+      continue;
+    }
+
+    const ClassId p = find(classes[c].pointee);
+    if (!shared[p]) {
+      PointsToSets::PointsToSet pts;
+      for (std::size_t i = 0; i < classes[p].members.size(); ++i)
+	pts.insert(L->getLocation(classes[p].members[i]));
+      shared[p] = S.intern(pts);
+    }
+    S.assign(n, shared[p]);
+  }
+}
+
+void UnificationSolver::fill(std::vector<std::vector<uint32_t> > &sets) {
+  sets.assign(CF->locations.size(), std::vector<uint32_t>());
+  markDerefs();
+
+  for (NodeId n = 0; n < key.size(); ++n) {
+    if (!key[n])
+      continue;
+
+    const ClassId c = get(n);
+    if (classes[c].pointee == NONE)
+      continue;
+
+    const std::vector<NodeId> &M = classes[find(classes[c].pointee)].members;
+    sets[n].assign(M.begin(), M.end());
+    std::sort(sets[n].begin(), sets[n].end());
+  }
+}
+
+}
+
+PointsToSets &solveSteensgaard(const ProgramStructure &P, PointsToSets &S,
+    const FieldOptions &O) {
+  UnificationSolver U(P, S.getLocations(), O);
+
+  U.solve(P);
+  U.fill(S);
+
+  return S;
+}
+
+void solveSteensgaard(ConstraintFile &F, const FieldOptions &O,
+    std::vector<std::vector<uint32_t> > &sets) {
+  UnificationSolver U(F, O);
+
+  U.solve();
+  U.fill(sets);
+}
+
+}}}
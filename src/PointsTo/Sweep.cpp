@@ -0,0 +1,307 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Sweep solver: re-applies every rule until nothing changes.
+ *
+ * The rules are compiled once (see ConstraintFile), with both sides as
+ * location ids. What the GEP rules need from the IR and the DataLayout is
+ * computed there too: the constant offset, whether an array is indexed, and
+ * the size of every object they may move into (see FieldPolicy). A sweep is
+ * then a few loops over plain arrays, one per kind of rule, and the sets
+ * are sorted arrays of location ids. The same code solves the rules read
+ * from a file.
+ *
+ * The rules are applied kind by kind, not in the order of ProgramStructure.
+ * The fixpoint is the same, except for which offsets survive the GEP
+ * heuristics, as between the other solvers.
+ *
+ * When FieldPolicy collapses an object, the sets of its fields are merged
+ * into that of <object, 0> and the fields are its aliases from then on.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "Budget.h"
+#include "ConstraintFile.h"
+#include "FieldPolicy.h"
+#include "PointsTo.h"
+#include "Solvers.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+typedef ConstraintFile::Rules Rules;
+
+class SweepSolver {
+public:
+  SweepSolver(ConstraintFile &F, const FieldOptions &O,
+      std::vector<std::vector<uint32_t> > &sets);
+
+  bool sweep();
+  /* gives the fields of the collapsed objects the set of <object, 0> */
+  void copyCollapsed();
+  /* @F has to be compiled in this process, see ConstraintFile::values */
+  void fill(PointsToSets &S) const;
+
+private:
+  ConstraintFile &F;
+  FieldPolicy FP;
+  std::vector<std::vector<uint32_t> > &sets;
+  /* the locations PointsToSets gets an entry for, those the rules touch */
+  std::vector<char> keys;
+  /* the fields of the collapsed objects, merged into <object, 0> */
+  DenseMap<uint32_t, uint32_t> collapsedInto;
+  /* copies of sets being iterated while others change */
+  std::vector<uint32_t> pointers, pointees, values, merged;
+  std::vector<uint32_t> objects, fields;
+
+  uint32_t getId(uint32_t object, int off);
+  /* the id whose set @id uses */
+  uint32_t find(uint32_t id) const {
+    DenseMap<uint32_t, uint32_t>::const_iterator I = collapsedInto.find(id);
+    return I == collapsedInto.end() ? id : I->second;
+  }
+  void collapse();
+  void read(uint32_t id, std::vector<uint32_t> &out);
+  bool insert(uint32_t id, uint32_t e);
+  bool unite(uint32_t id, const std::vector<uint32_t> &add);
+
+  bool applyGep(uint32_t l, uint32_t r, int64_t off, bool isArray);
+  bool applyLoad(uint32_t l, uint32_t r);
+  bool applyStoreAddr(uint32_t l, uint32_t r);
+  bool applyStore(uint32_t l, uint32_t r);
+  bool applyStoreLoad(uint32_t l, uint32_t r);
+};
+
+SweepSolver::SweepSolver(ConstraintFile &F, const FieldOptions &O,
+    std::vector<std::vector<uint32_t> > &sets) : F(F), FP(O), sets(sets),
+    keys(F.locations.size(), false) {
+  sets.assign(F.locations.size(), std::vector<uint32_t>());
+}
+
+uint32_t SweepSolver::getId(uint32_t object, int off) {
+  const uint32_t id = F.getLocation(object, off);
+
+  if (id >= sets.size()) {
+    sets.resize(id + 1);
+    keys.resize(id + 1, false);
+  }
+
+  return id;
+}
+
+void SweepSolver::read(uint32_t id, std::vector<uint32_t> &out) {
+  keys[id] = true;
+  out = sets[find(id)];
+}
+
+bool SweepSolver::insert(uint32_t id, uint32_t e) {
+  std::vector<uint32_t> &S = sets[find(id)];
+  std::vector<uint32_t>::iterator I = std::lower_bound(S.begin(), S.end(), e);
+
+  keys[id] = true;
+  if (I != S.end() && *I == e)
+    return false;
+
+  S.insert(I, e);
+  return true;
+}
+
+/* @add is sorted */
+bool SweepSolver::unite(uint32_t id, const std::vector<uint32_t> &add) {
+  std::vector<uint32_t> &S = sets[find(id)];
+
+  keys[id] = true;
+  merged.clear();
+  std::set_union(S.begin(), S.end(), add.begin(), add.end(),
+      std::back_inserter(merged));
+  if (merged.size() == S.size())
+    return false;
+
+  S.swap(merged);
+  return true;
+}
+
+bool SweepSolver::applyGep(uint32_t l, uint32_t r, int64_t off,
+    bool isArray) {
+  bool change = false;
+
+  keys[l] = true;
+  read(r, pointees);
+  for (std::size_t i = 0; i < pointees.size(); ++i) {
+    /* disable recursive structures */
+    const std::vector<uint32_t> &X = sets[find(l)];
+    if (FP.getOptions().cutRecursion &&
+	std::binary_search(X.begin(), X.end(), pointees[i]))
+      continue;
+
+    /* a copy, getId() may add locations */
+    const ConstraintFile::Location L = F.locations[pointees[i]];
+    const ConstraintFile::Object &O = F.objects[L.object];
+    int64_t sum;
+
+    if (!FP.move(l, L.object, O.size, O.flags, L.offset, off, isArray, sum))
+      continue;
+
+    change |= insert(l, getId(L.object, sum));
+  }
+
+  if (FP.takeCollapsed(objects)) {
+    collapse();
+    change = true;
+  }
+
+  return change;
+}
+
+void SweepSolver::collapse() {
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    fields.clear();
+    F.collapse(objects[i], fields);
+
+    const uint32_t first = getId(objects[i], 0);
+    for (std::size_t j = 0; j < fields.size(); ++j) {
+      values.swap(sets[fields[j]]);
+      std::vector<uint32_t>().swap(sets[fields[j]]);
+      collapsedInto[fields[j]] = first;
+      if (keys[fields[j]])
+	unite(first, values);
+    }
+  }
+}
+
+bool SweepSolver::applyLoad(uint32_t l, uint32_t r) {
+  bool change = false;
+
+  read(r, pointees);
+  for (std::size_t i = 0; i < pointees.size(); ++i) {
+    read(pointees[i], values);
+    change |= unite(l, values);
+  }
+
+  return change;
+}
+
+bool SweepSolver::applyStoreAddr(uint32_t l, uint32_t r) {
+  bool change = false;
+
+  read(l, pointers);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= insert(pointers[i], r);
+
+  return change;
+}
+
+bool SweepSolver::applyStore(uint32_t l, uint32_t r) {
+  bool change = false;
+
+  read(l, pointers);
+  read(r, values);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= unite(pointers[i], values);
+
+  return change;
+}
+
+/* each pointee of l is a pointer loading from r */
+bool SweepSolver::applyStoreLoad(uint32_t l, uint32_t r) {
+  bool change = false;
+
+  read(l, pointers);
+  for (std::size_t i = 0; i < pointers.size(); ++i)
+    change |= applyLoad(pointers[i], r);
+
+  return change;
+}
+
+bool SweepSolver::sweep() {
+  const Rules &addr = F.rules[ConstraintFile::R_ADDR];
+  const Rules &copy = F.rules[ConstraintFile::R_COPY];
+  const Rules &geps = F.rules[ConstraintFile::R_GEP];
+  const Rules &load = F.rules[ConstraintFile::R_LOAD];
+  const Rules &storeAddr = F.rules[ConstraintFile::R_STORE_ADDR];
+  const Rules &store = F.rules[ConstraintFile::R_STORE];
+  const Rules &storeLoad = F.rules[ConstraintFile::R_STORE_LOAD];
+  bool change = false;
+
+  for (std::size_t i = 0; i < addr.size(); ++i)
+    change |= insert(addr.lval[i], addr.rval[i]);
+  for (std::size_t i = 0; i < copy.size(); ++i) {
+    read(copy.rval[i], values);
+    change |= unite(copy.lval[i], values);
+  }
+  for (std::size_t i = 0; i < geps.size(); ++i)
+    change |= applyGep(geps.lval[i], geps.rval[i], geps.off[i],
+	geps.isArray[i]);
+  for (std::size_t i = 0; i < load.size(); ++i)
+    change |= applyLoad(load.lval[i], load.rval[i]);
+  for (std::size_t i = 0; i < storeAddr.size(); ++i)
+    change |= applyStoreAddr(storeAddr.lval[i], storeAddr.rval[i]);
+  for (std::size_t i = 0; i < store.size(); ++i)
+    change |= applyStore(store.lval[i], store.rval[i]);
+  for (std::size_t i = 0; i < storeLoad.size(); ++i)
+    change |= applyStoreLoad(storeLoad.lval[i], storeLoad.rval[i]);
+
+  return change;
+}
+
+void SweepSolver::copyCollapsed() {
+  for (DenseMap<uint32_t, uint32_t>::const_iterator I = collapsedInto.begin(),
+      E = collapsedInto.end(); I != E; ++I)
+    sets[I->first] = sets[I->second];
+}
+
+void SweepSolver::fill(PointsToSets &S) const {
+  for (uint32_t id = 0; id < sets.size(); ++id) {
+    if (!keys[id])
+      continue;
+
+    const ConstraintFile::Location &L = F.locations[id];
+    const std::vector<uint32_t> &Y = sets[find(id)];
+    PointsToSets::PointsToSet &X =
+      S[PointsToSets::Pointer(F.values[L.object], L.offset)];
+
+    for (std::size_t i = 0; i < Y.size(); ++i) {
+      const ConstraintFile::Location &P = F.locations[Y[i]];
+      X.insert(PointsToSets::Pointee(F.values[P.object], P.offset));
+    }
+  }
+}
+
+}
+
+unsigned solveConstraintFile(ConstraintFile &F, const FieldOptions &O,
+    std::vector<std::vector<uint32_t> > &sets, Budget *B) {
+  SweepSolver W(F, O, sets);
+  unsigned sweeps = 1;
+
+  while (W.sweep() && !(B && B->check()))
+    sweeps++;
+  W.copyCollapsed();
+
+  return sweeps;
+}
+
+PointsToSets &solveSweep(const ProgramStructure &P, PointsToSets &S,
+    const FieldOptions &O, Budget *B) {
+  ConstraintFile F;
+  std::vector<std::vector<uint32_t> > sets;
+
+  compileConstraints(P, O, F);
+
+  SweepSolver W(F, O, sets);
+
+  while (W.sweep())
+    if (B && B->check())
+      break;
+  W.fill(S);
+
+  return S;
+}
+
+}}}
@@ -0,0 +1,269 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Wave propagation solver (Pereira and Berlin).
+ *
+ * The constraint graph (see ConstraintGraph.h) is solved in rounds. Each
+ * round collapses all copy cycles, so that the copy edges form a DAG, and
+ * sends a wave of differences down this DAG in topological order. The nodes
+ * are grouped into levels by their longest distance from a source. Nodes of
+ * one level depend only on the levels above, so they pull the differences
+ * from their predecessors in parallel. Each node writes only its own sets,
+ * no locking is needed.
+ *
+ * Then the new pointees are applied to the load, store and gep edges. This
+ * part is sequential and in a fixed order. It adds edges and creates nodes,
+ * and the gep heuristics depend on the order in which pointees come.
+ *
+ * Rounds repeat until the second part changes nothing. The result does not
+ * depend on the number of threads.
+ *
+ * It may differ from what the worklist solver gets, though. The pointees
+ * reach a gep edge in another order here, and with the default
+ * FieldOptions both cutRecursion and maxOffsets depend on that order: which
+ * pointee is cut as the gep's own, and which offsets an object had when it
+ * was collapsed. With cutRecursion off and no object collapsed, the sets
+ * are the same.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "Budget.h"
+#include "ConstraintGraph.h"
+#include "PointsTo.h"
+#include "Solvers.h"
+#include "WorkerPool.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+class WaveSolver {
+public:
+  WaveSolver(const ProgramStructure &P, LocationTable &L, unsigned threads,
+      const FieldOptions &O) : G(P, L, O), pool(threads), rounds(0) {}
+  WaveSolver(ConstraintFile &F, unsigned threads, const FieldOptions &O) :
+    G(F, O), pool(threads), rounds(0) {}
+
+  /* stops after the round in which @B, if any, is exceeded */
+  void solve(Budget *B);
+  void fill(PointsToSets &S) const { G.fill(S); }
+  void fill(std::vector<std::vector<uint32_t> > &sets) const { G.fill(sets); }
+
+private:
+  /* nodes at once for a thread, so that the threads do not fight for work */
+  static const std::size_t CHUNK = 64;
+
+  ConstraintGraph G;
+  WorkerPool pool;
+  unsigned rounds;
+
+  /* rebuilt each round, preds and delta are indexed by node id */
+  std::vector<NodeId> order;
+  std::vector<std::vector<NodeId> > preds;
+  std::vector<std::vector<NodeId> > levels;
+  std::vector<NodeSet> delta;
+
+  void buildLevels();
+  void pull(NodeId n);
+  void propagate();
+  bool insert(NodeId n, NodeId pointee);
+  bool addCopyEdge(NodeId src, NodeId dst);
+  bool addLoad(NodeId src, NodeId dst);
+  bool tieFields();
+  bool applyComplex(NodeId n);
+};
+
+void WaveSolver::buildLevels() {
+  std::vector<unsigned> level(G.size());
+
+  preds.assign(G.size(), std::vector<NodeId>());
+  levels.clear();
+
+  for (std::vector<NodeId>::const_iterator I = order.begin(),
+      E = order.end(); I != E; ++I) {
+    const std::vector<NodeId> &copyTo = G[*I].copyTo;
+
+    for (std::size_t i = 0; i < copyTo.size(); ++i) {
+      const NodeId dst = G.find(copyTo[i]);
+      if (dst != *I)
+	preds[dst].push_back(*I);
+    }
+  }
+
+  /* the predecessors come first in the order */
+  for (std::vector<NodeId>::const_iterator I = order.begin(),
+      E = order.end(); I != E; ++I) {
+    std::vector<NodeId> &P = preds[*I];
+    unsigned l = 0;
+
+    std::sort(P.begin(), P.end());
+    P.erase(std::unique(P.begin(), P.end()), P.end());
+    for (std::size_t i = 0; i < P.size(); ++i)
+      l = std::max(l, level[P[i]] + 1);
+
+    level[*I] = l;
+    if (levels.size() <= l)
+      levels.resize(l + 1);
+    levels[l].push_back(*I);
+  }
+}
+
+/*
+ * All the predecessors are done in this round already. Their differences
+ * are what they gained since the previous round, so this is all @n can gain
+ * from them.
+ */
+void WaveSolver::pull(NodeId n) {
+  Node &N = G[n];
+  const std::vector<NodeId> &P = preds[n];
+
+  for (std::size_t i = 0; i < P.size(); ++i)
+    N.pts.unionWith(delta[P[i]]);
+
+  delta[n].assignDifference(N.pts, N.done);
+  N.done.unionWith(delta[n]);
+}
+
+void WaveSolver::propagate() {
+  for (std::size_t l = 0; l < levels.size(); ++l) {
+    const std::vector<NodeId> &level = levels[l];
+
+    pool.run((level.size() + CHUNK - 1) / CHUNK, [&](std::size_t chunk) {
+      const std::size_t end = std::min(level.size(), (chunk + 1) * CHUNK);
+
+      for (std::size_t i = chunk * CHUNK; i < end; ++i)
+	pull(level[i]);
+    });
+  }
+}
+
+bool WaveSolver::insert(NodeId n, NodeId pointee) {
+  return G[G.find(n)].pts.insert(pointee);
+}
+
+/*
+ * A new edge carries the whole set of the source right away. What the
+ * source gains later is pulled by the next wave.
+ */
+bool WaveSolver::addCopyEdge(NodeId src, NodeId dst) {
+  if (!G.addCopyEdge(src, dst))
+    return false;
+
+  return G[G.find(dst)].pts.unionWith(G[G.find(src)].pts);
+}
+
+/* dst = *src */
+bool WaveSolver::addLoad(NodeId src, NodeId dst) {
+  if (!G.addLoadEdge(src, dst))
+    return false;
+
+  bool change = false;
+  const NodeSet S = G[G.find(src)].pts;
+  for (NodeSet::const_iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    G[*I].key = true;
+    change |= addCopyEdge(*I, dst);
+  }
+  return change;
+}
+
+/* see ConstraintGraph::takeCollapsedFields() */
+bool WaveSolver::tieFields() {
+  std::vector<std::pair<NodeId, NodeId> > fields;
+  bool change = false;
+
+  G.takeCollapsedFields(fields);
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    change |= addCopyEdge(fields[i].first, fields[i].second);
+    change |= addCopyEdge(fields[i].second, fields[i].first);
+  }
+
+  return change;
+}
+
+/*
+ * The same as WorklistSolver::visit() does with the load, store and gep
+ * edges, only for the differences of the last wave.
+ */
+bool WaveSolver::applyComplex(NodeId n) {
+  const NodeSet &D = delta[n];
+  bool change = false;
+
+  for (NodeSet::const_iterator I = D.begin(), E = D.end(); I != E; ++I) {
+    const NodeId o = *I;
+    Node &N = G[n];
+
+    if (!N.loadTo.empty() || !N.storeFrom.empty() || !N.storeAddr.empty() ||
+	!N.storeLoad.empty())
+      G[o].key = true;
+
+    for (std::size_t i = 0; i < N.loadTo.size(); ++i)
+      change |= addCopyEdge(o, N.loadTo[i]);
+    for (std::size_t i = 0; i < N.storeFrom.size(); ++i)
+      change |= addCopyEdge(N.storeFrom[i], o);
+    for (std::size_t i = 0; i < N.storeAddr.size(); ++i)
+      change |= insert(o, N.storeAddr[i]);
+    for (std::size_t i = 0; i < N.storeLoad.size(); ++i)
+      change |= addLoad(N.storeLoad[i], o);
+  }
+
+  for (std::size_t i = 0; i < G[n].gepTo.size(); ++i) {
+    const GepEdge E = G[n].gepTo[i];
+
+    for (NodeSet::const_iterator I = D.begin(), EE = D.end(); I != EE; ++I)
+      change |= G.insertGep(E, *I);
+  }
+
+  return change;
+}
+
+void WaveSolver::solve(Budget *B) {
+  bool change;
+
+  do {
+    rounds++;
+
+    G.collapseAll(order);
+    buildLevels();
+    delta.assign(G.size(), NodeSet());
+    propagate();
+
+    change = false;
+    for (std::size_t i = 0; i < order.size(); ++i)
+      if (!delta[order[i]].empty())
+	change |= applyComplex(order[i]);
+    change |= tieFields();
+  } while (change && !(B && B->check()));
+
+#ifdef PS_DEBUG
+  errs() << "wave: " << rounds << " rounds on " << pool.getThreads() <<
+    " threads, " << G.getCollapsed() << " of " << G.size() <<
+    " nodes collapsed\n";
+#endif
+}
+
+}
+
+PointsToSets &solveWave(const ProgramStructure &P, PointsToSets &S,
+    unsigned threads, const FieldOptions &O, Budget *B) {
+  WaveSolver W(P, S.getLocations(), threads, O);
+
+  W.solve(B);
+  W.fill(S);
+
+  return S;
+}
+
+void solveWave(ConstraintFile &F, unsigned threads, const FieldOptions &O,
+    std::vector<std::vector<uint32_t> > &sets, Budget *B) {
+  WaveSolver W(F, threads, O);
+
+  W.solve(B);
+  W.fill(sets);
+}
+
+}}}
@@ -0,0 +1,119 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef POINTSTO_WORKERPOOL_H
+#define POINTSTO_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm { namespace ptr {
+
+  /*
+   * A fixed set of threads running parallel loops. run() hands out the
+   * indices one by one to the workers and to the calling thread and returns
+   * once all of them are processed. The pool is meant for many short loops,
+   * the threads are not respawned for each of them.
+   */
+  class WorkerPool {
+  public:
+    typedef std::function<void (std::size_t)> Job;
+
+    /* 0 means one thread per core, the calling thread included */
+    explicit WorkerPool(unsigned threads) : job(0), size(0), next(0),
+	busy(0), generation(0), stop(false) {
+      if (!threads)
+	threads = std::thread::hardware_concurrency();
+      for (unsigned i = 1; i < threads; ++i)
+	workers.push_back(std::thread(&WorkerPool::work, this));
+    }
+
+    ~WorkerPool() {
+      {
+	std::lock_guard<std::mutex> lock(M);
+	stop = true;
+      }
+      wake.notify_all();
+      for (std::size_t i = 0; i < workers.size(); ++i)
+	workers[i].join();
+    }
+
+    unsigned getThreads() const { return workers.size() + 1; }
+
+    /* Calls @J(i) for all i in [0, @n), in no particular order. */
+    void run(std::size_t n, const Job &J) {
+      if (workers.empty() || n < 2) {
+	for (std::size_t i = 0; i < n; ++i)
+	  J(i);
+	return;
+      }
+
+      {
+	std::lock_guard<std::mutex> lock(M);
+	job = &J;
+	size = n;
+	next = 0;
+	busy = workers.size();
+	generation++;
+      }
+      wake.notify_all();
+
+      drain();
+
+      std::unique_lock<std::mutex> lock(M);
+      while (busy)
+	finished.wait(lock);
+      job = 0;
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::mutex M;
+    std::condition_variable wake, finished;
+
+    /* the loop being run, set under M */
+    const Job *job;
+    std::size_t size;
+    std::atomic<std::size_t> next;
+    unsigned busy;
+    unsigned generation;
+    bool stop;
+
+    void drain() {
+      for (std::size_t i; (i = next++) < size; )
+	(*job)(i);
+    }
+
+    void work() {
+      unsigned seen = 0;
+
+      while (true) {
+	{
+	  std::unique_lock<std::mutex> lock(M);
+	  while (!stop && generation == seen)
+	    wake.wait(lock);
+	  if (stop)
+	    return;
+	  seen = generation;
+	}
+
+	drain();
+
+	std::lock_guard<std::mutex> lock(M);
+	if (!--busy)
+	  finished.notify_one();
+      }
+    }
+
+    WorkerPool(const WorkerPool &);
+    void operator=(const WorkerPool &);
+  };
+
+}}
+
+#endif
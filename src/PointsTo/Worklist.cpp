@@ -0,0 +1,295 @@
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/*
+ * Worklist solver with difference propagation.
+ *
+ * The sweep solver (Sweep.cpp) re-applies every rule until nothing changes.
+ * Here the rules are translated once into a constraint graph whose nodes are
+ * the <location, offset> pairs (see ConstraintGraph.h). Only nodes whose
+ * points-to set grew are revisited and only the pointees added since the last
+ * visit are pushed along copy, gep, load and store edges. Edges induced by
+ * loads and stores are added on the fly as pointees show up. Copy cycles are
+ * detected lazily and collapsed into a single node.
+ *
+ * The same goes for the indirect calls deferred by ProgramStructure: once a
+ * function reaches the set of the called pointer, the rules passing the
+ * arguments and the return values of that call are added to the graph.
+ */
+
+#include <deque>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Budget.h"
+#include "ConstraintGraph.h"
+#include "PointsTo.h"
+#include "RuleExpressions.h"
+#include "Solvers.h"
+
+#include "../Languages/LLVM.h"
+
+namespace llvm { namespace ptr { namespace detail {
+
+namespace {
+
+class WorklistSolver {
+public:
+  WorklistSolver(const ProgramStructure &P, LocationTable &L,
+      const FieldOptions &O);
+  WorklistSolver(ConstraintFile &F, const FieldOptions &O);
+
+  /* stops early once @B, if any, is exceeded */
+  void solve(Budget *B);
+  void fill(PointsToSets &S) const { G.fill(S); }
+  void fill(std::vector<std::vector<uint32_t> > &sets) const { G.fill(sets); }
+
+private:
+  ConstraintGraph G;
+  std::deque<NodeId> worklist;
+  /* edges which already triggered a cycle search */
+  DenseSet<std::pair<NodeId, NodeId> > checked;
+  /* 0 for compiled rules */
+  const ProgramStructure::CallsContainer *calls;
+  /* <call, function> pairs whose rules are in the graph */
+  DenseSet<std::pair<unsigned, const Function *> > resolved;
+
+  void push(NodeId n);
+  void insert(NodeId n, NodeId pointee);
+  void addCopyEdge(NodeId src, NodeId dst);
+  void addLoad(NodeId src, NodeId dst);
+  void tieFields();
+  void addRule(const RuleCode &RC);
+  void resolve(unsigned call, const Function *F);
+  void visit(NodeId n);
+  void start();
+};
+
+WorklistSolver::WorklistSolver(const ProgramStructure &P, LocationTable &L,
+    const FieldOptions &O) : G(P, L, O), calls(&P.getIndirectCalls()) {
+  for (unsigned i = 0; i < calls->size(); ++i)
+    G[G.getKey(getCalledPointer((*calls)[i]))].calls.push_back(i);
+
+  start();
+}
+
+WorklistSolver::WorklistSolver(ConstraintFile &F, const FieldOptions &O) :
+    G(F, O), calls(0) {
+  start();
+}
+
+void WorklistSolver::start() {
+  for (NodeId n = 0; n < G.size(); ++n)
+    if (!G[n].pts.empty())
+      push(n);
+  tieFields();
+}
+
+void WorklistSolver::push(NodeId n) {
+  Node &N = G[G.find(n)];
+
+  if (!N.queued) {
+    N.queued = true;
+    worklist.push_back(G.find(n));
+  }
+}
+
+void WorklistSolver::insert(NodeId n, NodeId pointee) {
+  if (G[G.find(n)].pts.insert(pointee))
+    push(n);
+}
+
+/*
+ * A new edge has to carry the whole set of the source, the later differences
+ * are carried by visit().
+ */
+void WorklistSolver::addCopyEdge(NodeId src, NodeId dst) {
+  if (!G.addCopyEdge(src, dst))
+    return;
+
+  const NodeSet &S = G[G.find(src)].pts;
+
+  if (G[G.find(dst)].pts.unionWith(S))
+    push(dst);
+}
+
+/* dst = *src */
+void WorklistSolver::addLoad(NodeId src, NodeId dst) {
+  if (!G.addLoadEdge(src, dst))
+    return;
+
+  const NodeSet S = G[G.find(src)].pts;
+  for (NodeSet::const_iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    G[*I].key = true;
+    addCopyEdge(*I, dst);
+  }
+}
+
+/* see ConstraintGraph::takeCollapsedFields() */
+void WorklistSolver::tieFields() {
+  std::vector<std::pair<NodeId, NodeId> > fields;
+
+  if (!G.takeCollapsedFields(fields))
+    return;
+
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    addCopyEdge(fields[i].first, fields[i].second);
+    addCopyEdge(fields[i].second, fields[i].first);
+  }
+}
+
+/*
+ * The rules of a call only assign to the parameters and the call itself, see
+ * collectResolvedCall().
+ */
+void WorklistSolver::addRule(const RuleCode &RC) {
+  const Value *lval = RC.getLvalue();
+  const Value *rval = RC.getRvalue();
+
+  switch (RC.getType()) {
+  case RCT_VAR_ASGN_ALLOC:
+  case RCT_VAR_ASGN_NULL:
+  case RCT_VAR_ASGN_REF_VAR:
+    insert(G.getKey(lval), G.getNode(rval, 0));
+    break;
+  case RCT_VAR_ASGN_VAR:
+    addCopyEdge(G.getKey(rval), G.getKey(lval));
+    break;
+  case RCT_VAR_ASGN_DREF_VAR:
+    addLoad(G.getKey(rval), G.getKey(lval));
+    break;
+  default:
+    assert(0 && "Unexpected rule of a call");
+  }
+}
+
+void WorklistSolver::resolve(unsigned call, const Function *F) {
+  if (!resolved.insert(std::make_pair(call, F)).second)
+    return;
+
+  std::vector<RuleCode> rules;
+  collectResolvedCall((*calls)[call], F, rules);
+  for (std::size_t i = 0; i < rules.size(); ++i)
+    addRule(rules[i]);
+}
+
+void WorklistSolver::visit(NodeId n) {
+  NodeSet delta;
+
+  {
+    Node &N = G[n];
+    delta.assignDifference(N.pts, N.done);
+    if (delta.empty())
+      return;
+    N.done.unionWith(delta);
+  }
+
+  /*
+   * The edge vectors may grow while we walk them (e.g. *p = p), hence the
+   * indices.
+   */
+  for (NodeSet::const_iterator I = delta.begin(), E = delta.end(); I != E;
+      ++I) {
+    const NodeId o = *I;
+    Node &N = G[n];
+
+    if (!N.loadTo.empty() || !N.storeFrom.empty() || !N.storeAddr.empty() ||
+	!N.storeLoad.empty())
+      G[o].key = true;
+
+    for (std::size_t i = 0; i < N.loadTo.size(); ++i)
+      addCopyEdge(o, N.loadTo[i]);
+    for (std::size_t i = 0; i < N.storeFrom.size(); ++i)
+      addCopyEdge(N.storeFrom[i], o);
+    for (std::size_t i = 0; i < N.storeAddr.size(); ++i)
+      insert(o, N.storeAddr[i]);
+    for (std::size_t i = 0; i < N.storeLoad.size(); ++i)
+      addLoad(N.storeLoad[i], o);
+
+    if (!N.calls.empty())
+      if (const Function *F = dyn_cast<Function>(G.getLocation(o).first))
+	for (std::size_t i = 0; i < N.calls.size(); ++i)
+	  resolve(N.calls[i], F);
+  }
+
+  /*
+   * Lazy cycle detection: a copy edge whose both ends have the same set is
+   * likely to lie on a cycle. Look for it, but only once per edge.
+   */
+  SmallVector<NodeId, 8> suspects;
+
+  for (std::size_t i = 0; i < G[n].copyTo.size(); ++i) {
+    const NodeId dst = G.find(G[n].copyTo[i]);
+    if (dst == n)
+      continue;
+
+    if (G[dst].pts.unionWith(delta))
+      push(dst);
+    else if (G[dst].pts == G[n].pts &&
+	checked.insert(std::make_pair(n, dst)).second)
+      suspects.push_back(dst);
+  }
+
+  for (std::size_t i = 0; i < G[n].gepTo.size(); ++i) {
+    const GepEdge E = G[n].gepTo[i];
+    bool change = false;
+
+    for (NodeSet::const_iterator I = delta.begin(), EE = delta.end(); I != EE;
+	++I)
+      change |= G.insertGep(E, *I);
+    if (change)
+      push(E.dst);
+  }
+
+  SmallVector<NodeId, 8> reps;
+  for (unsigned i = 0; i < suspects.size(); ++i)
+    G.collapseCycles(suspects[i], reps);
+  for (unsigned i = 0; i < reps.size(); ++i)
+    push(reps[i]);
+
+  tieFields();
+}
+
+void WorklistSolver::solve(Budget *B) {
+  while (!worklist.empty()) {
+    if (B && B->exceeded())
+      break;
+
+    NodeId n = worklist.front();
+
+    worklist.pop_front();
+    G[n].queued = false;
+    /* merged into some other node meanwhile */
+    if (G.find(n) != n)
+      continue;
+    visit(n);
+  }
+#ifdef PS_DEBUG
+  errs() << "worklist: " << G.getCollapsed() << " of " << G.size() <<
+    " nodes collapsed, " << resolved.size() << " call edges resolved\n";
+#endif
+}
+
+}
+
+PointsToSets &solveWorklist(const ProgramStructure &P, PointsToSets &S,
+    const FieldOptions &O, Budget *B) {
+  WorklistSolver W(P, S.getLocations(), O);
+
+  W.solve(B);
+  W.fill(S);
+
+  return S;
+}
+
+void solveWorklist(ConstraintFile &F, const FieldOptions &O,
+    std::vector<std::vector<uint32_t> > &sets, Budget *B) {
+  WorklistSolver W(F, O);
+
+  W.solve(B);
+  W.fill(sets);
+}
+
+}}}
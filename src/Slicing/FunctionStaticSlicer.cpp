@@ -31,7 +31,6 @@
 #include "../Callgraph/Callgraph.h"
 #include "../Modifies/Modifies.h"
 #include "../PointsTo/PointsTo.h"
-#include "../Languages/LLVMSupport.h"
 
 #include "FunctionStaticSlicer.h"
 
@@ -96,6 +95,7 @@ void InsInfo::addREFArray(const ptr::PointsToSets &PS, const Value *V,
 }
 
 InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
+                 const callgraph::Callgraph &CG,
                  const mods::Modifies &MOD) : ins(i), sliced(true) {
   typedef ptr::PointsToSets::PointsToSet PTSet;
 
@@ -181,8 +181,6 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
       if (!isConstantValue(len))
 	addREF(Pointee(len, -1));
     } else {
-      typedef std::vector<const llvm::Function *> CalledVec;
-
       /* did we miss something? */
       assert(!memoryManStuff(cv));
 
@@ -191,11 +189,11 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
       else
 	addREF(Pointee(cv, -1));
 
-      CalledVec CV;
-      getCalledFunctions(C, PS, std::back_inserter(CV));
-      for (CalledVec::const_iterator f = CV.begin(); f != CV.end(); ++f) {
-        mods::Modifies::mapped_type const& M = getModSet(*f, MOD);
-        for (mods::Modifies::mapped_type::const_iterator v = M.begin();
+      /* only the defined functions have a mod set */
+      callgraph::Callgraph::function_iterator f, e;
+      for (llvm::tie(f, e) = CG.callTargets(C); f != e; ++f) {
+        mods::Modifies::ModSet const& M = getModSet(*f, MOD);
+        for (mods::Modifies::ModSet::const_iterator v = M.begin();
              v != M.end(); ++v)
           addDEF(*v);
       }
@@ -279,9 +277,13 @@ namespace {
       void getAnalysisUsage(AnalysisUsage &AU) const {
         AU.addRequired<PostDominatorTree>();
         AU.addRequired<PostDominanceFrontier>();
+        AU.addRequired<ptr::PointsToAnalysis>();
+        AU.addRequired<callgraph::CallgraphAnalysis>();
+        AU.addRequired<mods::ModifiesAnalysis>();
       }
     private:
       bool runOnFunction(Function &F, const ptr::PointsToSets &PS,
+                         const callgraph::Callgraph &CG,
                          const mods::Modifies &MOD);
   };
 }
@@ -321,7 +323,13 @@ bool FunctionStaticSlicer::sameValues(const Pointee &val1, const Pointee &val2)
  *   {v| v \in RC(j), v \notin DEF(i)} \cup
  *   {v| v \in REF(i), DEF(i) \cap RC(j) \neq \emptyset}
  */
-bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
+bool FunctionStaticSlicer::computeRCi(const Instruction *i,
+				      const Instruction *j) {
+  /* an empty RC(j) adds nothing, i need not be reached for it */
+  if (!hasRC(j))
+    return false;
+
+  InsInfo *insInfoi = getInsInfo(i), *insInfoj = getInsInfo(j);
   bool changed = false;
 
   /* {v| v \in RC(j), v \notin DEF(i)} */
@@ -368,8 +376,7 @@ bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
   return changed;
 }
 
-bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi) {
-  const Instruction *i = insInfoi->getIns();
+bool FunctionStaticSlicer::computeRCi(const Instruction *i) {
   bool changed = false;
 #ifdef DEBUG_RC
   errs() << "  " << __func__ << ": " << i->getOpcodeName();
@@ -383,7 +390,7 @@ bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi) {
   SuccList succList = getSuccList(i);
   for (SuccList::const_iterator I = succList.begin(), E = succList.end();
        I != E; I++)
-    changed |= computeRCi(insInfoi, getInsInfo(*I));
+    changed |= computeRCi(i, *I);
 
   return changed;
 }
@@ -401,14 +408,13 @@ void FunctionStaticSlicer::computeRC() {
     typedef std::reverse_iterator<Function::iterator> revFun;
     for (revFun I = revFun(fun.end()), E = revFun(fun.begin()); I != E; I++) {
       typedef std::reverse_iterator<BasicBlock::iterator> rev;
-      InsInfo *past = NULL;
+      const Instruction *past = NULL;
       for (rev II = rev(I->end()), EE = rev(I->begin()); II != EE; ++II) {
-        InsInfo *insInfo = getInsInfo(&*II);
         if (!past)
-          changed |= computeRCi(insInfo);
+          changed |= computeRCi(&*II);
         else
-          changed |= computeRCi(insInfo, past);
-        past = insInfo;
+          changed |= computeRCi(&*II, past);
+        past = &*II;
       }
     }
   } while (changed);
@@ -418,6 +424,9 @@ void FunctionStaticSlicer::computeRC() {
  * SC(i)={i| DEF(i) \cap RC(j) \neq \emptyset}
  */
 void FunctionStaticSlicer::computeSCi(const Instruction *i, const Instruction *j) {
+  if (!hasRC(j))
+    return;
+
   InsInfo *insInfoi = getInsInfo(i), *insInfoj = getInsInfo(j);
 
   bool isect_nonempty = false;
@@ -461,8 +470,8 @@ bool FunctionStaticSlicer::computeBC() {
   PostDominanceFrontier &PDF = MP->getAnalysis<PostDominanceFrontier>(fun);
   for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; I++) {
     Instruction *i = &*I;
-    const InsInfo *ii = getInsInfo(i);
-    if (ii->isSliced())
+    const InsInfo *ii = findInsInfo(i);
+    if (!ii || ii->isSliced())
       continue;
     BasicBlock *BB = i->getParent();
 #ifdef DEBUG_BC
@@ -532,7 +541,10 @@ void FunctionStaticSlicer::dump() {
 #ifdef DEBUG_DUMP
   for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E; I++) {
     const Instruction &i = *I;
-    const InsInfo *ii = getInsInfo(&i);
+    const InsInfo *ii = findInsInfo(&i);
+    /* not reached, sliced */
+    if (!ii)
+      continue;
     i.print(errs());
     errs() << "\n    ";
     if (!ii->isSliced() || !canSlice(i))
@@ -596,10 +608,11 @@ bool FunctionStaticSlicer::slice() {
   for (inst_iterator I = inst_begin(fun), E = inst_end(fun); I != E;) {
     Instruction &i = *I;
     InsInfoMap::iterator ii_iter = insInfoMap.find(&i);
-    assert(ii_iter != insInfoMap.end());
-    const InsInfo *ii = ii_iter->second;
+    /* not reached by the slice at all */
+    const bool sliced = ii_iter == insInfoMap.end() ||
+      ii_iter->second->isSliced();
     ++I;
-    if (ii->isSliced() && canSlice(i)) {
+    if (sliced && canSlice(i)) {
 #ifdef DEBUG_SLICE
       errs() << "  removing:";
       i.print(errs());
@@ -607,8 +620,10 @@ bool FunctionStaticSlicer::slice() {
 #endif
       i.replaceAllUsesWith(UndefValue::get(i.getType()));
       i.eraseFromParent();
-      insInfoMap.erase(ii_iter);
-      delete ii;
+      if (ii_iter != insInfoMap.end()) {
+        delete ii_iter->second;
+        insInfoMap.erase(ii_iter);
+      }
 
       removed = true;
     }
@@ -798,8 +813,9 @@ bool llvm::slicing::findInitialCriterion(Function &F,
 }
 
 bool FunctionSlicer::runOnFunction(Function &F, const ptr::PointsToSets &PS,
+                           const callgraph::Callgraph &CG,
                            const mods::Modifies &MOD) {
-  FunctionStaticSlicer ss(F, this, PS, MOD);
+  FunctionStaticSlicer ss(F, this, PS, CG, MOD);
 
   findInitialCriterion(F, ss);
 
@@ -813,25 +829,17 @@ bool FunctionSlicer::runOnFunction(Function &F, const ptr::PointsToSets &PS,
 }
 
 bool FunctionSlicer::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
-
-  mods::Modifies MOD;
-  {
-    mods::ProgramStructure P1(M);
-    computeModifies(P1, CG, PS, MOD);
-  }
+  const ptr::PointsToSets &PS =
+    getAnalysis<ptr::PointsToAnalysis>().getPointsToSets();
+  const callgraph::Callgraph &CG =
+    getAnalysis<callgraph::CallgraphAnalysis>().getCallgraph();
+  const mods::Modifies &MOD = getAnalysis<mods::ModifiesAnalysis>().getModifies();
 
   bool modified = false;
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
     Function &F = *I;
     if (!F.isDeclaration())
-      modified |= runOnFunction(F, PS, MOD);
+      modified |= runOnFunction(F, PS, CG, MOD);
   }
   return modified;
 }
@@ -11,6 +11,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/InstIterator.h"
 
+#include "../Callgraph/Callgraph.h"
 #include "../PointsTo/PointsTo.h"
 #include "../Modifies/Modifies.h"
 #include "PostDominanceFrontier.h"
@@ -25,6 +26,7 @@ private:
 
 public:
   InsInfo(const llvm::Instruction *i, const llvm::ptr::PointsToSets &PS,
+                   const llvm::callgraph::Callgraph &CG,
                    const llvm::mods::Modifies &MOD);
 
   const Instruction *getIns() const { return ins; }
@@ -56,6 +58,14 @@ private:
   bool sliced;
 };
 
+/*
+ * The InsInfo of an instruction, with the points-to sets and the mod sets
+ * it asks for, is built only once the slice reaches the instruction: when
+ * it gets a criterion, or a successor has something relevant. Until then,
+ * it is sliced and relevant to nothing, which is what its InsInfo would
+ * say too. So with sets computed on demand, only the pointers of the
+ * instructions the slice goes through are ever solved.
+ */
 class FunctionStaticSlicer {
   typedef llvm::ptr::PointsToSets::Pointee Pointee;
 
@@ -64,12 +74,9 @@ public:
 
   FunctionStaticSlicer(llvm::Function &F, llvm::ModulePass *MP,
                        const llvm::ptr::PointsToSets &PT,
+		       const llvm::callgraph::Callgraph &CG,
 		       const llvm::mods::Modifies &mods) :
-	  fun(F), MP(MP) {
-    for (llvm::inst_iterator I = llvm::inst_begin(F), E = llvm::inst_end(F);
-	 I != E; ++I)
-      insInfoMap.insert(InsInfoMap::value_type(&*I, new InsInfo(&*I, PT, mods)));
-  }
+	  fun(F), MP(MP), PS(PT), CG(CG), MOD(mods) {}
   ~FunctionStaticSlicer();
 
   ValSet::const_iterator relevant_begin(const llvm::Instruction *I) const {
@@ -122,13 +129,17 @@ public:
 private:
   llvm::Function &fun;
   llvm::ModulePass *MP;
-  InsInfoMap insInfoMap;
+  const llvm::ptr::PointsToSets &PS;
+  const llvm::callgraph::Callgraph &CG;
+  const llvm::mods::Modifies &MOD;
+  /* built as the slice reaches the instructions, see getInsInfo() */
+  mutable InsInfoMap insInfoMap;
   llvm::SmallSetVector<const llvm::CallInst *, 10> skipAssert;
 
   static bool sameValues(const Pointee &val1, const Pointee &val2);
   void crawlBasicBlock(const llvm::BasicBlock *bb);
-  bool computeRCi(InsInfo *insInfoi, InsInfo *insInfoj);
-  bool computeRCi(InsInfo *insInfoi);
+  bool computeRCi(const llvm::Instruction *i, const llvm::Instruction *j);
+  bool computeRCi(const llvm::Instruction *i);
   void computeRC();
 
   void computeSCi(const llvm::Instruction *i, const llvm::Instruction *j);
@@ -140,11 +151,24 @@ private:
 
   void dump();
 
+  /* builds the InsInfo of @i if there is none yet */
   InsInfo *getInsInfo(const llvm::Instruction *i) const {
-    InsInfoMap::const_iterator I = insInfoMap.find(i);
-    assert(I != insInfoMap.end());
+    InsInfoMap::iterator I = insInfoMap.lower_bound(i);
+    if (I == insInfoMap.end() || I->first != i)
+      I = insInfoMap.insert(I, InsInfoMap::value_type(i,
+			      new InsInfo(i, PS, CG, MOD)));
     return I->second;
   }
+  /* 0 if the slice has not reached @i */
+  InsInfo *findInsInfo(const llvm::Instruction *i) const {
+    InsInfoMap::const_iterator I = insInfoMap.find(i);
+    return I == insInfoMap.end() ? 0 : I->second;
+  }
+  /* whether @i is reached and something is relevant after it */
+  bool hasRC(const llvm::Instruction *i) const {
+    const InsInfo *ii = findInsInfo(i);
+    return ii && ii->RC_begin() != ii->RC_end();
+  }
 
   static void removeUndefBranches(ModulePass *MP, Function &F);
   static void removeUndefCalls(ModulePass *MP, Function &F);
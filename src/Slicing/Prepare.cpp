@@ -34,6 +34,10 @@ namespace {
 
       virtual bool runOnModule(Module &M);
 
+      virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<ptr::PointsToAnalysis>();
+      }
+
     private:
       static void replaceInsLoad(llvm::Function &F, llvm::CallInst *CI);
       static void replaceInsStore(llvm::Function &F, llvm::CallInst *CI);
@@ -256,8 +260,8 @@ bool Prepare::addInitFun(const callgraph::Callgraph &CG,
   if (F.isDeclaration())
     return false;
   if (starting) {
-    callgraph::Callgraph::range_iterator callees = CG.callees(&F);
-    if (std::distance(callees.first, callees.second))
+    callgraph::Callgraph::function_range callers = CG.directCallees(&F);
+    if (callers.first != callers.second)
       return false;
   }
   initFns.push_back(ConstantExpr::getBitCast(&F, ETy));
@@ -286,11 +290,8 @@ void Prepare::findInitFuns(Module &M, const ptr::PointsToSets &PS) {
 }
 
 bool Prepare::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
+  const ptr::PointsToSets &PS =
+    getAnalysis<ptr::PointsToAnalysis>().getPointsToSets();
 
   deleteAsmBodies(M);
 
@@ -84,10 +84,6 @@ namespace llvm { namespace slicing {
     class StaticSlicer {
     public:
         typedef std::map<llvm::Function const*, FunctionStaticSlicer *> Slicers;
-        typedef std::multimap<llvm::Function const*,llvm::CallInst const*>
-                FuncsToCalls;
-        typedef std::multimap<llvm::CallInst const*,llvm::Function const*>
-                CallsToFuncs;
 
         StaticSlicer(ModulePass *MP, Module &M,
 		     const ptr::PointsToSets &PS,
@@ -102,9 +98,6 @@ namespace llvm { namespace slicing {
     private:
         typedef llvm::SmallVector<const llvm::Function *, 20> InitFuns;
 
-	void buildDicts(const ptr::PointsToSets &PS, const CallInst *c);
-        void buildDicts(const ptr::PointsToSets &PS);
-
         template<typename OutIterator>
         void emitToCalls(llvm::Function const* const f, OutIterator out);
 
@@ -118,8 +111,7 @@ namespace llvm { namespace slicing {
         Module &module;
         Slicers slicers;
         InitFuns initFuns;
-        FuncsToCalls funcsToCalls;
-        CallsToFuncs callsToFuncs;
+        const callgraph::Callgraph &CG;
     };
 
     template<typename OutIterator>
@@ -128,16 +120,16 @@ namespace llvm { namespace slicing {
 	const ValSet::const_iterator relBgn = slicers[f]->relevant_begin(entry);
         const ValSet::const_iterator relEnd = slicers[f]->relevant_end(entry);
 
-        FuncsToCalls::const_iterator c, e;
-        llvm::tie(c, e) = funcsToCalls.equal_range(f);
+        callgraph::Callgraph::callsite_iterator c, e;
+        llvm::tie(c, e) = CG.callSites(f);
 
         for ( ; c != e; ++c) {
-	    const CallInst *CI = c->second;
+	    const CallInst *CI = *c;
 	    const Function *g = CI->getParent()->getParent();
 	    FunctionStaticSlicer *FSS = slicers[g];
 
 	    detail::RelevantSet R;
-	    detail::getRelevantVarsAtCall(c->second, f, relBgn, relEnd, R);
+	    detail::getRelevantVarsAtCall(CI, f, relBgn, relEnd, R);
 
 	    if (FSS->addCriterion(CI, R.begin(), R.end(),
 				    !FSS->shouldSkipAssert(CI))) {
@@ -160,12 +152,12 @@ namespace llvm { namespace slicing {
             const ValSet::const_iterator relEnd =
                 slicers[f]->relevant_end(getSuccInBlock(*c));
 
-            CallsToFuncs::const_iterator g, e;
-            llvm::tie(g, e) = callsToFuncs.equal_range(*c);
+            callgraph::Callgraph::function_iterator g, e;
+            llvm::tie(g, e) = CG.callTargets(*c);
 
             for ( ; g != e; ++g) {
                 typedef std::vector<const llvm::ReturnInst *> ExitsVec;
-		const Function *callie = g->second;
+		const Function *callie = *g;
 
                 ExitsVec E;
                 getFunctionExits(callie, std::back_inserter(E));
@@ -173,56 +165,21 @@ namespace llvm { namespace slicing {
                 for (ExitsVec::const_iterator e = E.begin(); e != E.end(); ++e) {
 		    detail::RelevantSet R;
 		    detail::getRelevantVarsAtExit(*c, *e, relBgn, relEnd, R);
-                    if (slicers[g->second]->addCriterion(*e, R.begin(),R .end()))
-                        *out++ = g->second;
+                    if (slicers[callie]->addCriterion(*e, R.begin(),R .end()))
+                        *out++ = callie;
                 }
             }
         }
     }
 
-    void StaticSlicer::buildDicts(const ptr::PointsToSets &PS,
-		const CallInst *c) {
-	typedef std::vector<const Function *> FunCon;
-	FunCon G;
-	getCalledFunctions(c, PS, std::back_inserter(G));
-
-	for (FunCon::const_iterator I = G.begin(), E = G.end(); I != E; ++I) {
-	    const Function *h = *I;
-
-	    if (!memoryManStuff(h) && !h->isDeclaration()) {
-		funcsToCalls.insert(std::make_pair(h, c));
-		callsToFuncs.insert(std::make_pair(c, h));
-	    }
-	}
-    }
-
-    void StaticSlicer::buildDicts(const ptr::PointsToSets &PS)
-    {
-        for (Module::const_iterator f = module.begin(); f != module.end(); ++f)
-            if (!f->isDeclaration() && !memoryManStuff(&*f))
-                for (const_inst_iterator I = inst_begin(*f), E = inst_end(*f);
-			I != E; ++I)
-                    if (const CallInst *c = dyn_cast<CallInst>(&*I)) {
-			if (isInlineAssembly(c)) {
-			    errs() << "ERROR: Inline assembler detected in " <<
-				f->getName() << ", skipping\n";
-			    continue;
-			}
-
-			buildDicts(PS, c);
-		    }
-    }
-
     StaticSlicer::StaticSlicer(ModulePass *MP, Module &M,
                                const ptr::PointsToSets &PS,
                                const callgraph::Callgraph &CG,
                                const mods::Modifies &MOD) : MP(MP), module(M),
-                               slicers(), initFuns(), funcsToCalls(),
-                               callsToFuncs() {
+                               slicers(), initFuns(), CG(CG) {
         for (Module::iterator f = M.begin(); f != M.end(); ++f)
           if (!f->isDeclaration() && !memoryManStuff(&*f))
             runFSS(*f, PS, CG, MOD);
-        buildDicts(PS);
     }
 
     StaticSlicer::~StaticSlicer() {
@@ -234,10 +191,11 @@ namespace llvm { namespace slicing {
     void StaticSlicer::runFSS(Function &F, const ptr::PointsToSets &PS,
 			      const callgraph::Callgraph &CG,
 			      const mods::Modifies &MOD) {
-      callgraph::Callgraph::range_iterator callees = CG.callees(&F);
-      bool starting = std::distance(callees.first, callees.second) == 0;
+      callgraph::Callgraph::function_range callers = CG.directCallees(&F);
+      bool starting = callers.first == callers.second;
 
-      FunctionStaticSlicer *FSS = new FunctionStaticSlicer(F, MP, PS, MOD);
+      FunctionStaticSlicer *FSS = new FunctionStaticSlicer(F, MP, PS, CG,
+							     MOD);
       bool hadAssert = slicing::findInitialCriterion(F, *FSS, starting);
 
       /*
@@ -291,6 +249,9 @@ namespace {
       void getAnalysisUsage(AnalysisUsage &AU) const {
         AU.addRequired<PostDominatorTree>();
         AU.addRequired<PostDominanceFrontier>();
+        AU.addRequired<ptr::PointsToAnalysis>();
+        AU.addRequired<callgraph::CallgraphAnalysis>();
+        AU.addRequired<mods::ModifiesAnalysis>();
       }
   };
 }
@@ -299,19 +260,11 @@ static RegisterPass<Slicer> X("slice-inter", "Slices the code interprocedurally"
 char Slicer::ID;
 
 bool Slicer::runOnModule(Module &M) {
-  ptr::PointsToSets PS;
-  {
-    ptr::ProgramStructure P(M);
-    computePointsToSets(P, PS);
-  }
-
-  callgraph::Callgraph CG(M, PS);
-
-  mods::Modifies MOD;
-  {
-    mods::ProgramStructure P1(M);
-    computeModifies(P1, CG, PS, MOD);
-  }
+  const ptr::PointsToSets &PS =
+    getAnalysis<ptr::PointsToAnalysis>().getPointsToSets();
+  callgraph::Callgraph &CG =
+    getAnalysis<callgraph::CallgraphAnalysis>().getCallgraph();
+  const mods::Modifies &MOD = getAnalysis<mods::ModifiesAnalysis>().getModifies();
 
   slicing::StaticSlicer SS(this, M, PS, CG, MOD);
   SS.computeSlice();
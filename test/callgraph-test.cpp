@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "../src/Callgraph/Callgraph.h"
+#include "../src/Modifies/Modifies.h"
+#include "../src/PointsTo/PointsTo.h"
+
+using namespace llvm;
+
+typedef callgraph::Callgraph Callgraph;
+typedef std::vector<const Function *> Functions;
+typedef std::vector<const CallInst *> CallSites;
+typedef std::pair<const Function *, const Function *> Call;
+typedef std::set<Call> Calls;
+typedef mods::Modifies::ModSet ModSet;
+typedef ptr::PointsToSets::Pointee Ptee;
+
+/*
+ * The functions of the module built below, in the order of the module:
+ *
+ *   main -> a, self, d, and l or r through a pointer
+ *   self -> self
+ *   a -> b, b -> a, d, d
+ *   d -> l, r
+ *   l -> j, r -> j
+ *   j -> ext (a declaration, no part of the graph)
+ *   lone makes no call and none calls it
+ *
+ * Every function stores to its own global. main stores its local x to
+ * the global gp too, and j stores through gp, i.e. to x.
+ */
+enum { MAIN, SELF, A, B, D, L, R, J, LONE, FUNCTIONS };
+
+struct Graph {
+	Function *F[FUNCTIONS];
+	GlobalVariable *G[FUNCTIONS];
+	GlobalVariable *gp;
+	Value *x;
+	Function *ext;
+	CallInst *toA, *toSelf, *toD, *toTarget;
+	CallInst *selfToSelf, *aToB, *bToA, *bToD1, *bToD2, *dToL, *dToR;
+	CallInst *lToJ, *rToJ, *jToExt;
+};
+
+static std::unique_ptr<Module> build(LLVMContext &C, Graph &g)
+{
+	static const char *const names[] = {
+		"main", "self", "a", "b", "d", "l", "r", "j", "lone"
+	};
+	Module *M = new Module("callgraph", C);
+	IntegerType *int8 = Type::getInt8Ty(C);
+	IntegerType *int32 = Type::getInt32Ty(C);
+	Type *int8Ptr = Type::getInt8PtrTy(C);
+	FunctionType *voidTy = FunctionType::get(Type::getVoidTy(C), false);
+	BasicBlock *entry[FUNCTIONS];
+
+	for (unsigned f = 0; f < FUNCTIONS; f++) {
+		g.F[f] = Function::Create(voidTy,
+				GlobalValue::InternalLinkage, names[f], M);
+		g.G[f] = new GlobalVariable(*M, int32, false,
+				GlobalValue::InternalLinkage, 0,
+				std::string("G_") + names[f]);
+		entry[f] = BasicBlock::Create(C, "entry", g.F[f]);
+	}
+	g.ext = Function::Create(voidTy, GlobalValue::ExternalLinkage,
+			"ext", M);
+	g.gp = new GlobalVariable(*M, int8Ptr, false,
+			GlobalValue::InternalLinkage, 0, "gp");
+
+	BasicBlock *bb = entry[MAIN];
+	g.x = new AllocaInst(int8, 0, "x", bb);
+	new StoreInst(g.x, g.gp, bb);
+	g.toA = CallInst::Create(g.F[A], "", bb);
+	g.toSelf = CallInst::Create(g.F[SELF], "", bb);
+	g.toD = CallInst::Create(g.F[D], "", bb);
+
+	Value *slot = new AllocaInst(PointerType::getUnqual(voidTy), 0, "",
+			bb);
+	new StoreInst(g.F[L], slot, bb);
+	new StoreInst(g.F[R], slot, bb);
+	g.toTarget = CallInst::Create(new LoadInst(slot, "", bb), "", bb);
+
+	g.selfToSelf = CallInst::Create(g.F[SELF], "", entry[SELF]);
+	g.bToA = CallInst::Create(g.F[A], "", entry[B]);
+	g.bToD1 = CallInst::Create(g.F[D], "", entry[B]);
+	g.bToD2 = CallInst::Create(g.F[D], "", entry[B]);
+	g.aToB = CallInst::Create(g.F[B], "", entry[A]);
+	g.dToL = CallInst::Create(g.F[L], "", entry[D]);
+	g.dToR = CallInst::Create(g.F[R], "", entry[D]);
+	g.lToJ = CallInst::Create(g.F[J], "", entry[L]);
+	g.rToJ = CallInst::Create(g.F[J], "", entry[R]);
+	g.jToExt = CallInst::Create(g.ext, "", entry[J]);
+	new StoreInst(ConstantInt::get(int8, 0),
+			new LoadInst(g.gp, "", entry[J]), entry[J]);
+
+	for (unsigned f = 0; f < FUNCTIONS; f++) {
+		new StoreInst(ConstantInt::get(int32, f), g.G[f], entry[f]);
+		ReturnInst::Create(C, entry[f]);
+	}
+
+	return std::unique_ptr<Module>(M);
+}
+
+/* the transitive closure the way the callgraph used to compute it */
+static void closure(const Calls &R, Calls &TCR)
+{
+	typedef std::multimap<const Function *, const Function *> Dict;
+
+	Calls S(R);
+	Dict D(R.begin(), R.end());
+
+	while (true) {
+		std::size_t const old_size = S.size();
+
+		for (Calls::const_iterator it = S.begin(); it != S.end(); ++it) {
+			Dict::const_iterator b, e;
+			for (llvm::tie(b, e) = D.equal_range(it->second); b != e;
+					++b)
+				S.insert(Call(it->first, b->second));
+		}
+
+		if (old_size == S.size())
+			break;
+	}
+
+	TCR.insert(S.begin(), S.end());
+}
+
+template<typename T>
+static void checkRow(const char *what, const Value *V,
+		std::pair<typename std::vector<T>::const_iterator,
+			typename std::vector<T>::const_iterator> R,
+		const std::vector<T> &expected)
+{
+	if (std::distance(R.first, R.second) == (long)expected.size() &&
+			std::equal(R.first, R.second, expected.begin()))
+		return;
+
+	errs() << what << " of " << V->getName() << " differ\n";
+	abort();
+}
+
+/* calls() and callees() list every function once, in any order */
+static void checkSet(const char *what, const Function *F,
+		Callgraph::function_range R, const std::set<const Function *> &S)
+{
+	std::set<const Function *> got(R.first, R.second);
+
+	if (got == S && (std::size_t)std::distance(R.first, R.second) ==
+			S.size())
+		return;
+
+	errs() << what << " of " << F->getName() << " differ\n";
+	abort();
+}
+
+static void checkGraph(const Graph &g, const Callgraph &CG,
+		const Calls &direct)
+{
+	const Function *const *F = g.F;
+
+	/* the rows keep the order the calls come in the module */
+	Functions rows[FUNCTIONS];
+	Callgraph::function_range T = CG.callTargets(g.toTarget);
+	std::set<const Function *> targets(T.first, T.second);
+
+	if (std::distance(T.first, T.second) != 2 || !targets.count(F[L]) ||
+			!targets.count(F[R]))
+		abort();
+
+	rows[MAIN].push_back(F[A]);
+	rows[MAIN].push_back(F[SELF]);
+	rows[MAIN].push_back(F[D]);
+	rows[MAIN].insert(rows[MAIN].end(), T.first, T.second);
+	rows[SELF].push_back(F[SELF]);
+	rows[A].push_back(F[B]);
+	rows[B].push_back(F[A]);
+	rows[B].push_back(F[D]);
+	rows[D].push_back(F[L]);
+	rows[D].push_back(F[R]);
+	rows[L].push_back(F[J]);
+	rows[R].push_back(F[J]);
+	for (unsigned f = 0; f < FUNCTIONS; f++)
+		checkRow("direct calls", F[f], CG.directCalls(F[f]), rows[f]);
+
+	/* the callers come in the order of the calls above */
+	Functions cols[FUNCTIONS];
+	cols[SELF].push_back(F[MAIN]);
+	cols[SELF].push_back(F[SELF]);
+	cols[A].push_back(F[MAIN]);
+	cols[A].push_back(F[B]);
+	cols[B].push_back(F[A]);
+	cols[D].push_back(F[MAIN]);
+	cols[D].push_back(F[B]);
+	cols[L].push_back(F[MAIN]);
+	cols[L].push_back(F[D]);
+	cols[R].push_back(F[MAIN]);
+	cols[R].push_back(F[D]);
+	cols[J].push_back(F[L]);
+	cols[J].push_back(F[R]);
+	for (unsigned f = 0; f < FUNCTIONS; f++)
+		checkRow("direct callees", F[f], CG.directCallees(F[f]),
+				cols[f]);
+
+	/* the sites, every call of b to d one */
+	CallSites sites[FUNCTIONS];
+	sites[SELF].push_back(g.toSelf);
+	sites[SELF].push_back(g.selfToSelf);
+	sites[A].push_back(g.toA);
+	sites[A].push_back(g.bToA);
+	sites[B].push_back(g.aToB);
+	sites[D].push_back(g.toD);
+	sites[D].push_back(g.bToD1);
+	sites[D].push_back(g.bToD2);
+	sites[L].push_back(g.toTarget);
+	sites[L].push_back(g.dToL);
+	sites[R].push_back(g.toTarget);
+	sites[R].push_back(g.dToR);
+	sites[J].push_back(g.lToJ);
+	sites[J].push_back(g.rToJ);
+	for (unsigned f = 0; f < FUNCTIONS; f++)
+		checkRow("call sites", F[f], CG.callSites(F[f]), sites[f]);
+	checkRow("call sites", g.ext, CG.callSites(g.ext), CallSites());
+	checkRow("targets", g.jToExt, CG.callTargets(g.jToExt), Functions());
+
+	/* the transitive calls are the closure of the direct ones */
+	Calls TC;
+	closure(direct, TC);
+	for (unsigned f = 0; f < FUNCTIONS; f++) {
+		std::set<const Function *> calls, callees;
+
+		for (Calls::const_iterator I = TC.begin(); I != TC.end(); ++I) {
+			if (I->first == F[f])
+				calls.insert(I->second);
+			if (I->second == F[f])
+				callees.insert(I->first);
+		}
+		checkSet("calls", F[f], CG.calls(F[f]), calls);
+		checkSet("callees", F[f], CG.callees(F[f]), callees);
+		for (unsigned t = 0; t < FUNCTIONS; t++)
+			if (CG.reaches(F[f], F[t]) != TC.count(Call(F[f], F[t])))
+				abort();
+	}
+
+	Calls pairs(CG.begin_closure(), CG.end_closure());
+	if (pairs != TC || (std::size_t)std::distance(CG.begin_closure(),
+				CG.end_closure()) != TC.size())
+		abort();
+
+	/* the SCCs: self and the 2-cycle call themselves, the rest do not */
+	if (CG.getNumSCCs() != 7 || CG.getSCC(F[LONE]) != Callgraph::NO_SCC ||
+			CG.getSCC(g.ext) != Callgraph::NO_SCC ||
+			CG.getSCC(F[A]) != CG.getSCC(F[B]) ||
+			!CG.isCyclic(CG.getSCC(F[SELF])) ||
+			!CG.isCyclic(CG.getSCC(F[A])) ||
+			CG.isCyclic(CG.getSCC(F[MAIN])) ||
+			CG.isCyclic(CG.getSCC(F[D])) ||
+			CG.isCyclic(CG.getSCC(F[J])))
+		abort();
+
+	/* bottom-up, an SCC comes after all those it calls */
+	std::vector<unsigned> order;
+	std::set<const Function *> members;
+	for (Callgraph::scc_iterator s = CG.bottom_up_begin();
+			s != CG.bottom_up_end(); ++s) {
+		Callgraph::function_range M = CG.sccMembers(*s);
+		Callgraph::scc_succ_range S = CG.sccCalls(*s);
+
+		for (Callgraph::function_iterator I = M.first; I != M.second;
+				++I)
+			if (CG.getSCC(*I) != *s || !members.insert(*I).second)
+				abort();
+		for (Callgraph::scc_succ_iterator I = S.first; I != S.second;
+				++I)
+			if (std::find(order.begin(), order.end(), *I) ==
+					order.end())
+				abort();
+		order.push_back(*s);
+	}
+	if (members.size() != FUNCTIONS - 1 || members.count(F[LONE]))
+		abort();
+
+	std::vector<unsigned> reversed;
+	for (Callgraph::scc_iterator s = CG.top_down_begin();
+			s != CG.top_down_end(); ++s)
+		reversed.push_back(*s);
+	if (!std::equal(order.rbegin(), order.rend(), reversed.begin()) ||
+			reversed.size() != order.size())
+		abort();
+
+	/* every direct call between two SCCs goes down, both ways listed */
+	for (Calls::const_iterator I = direct.begin(); I != direct.end(); ++I) {
+		const unsigned from = CG.getSCC(I->first);
+		const unsigned to = CG.getSCC(I->second);
+		Callgraph::scc_succ_range S = CG.sccCalls(from);
+		Callgraph::scc_succ_range P = CG.sccCallers(to);
+
+		if (from == to)
+			continue;
+		if (std::find(order.begin(), order.end(), to) >
+				std::find(order.begin(), order.end(), from) ||
+				std::find(S.first, S.second, to) == S.second ||
+				std::find(P.first, P.second, from) == P.second)
+			abort();
+	}
+}
+
+/*
+ * What every function modifies the way it used to be computed: its own
+ * writes with those of all the functions it reaches, but its locals.
+ */
+static void closureModifies(const Graph &g, const Calls &TC,
+		std::map<const Function *, ModSet> &MOD)
+{
+	for (unsigned f = 0; f < FUNCTIONS; f++)
+		MOD[g.F[f]].insert(Ptee(g.G[f], -1));
+	MOD[g.F[MAIN]].insert(Ptee(g.gp, -1));
+	MOD[g.F[J]].insert(Ptee(g.x, 0));
+
+	for (Calls::const_iterator i = TC.begin(); i != TC.end(); ++i) {
+		const ModSet &src = MOD[i->second];
+		ModSet &dst = MOD[i->first];
+
+		dst.insert(src.begin(), src.end());
+		for (ModSet::iterator I = dst.begin(), E = dst.end(); I != E; )
+			if (isLocalToFunction(I->first, i->first))
+				dst.erase(I++);
+			else
+				++I;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	LLVMContext context;
+	Graph g;
+	std::unique_ptr<Module> M = build(context, g);
+	ptr::ProgramStructure P(*M);
+	ptr::PointsToSets PS;
+	const Function *const *F = g.F;
+
+	computePointsToSets(P, PS);
+
+	Calls direct, TC;
+	direct.insert(Call(F[MAIN], F[A]));
+	direct.insert(Call(F[MAIN], F[SELF]));
+	direct.insert(Call(F[MAIN], F[D]));
+	direct.insert(Call(F[MAIN], F[L]));
+	direct.insert(Call(F[MAIN], F[R]));
+	direct.insert(Call(F[SELF], F[SELF]));
+	direct.insert(Call(F[A], F[B]));
+	direct.insert(Call(F[B], F[A]));
+	direct.insert(Call(F[B], F[D]));
+	direct.insert(Call(F[D], F[L]));
+	direct.insert(Call(F[D], F[R]));
+	direct.insert(Call(F[L], F[J]));
+	direct.insert(Call(F[R], F[J]));
+	closure(direct, TC);
+
+	/* built on demand or up front, and asked in any order */
+	for (int lazy = 0; lazy <= 1; lazy++) {
+		Callgraph CG(*M, PS, lazy);
+
+		checkGraph(g, CG, direct);
+	}
+	{
+		Callgraph CG(*M, PS);
+
+		if (CG.reaches(F[J], F[J]) || !CG.reaches(F[MAIN], F[J]) ||
+				CG.calls(F[LONE]).first != CG.calls(F[LONE]).second)
+			abort();
+		checkGraph(g, CG, direct);
+	}
+
+	Callgraph CG(*M, PS);
+	mods::ProgramStructure MP(*M);
+	mods::Modifies MOD;
+	std::map<const Function *, ModSet> expected;
+
+	computeModifies(MP, CG, PS, MOD);
+	closureModifies(g, TC, expected);
+	for (unsigned f = 0; f < FUNCTIONS; f++)
+		if (mods::getModSet(F[f], MOD) != expected[F[f]]) {
+			errs() << "mod set of " << F[f]->getName() << " differs\n";
+			abort();
+		}
+	if (expected[F[MAIN]].count(Ptee(g.x, 0)) ||
+			!expected[F[D]].count(Ptee(g.x, 0)))
+		abort();
+
+	/* a and b are one SCC with no locals, they share one set */
+	if (&MOD.get(F[A]) != &MOD.get(F[B]))
+		abort();
+
+	return 0;
+}
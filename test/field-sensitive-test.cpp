@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <utility>
+#include <vector>
 
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Function.h>
@@ -7,7 +12,10 @@
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "../src/PointsTo/Budget.h"
+#include "../src/PointsTo/ConstraintFile.h"
 #include "../src/PointsTo/PointsTo.h"
+#include "../src/PointsTo/Solvers.h"
 
 #define DEBUG
 
@@ -19,27 +27,23 @@ typedef ptr::PointsToSets::PointsToSet PTSet;
 typedef std::pair<const Ptr, const Ptee> ToCheckEl;
 typedef SmallVector<ToCheckEl, 20> ToCheck;
 
-static void pointsTo(Module &M, const ToCheck &toCheck)
+static void check(const ptr::PointsToSets &PS, const ToCheck &toCheck)
 {
-	ptr::PointsToSets PS;
-	{
-		ptr::ProgramStructure P(M);
-		computePointsToSets(P, PS);
-	}
 #ifdef DEBUG
-	for (ptr::PointsToSets::const_iterator I = PS.begin(), E = PS.end();
-			I != E; ++I) {
-		const Ptr &ptr = I->first;
-		errs() << "OFF=" << ptr.second;
-		ptr.first->dump();
-		const PTSet &p = I->second;
-		for (PTSet::const_iterator II = p.begin(), EE = p.end();
-				II != EE; ++II) {
-			const Ptee &ptee = *II;
-			errs() << "\tOFF=" << ptee.second;
-			ptee.first->dump();
+	if (!PS.isPartial())
+		for (ptr::PointsToSets::const_iterator I = PS.begin(), E = PS.end();
+				I != E; ++I) {
+			const Ptr &ptr = I->first;
+			errs() << "OFF=" << ptr.second;
+			ptr.first->dump();
+			const PTSet &p = I->second;
+			for (PTSet::const_iterator II = p.begin(), EE = p.end();
+					II != EE; ++II) {
+				const Ptee &ptee = *II;
+				errs() << "\tOFF=" << ptee.second;
+				ptee.first->dump();
+			}
 		}
-	}
 
 	errs() << "======\n";
 #endif
@@ -74,6 +78,81 @@ static void pointsTo(Module &M, const ToCheck &toCheck)
 	}
 }
 
+/*
+ * @sets solved from @G, the rules of @F read back, are those of @S. The
+ * ids are those of F, the locations GEPs add included.
+ */
+static void checkFileSets(const ptr::detail::ConstraintFile &F,
+		const ptr::detail::ConstraintFile &G,
+		const std::vector<std::vector<uint32_t> > &sets,
+		const ptr::PointsToSets &S)
+{
+	std::size_t pointees = 0, expected = 0;
+
+	for (unsigned i = 0; i < sets.size(); i++) {
+		const ptr::detail::ConstraintFile::Location &L = G.locations[i];
+		PTSet X;
+
+		if (sets[i].empty())
+			continue;
+		for (unsigned j = 0; j < sets[i].size(); j++) {
+			const ptr::detail::ConstraintFile::Location &E =
+				G.locations[sets[i][j]];
+			X.insert(Ptee(F.values[E.object], E.offset));
+		}
+		if (X != ptr::getPointsToSet(F.values[L.object], S, L.offset))
+			abort();
+		pointees += X.size();
+	}
+	for (ptr::PointsToSets::const_iterator I = S.begin(), E = S.end();
+			I != E; ++I)
+		expected += I->second.size();
+	if (!pointees || pointees != expected)
+		abort();
+}
+
+/* returns the degradation of the sets, see PointsToSets::Degradation */
+static unsigned pointsTo(Module &M, const ToCheck &toCheck,
+		const ptr::SolverOptions &O)
+{
+	std::unique_ptr<ptr::PointsToSets> owner;
+	if (O.demand)
+		owner.reset(new ptr::DemandPointsToSets(M, O));
+	else {
+		owner.reset(new ptr::PointsToSets);
+		ptr::ProgramStructure P(M, O.onTheFly);
+		computePointsToSets(P, *owner, O);
+	}
+	check(*owner, toCheck);
+
+	return owner->getDegradation();
+}
+
+static void solve(Module &M, const ptr::SolverOptions &O,
+		ptr::PointsToSets &S)
+{
+	ptr::ProgramStructure P(M, O.onTheFly);
+
+	computePointsToSets(P, S, O);
+}
+
+/* the same pointers with the same sets */
+static bool sameSets(const ptr::PointsToSets &A, const ptr::PointsToSets &B)
+{
+	if (A.size() != B.size())
+		return false;
+
+	for (ptr::PointsToSets::const_iterator I = A.begin(), E = A.end();
+			I != E; ++I) {
+		const PTSet *X = B.query(I->first);
+
+		if (!X || *X != I->second.get())
+			return false;
+	}
+
+	return true;
+}
+
 static void addCheck(ToCheck &toCheck, const Value *ptr1, const int off1,
 		const Value *ptr2, const int off2) {
 	toCheck.push_back(ToCheckEl(Ptr(ptr1, off1), Ptee(ptr2, off2)));
@@ -157,6 +236,25 @@ static std::unique_ptr<Module> build(LLVMContext &C, ToCheck &toCheck)
 
 	addCheck(toCheck, gep, -1, i, 8);
 
+	FunctionType *idTy = FunctionType::get(Type::getInt8PtrTy(C),
+			ArrayRef<Type *>(Type::getInt8PtrTy(C)), false);
+	Function *id = Function::Create(idTy, GlobalValue::InternalLinkage,
+			"id", M);
+	Argument *arg = &*id->arg_begin();
+
+	ReturnInst::Create(C, arg, BasicBlock::Create(C, "entry", id));
+
+	Value *fp = new AllocaInst(PointerType::getUnqual(idTy), 0, "",
+			entry);
+
+	new StoreInst(id, fp, entry);
+
+	Value *ret = CallInst::Create(new LoadInst(fp, "", entry),
+		ArrayRef<Value *>(malloc24), "", entry);
+
+	addCheck(toCheck, arg, -1, malloc24, 0);
+	addCheck(toCheck, ret, -1, malloc24, 0);
+
 #ifdef DEBUG
 	errs() << "====== DUMP\n";
 	M->dump();
@@ -165,12 +263,513 @@ static std::unique_ptr<Module> build(LLVMContext &C, ToCheck &toCheck)
 	return std::unique_ptr<Module>(M);
 }
 
+/*
+ * y points to <m, 0> and <m, 8>, so gep y has two offsets of m and m is
+ * collapsed with maxOffsets = 1. What was stored to <m, 16> before or after
+ * has to be loaded through it.
+ */
+static std::unique_ptr<Module> buildCollapse(LLVMContext &C,
+		ToCheck &toCheck)
+{
+	Module *M = new Module("field-collapse", C);
+	IntegerType *int32 = Type::getInt32Ty(C);
+
+	Function *main = Function::Create(
+			FunctionType::get(Type::getVoidTy(C), false),
+			GlobalValue::InternalLinkage, "main", M);
+
+	FunctionType *mallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+			ArrayRef<Type *>(Type::getInt64Ty(C)), false);
+	Function *xmalloc = Function::Create(mallocTy,
+			GlobalValue::ExternalLinkage, "malloc", M);
+
+	BasicBlock *entry = BasicBlock::Create(C, "entry", main);
+
+	SmallVector<Type *, 10> structElems;
+	structElems.push_back(Type::getInt64Ty(C));
+	structElems.push_back(Type::getInt8PtrTy(C));
+	structElems.push_back(Type::getInt8PtrTy(C));
+	Type *xstruct = StructType::create(structElems, "collapsed");
+	Type *xstructPtr = PointerType::getUnqual(xstruct);
+
+	Value *m = call_malloc(toCheck, entry, xmalloc, 48);
+	Value *v = call_malloc(toCheck, entry, xmalloc, 24);
+	Value *b = new BitCastInst(m, xstructPtr, "", entry);
+
+	SmallVector<Value *, 10> gepIdx;
+	gepIdx.push_back(ConstantInt::get(int32, 0));
+	gepIdx.push_back(ConstantInt::get(int32, 1));
+	Value *f1 = GetElementPtrInst::CreateInBounds(b, gepIdx, "", entry);
+
+	gepIdx[1] = ConstantInt::get(int32, 2);
+	Value *f2 = GetElementPtrInst::CreateInBounds(b, gepIdx, "", entry);
+
+	new StoreInst(v, f2, entry);
+
+	Value *slot = new AllocaInst(xstructPtr, 0, "", entry);
+
+	new StoreInst(b, slot, entry);
+	new StoreInst(new BitCastInst(f1, xstructPtr, "", entry), slot,
+			entry);
+
+	Value *y = new LoadInst(slot, "", entry);
+
+	gepIdx[1] = ConstantInt::get(int32, 1);
+	Value *g = GetElementPtrInst::CreateInBounds(y, gepIdx, "", entry);
+	Value *load = new LoadInst(g, "", entry);
+
+	addCheck(toCheck, load, -1, v, 0);
+
+	return std::unique_ptr<Module>(M);
+}
+
+/*
+ * Three groups of rules sharing no value: each stores two objects through
+ * a pointer and loads them back, one through a field. In the first one, r
+ * points to a0 only, but unification puts b0 with a0.
+ */
+static std::unique_ptr<Module> buildComponents(LLVMContext &C,
+		ToCheck &toCheck, Value *&lr, Value *&b0)
+{
+	Module *M = new Module("components", C);
+	IntegerType *int32 = Type::getInt32Ty(C);
+	Type *int8 = Type::getInt8Ty(C);
+	Type *int8Ptr = Type::getInt8PtrTy(C);
+
+	Function *main = Function::Create(
+			FunctionType::get(Type::getVoidTy(C), false),
+			GlobalValue::InternalLinkage, "main", M);
+
+	BasicBlock *entry = BasicBlock::Create(C, "entry", main);
+
+	SmallVector<Type *, 10> structElems;
+	structElems.push_back(int8Ptr);
+	structElems.push_back(int8Ptr);
+	Type *xstruct = StructType::create(structElems, "pair");
+
+	SmallVector<Value *, 10> gepIdx;
+	gepIdx.push_back(ConstantInt::get(int32, 0));
+	gepIdx.push_back(ConstantInt::get(int32, 1));
+
+	for (unsigned k = 0; k < 3; k++) {
+		Value *a = new AllocaInst(int8, 0, "a", entry);
+		Value *b = new AllocaInst(int8, 0, "b", entry);
+		Value *pp = new AllocaInst(int8Ptr, 0, "pp", entry);
+
+		new StoreInst(a, pp, entry);
+		new StoreInst(b, pp, entry);
+
+		Value *load = new LoadInst(pp, "", entry);
+
+		addCheck(toCheck, load, -1, a, 0);
+		addCheck(toCheck, load, -1, b, 0);
+
+		Value *s = new AllocaInst(xstruct, 0, "s", entry);
+		Value *f = GetElementPtrInst::CreateInBounds(s, gepIdx, "",
+				entry);
+
+		new StoreInst(a, f, entry);
+		load = new LoadInst(f, "", entry);
+
+		addCheck(toCheck, s, 8, a, 0);
+		addCheck(toCheck, load, -1, a, 0);
+
+		if (k == 0) {
+			Value *r = new AllocaInst(int8Ptr, 0, "r", entry);
+
+			new StoreInst(a, r, entry);
+			lr = new LoadInst(r, "", entry);
+			b0 = b;
+			addCheck(toCheck, lr, -1, a, 0);
+		}
+	}
+
+	return std::unique_ptr<Module>(M);
+}
+
+/*
+ * Two pointers with a store through each, @pa and @pb point to no common
+ * object. Loading through @pa needs none of @pb.
+ */
+static std::unique_ptr<Module> buildDemand(LLVMContext &C, ToCheck &toCheck,
+		Value *&pa, Value *&pb, Value *&y)
+{
+	Module *M = new Module("demand", C);
+	Type *int8Ptr = Type::getInt8PtrTy(C);
+
+	Function *main = Function::Create(
+			FunctionType::get(Type::getVoidTy(C), false),
+			GlobalValue::InternalLinkage, "main", M);
+
+	BasicBlock *entry = BasicBlock::Create(C, "entry", main);
+
+	Value *x = new AllocaInst(Type::getInt8Ty(C), 0, "x", entry);
+	y = new AllocaInst(Type::getInt8Ty(C), 0, "y", entry);
+	pa = new AllocaInst(int8Ptr, 0, "pa", entry);
+	pb = new AllocaInst(int8Ptr, 0, "pb", entry);
+
+	new StoreInst(x, pa, entry);
+	new StoreInst(y, pb, entry);
+
+	Value *load = new LoadInst(pa, "", entry);
+
+	addCheck(toCheck, load, -1, x, 0);
+
+	return std::unique_ptr<Module>(M);
+}
+
 int main(int argc, char **argv)
 {
+	static const ptr::SolverKind solvers[] = {
+		ptr::SK_SWEEP,
+		ptr::SK_WORKLIST,
+		ptr::SK_WAVE,
+		ptr::SK_STEENSGAARD,
+		ptr::SK_MAPPED,
+	};
 	LLVMContext context;
 	ToCheck toCheck;
+	std::unique_ptr<Module> M = build(context, toCheck);
+
+	/* the rules do not depend on the threads generating them */
+	for (int otf = 0; otf <= 1; otf++) {
+		ptr::ProgramStructure P1(*M, otf, 1), P4(*M, otf, 4);
+
+		if (P1.getContainer().size() != P4.getContainer().size() ||
+				P1.getIndirectCalls() != P4.getIndirectCalls())
+			abort();
+		for (unsigned i = 0; i < P1.getContainer().size(); i++) {
+			const ptr::RuleCode &a = P1.getContainer()[i];
+			const ptr::RuleCode &b = P4.getContainer()[i];
+
+			if (a.getType() != b.getType() ||
+					a.getLvalue() != b.getLvalue() ||
+					a.getRvalue() != b.getRvalue())
+				abort();
+		}
+	}
+
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		for (int reduce = 0; reduce <= 1; reduce++) {
+			for (int otf = 0; otf <= 1; otf++) {
+				ptr::SolverOptions O;
+
+				O.kind = solvers[i];
+				O.reduce = reduce;
+				O.onTheFly = otf;
+				pointsTo(*M, toCheck, O);
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		ptr::SolverOptions O;
+
+		O.kind = solvers[i];
+		O.fields.maxOffsets = 1;
+		O.fields.collapseArrays = true;
+		pointsTo(*M, toCheck, O);
+	}
+
+	/*
+	 * Every group of rules sharing no value is a part of its own, the
+	 * parts get the very same sets as the whole.
+	 */
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		for (int otf = 0; otf <= 1; otf++) {
+			ptr::SolverOptions O;
+			ptr::PointsToSets whole, split;
+
+			O.kind = solvers[i];
+			O.onTheFly = otf;
+			solve(*M, O, whole);
+			O.partition = 1;
+			solve(*M, O, split);
+			check(split, toCheck);
+			if (!sameSets(whole, split))
+				abort();
+		}
+	}
+
+	/* the waves get the very same sets on any number of threads */
+	{
+		ptr::SolverOptions O;
+		ptr::PointsToSets one, many;
+
+		O.kind = ptr::SK_WAVE;
+		O.threads = 1;
+		solve(*M, O, one);
+		O.threads = 4;
+		solve(*M, O, many);
+		if (!sameSets(one, many))
+			abort();
+	}
+
+	/*
+	 * The wave and the worklist get the very same sets with the default
+	 * FieldOptions, too. They may differ where the GEP heuristics depend
+	 * on the order (see Wave.cpp), but here no GEP result flows back to
+	 * its GEP and no object gets more offsets than maxOffsets in a set.
+	 */
+	for (unsigned threads = 1; threads <= 4; threads += 3) {
+		ptr::SolverOptions O;
+		ptr::PointsToSets listed, waved;
+
+		O.kind = ptr::SK_WORKLIST;
+		solve(*M, O, listed);
+		O.kind = ptr::SK_WAVE;
+		O.threads = threads;
+		solve(*M, O, waved);
+		check(waved, toCheck);
+		if (!sameSets(listed, waved))
+			abort();
+	}
+
+	/*
+	 * With no heuristic depending on the order the pointees come in, all
+	 * the inclusion solvers get the very same sets.
+	 */
+	{
+		ptr::SolverOptions O;
+		ptr::PointsToSets swept;
+
+		O.fields.maxOffsets = 1000;
+		O.fields.cutRecursion = false;
+		O.kind = ptr::SK_SWEEP;
+		solve(*M, O, swept);
+		for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers);
+				i++) {
+			ptr::PointsToSets S;
+
+			if (solvers[i] == ptr::SK_STEENSGAARD)
+				continue;
+			O.kind = solvers[i];
+			solve(*M, O, S);
+			check(S, toCheck);
+			if (!sameSets(swept, S))
+				abort();
+		}
+	}
+
+	/* the calls resolved while solving are those matched beforehand */
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		ptr::SolverOptions O;
+		ptr::PointsToSets matched, resolved;
+
+		O.kind = solvers[i];
+		solve(*M, O, matched);
+		O.onTheFly = true;
+		solve(*M, O, resolved);
+		if (!sameSets(matched, resolved))
+			abort();
+	}
+
+	{
+		ToCheck compCheck;
+		Value *lr, *b0;
+		std::unique_ptr<Module> CM = buildComponents(context,
+				compCheck, lr, b0);
+		ptr::ProgramStructure P(*CM);
+		std::vector<ptr::ProgramStructure::Container> parts;
+
+		ptr::detail::partitionConstraints(P, parts, 1);
+		if (parts.size() < 3)
+			abort();
+
+		for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers);
+				i++) {
+			ptr::SolverOptions O;
+			ptr::PointsToSets whole, split;
+
+			O.kind = solvers[i];
+			solve(*CM, O, whole);
+			O.partition = 1;
+			solve(*CM, O, split);
+			check(split, compCheck);
+			if (!sameSets(whole, split))
+				abort();
+		}
+
+		/*
+		 * Unification keeps all that inclusion finds, and more: r
+		 * points to b0 too.
+		 */
+		ptr::SolverOptions O;
+		ptr::PointsToSets incl, unif;
+
+		solve(*CM, O, incl);
+		O.kind = ptr::SK_STEENSGAARD;
+		solve(*CM, O, unif);
+		if (ptr::getPointsToSet(lr, incl).count(Ptee(b0, 0)) ||
+				!ptr::getPointsToSet(lr, unif).count(Ptee(b0, 0)))
+			abort();
+		for (ptr::PointsToSets::const_iterator I = incl.begin(),
+				E = incl.end(); I != E; ++I) {
+			const PTSet &X = ptr::getPointsToSet(I->first.first,
+					unif, I->first.second);
+
+			if (!std::includes(X.begin(), X.end(),
+					I->second.begin(), I->second.end()))
+				abort();
+		}
+	}
+
+	/*
+	 * The heap is past 1 MB already, the solvers have to fall back, both
+	 * steps. Unification itself runs with no limit.
+	 */
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		ptr::SolverOptions O;
+
+		O.kind = solvers[i];
+		O.memLimit = 1;
+		if (pointsTo(*M, toCheck, O) != (solvers[i] == ptr::SK_STEENSGAARD ?
+				0 : ptr::PointsToSets::DG_FIELDS |
+				ptr::PointsToSets::DG_UNIFICATION))
+			abort();
+	}
+
+	/* only the first step is exceeded, the collapsed objects are solved */
+	for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers); i++) {
+		if (solvers[i] == ptr::SK_STEENSGAARD)
+			continue;
+
+		ptr::SolverOptions O;
+		ptr::ProgramStructure P(*M);
+		ptr::PointsToSets S;
+		ptr::detail::Budget B(0, 1), B2(0, 0);
+
+		O.kind = solvers[i];
+		ptr::detail::solveDegrading(P, S, O, B, B2);
+		if (S.getDegradation() != ptr::PointsToSets::DG_FIELDS ||
+				B2.getHit())
+			abort();
+		check(S, toCheck);
+	}
+
+	/*
+	 * The rules survive a file and are solved from there to the very
+	 * sets each solver gets in memory. The graphs are built kind by kind
+	 * from the file, so the GEPs must not cut by the order.
+	 */
+	{
+		static const char *const path = "field-sensitive-test.rules";
+		ptr::ProgramStructure P(*M);
+		ptr::PointsToSets S;
+		ptr::detail::ConstraintFile F, G;
+		std::vector<std::vector<uint32_t> > sets;
+		ptr::FieldOptions FO;
+
+		ptr::detail::compileConstraints(P, ptr::FieldOptions(), F);
+		if (!F.write(path) || !G.read(path) ||
+				G.objects.size() != F.objects.size() ||
+				G.locations.size() != F.locations.size() ||
+				G.getNumRules() != F.getNumRules())
+			abort();
+
+		ptr::detail::solveConstraintFile(G, G.fields, sets);
+		ptr::detail::solveSweep(P, S, ptr::FieldOptions());
+		checkFileSets(F, G, sets, S);
+
+		FO.cutRecursion = false;
+		for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers);
+				i++) {
+			ptr::PointsToSets T;
+
+			if (!G.read(path))
+				abort();
+			switch (solvers[i]) {
+			case ptr::SK_WORKLIST:
+				ptr::detail::solveWorklist(G, FO, sets);
+				ptr::detail::solveWorklist(P, T, FO);
+				break;
+			case ptr::SK_WAVE:
+				ptr::detail::solveWave(G, 2, FO, sets);
+				ptr::detail::solveWave(P, T, 2, FO);
+				break;
+			case ptr::SK_STEENSGAARD:
+				ptr::detail::solveSteensgaard(G, FO, sets);
+				ptr::detail::solveSteensgaard(P, T, FO);
+				break;
+			default:
+				continue;
+			}
+			checkFileSets(F, G, sets, T);
+		}
+		remove(path);
+
+		/* a file cut short is refused, not allocated for */
+		if (!F.write(path) || truncate(path, 80) || G.read(path))
+			abort();
+		remove(path);
+	}
+
+	/* the mapped sets are read from the files, the same as in memory */
+	for (int otf = 0; otf <= 1; otf++) {
+		ptr::SolverOptions O;
+
+		O.kind = ptr::SK_MAPPED;
+		O.onTheFly = otf;
+
+		ptr::MappedPointsToSets MS(*M, O);
+		ptr::ProgramStructure P(*M, otf);
+		ptr::PointsToSets S;
+
+		computePointsToSets(P, S, O);
+		check(MS, toCheck);
+		if (!MS.isPartial())
+			abort();
+		for (ptr::PointsToSets::const_iterator I = S.begin(),
+				E = S.end(); I != E; ++I) {
+			const PTSet *X = MS.query(I->first);
+
+			if (!X || *X != I->second.get())
+				abort();
+		}
+	}
+
+	ptr::SolverOptions O;
+	O.demand = true;
+	pointsTo(*M, toCheck, O);
+
+	/* only the stores which may write into an object are solved */
+	{
+		ToCheck demandCheck;
+		Value *pa, *pb, *y;
+		std::unique_ptr<Module> DM = buildDemand(context, demandCheck,
+				pa, pb, y);
+		ptr::SolverOptions O;
 
-	pointsTo(*build(context, toCheck), toCheck);
+		O.demand = true;
+
+		ptr::DemandPointsToSets DS(*DM, O);
+
+		if (!DS.isPartial() || DS.isSolved(Ptr(pa, -1)))
+			abort();
+		check(DS, demandCheck);
+		if (!DS.isSolved(Ptr(pa, -1)) || DS.isSolved(Ptr(pb, -1)) ||
+				DS.isSolved(Ptr(y, -1)))
+			abort();
+	}
+
+	/* a collapsed object is collapsed in all the sets */
+	{
+		ToCheck collapseCheck;
+		std::unique_ptr<Module> CM = buildCollapse(context,
+				collapseCheck);
+
+		for (unsigned i = 0; i < sizeof(solvers) / sizeof(*solvers);
+				i++) {
+			ptr::SolverOptions O;
+
+			O.kind = solvers[i];
+			O.fields.maxOffsets = 1;
+			pointsTo(*CM, collapseCheck, O);
+		}
+
+		O.fields.maxOffsets = 1;
+		pointsTo(*CM, collapseCheck, O);
+	}
 
 	return 0;
 }
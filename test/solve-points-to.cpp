@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstring>
+#include <stdlib.h>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "../src/PointsTo/ConstraintFile.h"
+
+using namespace llvm;
+
+/*
+ * Solves rules written by SLICE_PTS_DUMP, with no module around:
+ *   solve-points-to FILE [-solver sweep|worklist|wave|steensgaard]
+ *     [-threads N] [-max-offsets N] [-array-limit N] [-no-cut] [-print]
+ * The sweep is the default.
+ */
+
+static void usage(const char *argv0)
+{
+	errs() << "usage: " << argv0 <<
+		" FILE [-solver sweep|worklist|wave|steensgaard] "
+		"[-threads N]\n\t[-max-offsets N] [-array-limit N] [-no-cut] "
+		"[-print]\n";
+	exit(1);
+}
+
+static void print(const ptr::detail::ConstraintFile &F,
+		const std::vector<std::vector<uint32_t> > &sets)
+{
+	for (uint32_t i = 0; i < sets.size(); i++) {
+		const ptr::detail::ConstraintFile::Location &L = F.locations[i];
+
+		if (sets[i].empty())
+			continue;
+		outs() << F.objects[L.object].name << " OFF=" << L.offset <<
+			"\n";
+		for (uint32_t j = 0; j < sets[i].size(); j++) {
+			const ptr::detail::ConstraintFile::Location &P =
+				F.locations[sets[i][j]];
+			outs() << "\t" << F.objects[P.object].name << " OFF=" <<
+				P.offset << "\n";
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ptr::detail::ConstraintFile F;
+	const char *solver = "sweep";
+	unsigned threads = 0;
+	bool doPrint = false;
+
+	if (argc < 2)
+		usage(argv[0]);
+
+	if (!F.read(argv[1])) {
+		errs() << argv[0] << ": cannot read rules from '" << argv[1] <<
+			"'\n";
+		return 1;
+	}
+
+	ptr::FieldOptions O = F.fields;
+
+	for (int i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "-solver") && i + 1 < argc)
+			solver = argv[++i];
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-max-offsets") && i + 1 < argc)
+			O.maxOffsets = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-array-limit") && i + 1 < argc)
+			O.arrayLimit = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-no-cut"))
+			O.cutRecursion = false;
+		else if (!strcmp(argv[i], "-print"))
+			doPrint = true;
+		else
+			usage(argv[0]);
+	}
+
+	std::vector<std::vector<uint32_t> > sets;
+	const std::size_t locations = F.locations.size();
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+	unsigned sweeps = 0;
+
+	if (!strcmp(solver, "sweep"))
+		sweeps = ptr::detail::solveConstraintFile(F, O, sets);
+	else if (!strcmp(solver, "worklist"))
+		ptr::detail::solveWorklist(F, O, sets);
+	else if (!strcmp(solver, "wave"))
+		ptr::detail::solveWave(F, threads, O, sets);
+	else if (!strcmp(solver, "steensgaard"))
+		ptr::detail::solveSteensgaard(F, O, sets);
+	else
+		usage(argv[0]);
+	std::chrono::duration<double> took =
+		std::chrono::steady_clock::now() - start;
+
+	std::size_t pointees = 0, nonEmpty = 0;
+	for (uint32_t i = 0; i < sets.size(); i++) {
+		pointees += sets[i].size();
+		nonEmpty += !sets[i].empty();
+	}
+
+	errs() << F.getNumRules() << " rules, " << F.objects.size() <<
+		" objects, " << locations << " locations (" <<
+		F.locations.size() - locations << " added)\n";
+	errs() << solver << ": solved in " << took.count() << " s, ";
+	if (sweeps)
+		errs() << sweeps << " sweeps, ";
+	errs() << pointees << " pointees in " << nonEmpty << " sets\n";
+
+	if (doPrint)
+		print(F, sets);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "../src/PointsTo/SparseBitmap.h"
+
+using namespace llvm;
+
+typedef std::set<unsigned> Set;
+
+static void check(const ptr::SparseBitmap &B, const Set &S, const char *what)
+{
+	if (B.size() == S.size() && std::equal(S.begin(), S.end(), B.begin()))
+		return;
+
+	errs() << "Bitmap differs after " << what << ": ";
+	for (ptr::SparseBitmap::const_iterator I = B.begin(), E = B.end();
+			I != E; ++I)
+		errs() << *I << " ";
+	errs() << "\n\tshould be: ";
+	for (Set::const_iterator I = S.begin(), E = S.end(); I != E; ++I)
+		errs() << *I << " ";
+	errs() << "\n";
+	abort();
+}
+
+/* small values hit the same blocks, large ones spread over many */
+static unsigned randomElement(unsigned range)
+{
+	return rand() % range;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned ranges[] = { 8, 200, 5000, 1000000 };
+
+	srand(0);
+
+	for (unsigned r = 0; r < sizeof(ranges) / sizeof(*ranges); r++) {
+		for (unsigned round = 0; round < 200; round++) {
+			ptr::SparseBitmap A, B;
+			Set SA, SB;
+			unsigned na = rand() % 40, nb = rand() % 40;
+
+			for (unsigned i = 0; i < na; i++) {
+				unsigned x = randomElement(ranges[r]);
+				if (A.insert(x) != SA.insert(x).second)
+					abort();
+			}
+			for (unsigned i = 0; i < nb; i++) {
+				unsigned x = randomElement(ranges[r]);
+				B.insert(x);
+				SB.insert(x);
+			}
+			check(A, SA, "insert");
+			check(B, SB, "insert");
+
+			for (unsigned i = 0; i < 20; i++) {
+				unsigned x = randomElement(ranges[r]);
+				if (A.count(x) != SA.count(x))
+					abort();
+			}
+
+			ptr::SparseBitmap D;
+			Set SD;
+			D.assignDifference(A, B);
+			std::set_difference(SA.begin(), SA.end(), SB.begin(),
+					SB.end(), std::inserter(SD, SD.end()));
+			check(D, SD, "difference");
+
+			ptr::SparseBitmap I(A);
+			Set SI;
+			I.intersectWith(B);
+			std::set_intersection(SA.begin(), SA.end(), SB.begin(),
+					SB.end(), std::inserter(SI, SI.end()));
+			check(I, SI, "intersection");
+
+			ptr::SparseBitmap U(A);
+			Set SU(SA);
+			bool changed = U.unionWith(B);
+			SU.insert(SB.begin(), SB.end());
+			check(U, SU, "union");
+			if (changed != (SU.size() != SA.size()))
+				abort();
+			if (U.unionWith(B) || U.unionWith(A) || U.unionWith(D))
+				abort();
+			if ((U == A) != (SU == SA) || !(U == U))
+				abort();
+		}
+	}
+
+	return 0;
+}